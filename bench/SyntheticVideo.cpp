@@ -0,0 +1,92 @@
+#include "SyntheticVideo.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+cv::Mat makeBackground(const cv::Size& size)
+{
+    cv::Mat background(size, CV_8UC3);
+    for (int y = 0; y < size.height; ++y) {
+        cv::Vec3b* row = background.ptr<cv::Vec3b>(y);
+        for (int x = 0; x < size.width; ++x) {
+            row[x] = cv::Vec3b(static_cast<uchar>(40 + (x * 120) / size.width),
+                               static_cast<uchar>(60 + (y * 100) / size.height),
+                               static_cast<uchar>(90));
+        }
+    }
+    cv::Mat texture(size, CV_8UC3);
+    cv::RNG rng(0x5EED);
+    rng.fill(texture, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(24));
+    background += texture;
+    return background;
+}
+
+} // namespace
+
+const std::vector<SyntheticResolution>& syntheticResolutions()
+{
+    static const std::vector<SyntheticResolution> resolutions = {
+        {"480p", cv::Size(854, 480)},
+        {"1080p", cv::Size(1920, 1080)},
+        {"4k", cv::Size(3840, 2160)},
+    };
+    return resolutions;
+}
+
+cv::Mat makeSyntheticFrame(const cv::Size& size, int index)
+{
+    cv::Mat frame = makeBackground(size);
+
+    // Objects scale with the frame so every resolution sees the same relative motion.
+    const int unit = std::max(1, size.height / 24);
+    const int width = size.width;
+    const int height = size.height;
+    cv::rectangle(frame,
+                  cv::Rect((index * unit / 2) % width, height / 4, 4 * unit, 3 * unit),
+                  cv::Scalar(230, 230, 230), cv::FILLED);
+    cv::circle(frame,
+               cv::Point(width - (index * unit / 3) % width, height / 2),
+               2 * unit, cv::Scalar(20, 40, 220), cv::FILLED);
+    cv::rectangle(frame,
+                  cv::Rect(width / 3, (index * unit / 4) % height, 2 * unit, 5 * unit),
+                  cv::Scalar(30, 200, 60), cv::FILLED);
+
+    cv::Mat noise(size, CV_8UC3);
+    cv::RNG rng(static_cast<uint64>(index) + 1);
+    rng.fill(noise, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(6));
+    frame += noise;
+    return frame;
+}
+
+bool writeSyntheticClip(const QString& path, const cv::Size& size, int frameCount, double fps, int fourcc)
+{
+    cv::VideoWriter writer(path.toStdString(), fourcc, fps, size);
+    if (!writer.isOpened()) {
+        qWarning() << "writeSyntheticClip: Failed to open writer for" << path;
+        return false;
+    }
+    for (int i = 0; i < frameCount; ++i) {
+        writer.write(makeSyntheticFrame(size, i));
+    }
+    writer.release();
+    return true;
+}
+
+QString ensureSyntheticClip(const QString& directory, const SyntheticResolution& resolution, int frameCount)
+{
+    QDir dir(directory);
+    if (!dir.exists() && !dir.mkpath(".")) {
+        qWarning() << "ensureSyntheticClip: Cannot create" << directory;
+        return QString();
+    }
+
+    const QString path = dir.filePath(QString("synthetic_%1_%2f.avi").arg(resolution.name).arg(frameCount));
+    if (QFileInfo::exists(path)) return path;
+
+    qInfo() << "Generating synthetic clip" << path;
+    if (!writeSyntheticClip(path, resolution.size, frameCount)) return QString();
+    return path;
+}
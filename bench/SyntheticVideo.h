@@ -0,0 +1,32 @@
+#ifndef SYNTHETICVIDEO_H
+#define SYNTHETICVIDEO_H
+
+#include <QString>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Deterministic synthetic footage for benchmarks: a fixed textured background,
+// a few objects moving on linear paths and low-amplitude per-frame sensor noise.
+// The same (size, index) always produces the same pixels.
+
+struct SyntheticResolution
+{
+    const char* name;
+    cv::Size size;
+};
+
+// 480p, 1080p and 4K (UHD).
+const std::vector<SyntheticResolution>& syntheticResolutions();
+
+cv::Mat makeSyntheticFrame(const cv::Size& size, int index);
+
+// Writes frameCount frames to path with the given codec (MJPG, i.e. all keyframes, by
+// default; the container follows the file suffix). Returns false if the writer fails.
+bool writeSyntheticClip(const QString& path, const cv::Size& size, int frameCount, double fps = 30.0,
+                        int fourcc = cv::VideoWriter::fourcc('M', 'J', 'P', 'G'));
+
+// Returns the path of a cached clip for the given resolution inside directory,
+// generating it first if it does not exist. Returns an empty string on failure.
+QString ensureSyntheticClip(const QString& directory, const SyntheticResolution& resolution, int frameCount);
+
+#endif // SYNTHETICVIDEO_H
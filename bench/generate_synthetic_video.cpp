@@ -0,0 +1,34 @@
+#include "SyntheticVideo.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("SyntheticVideoGenerator");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Writes the deterministic 480p/1080p/4K benchmark clips.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("directory", "Output directory.");
+    QCommandLineOption framesOption({"f", "frames"}, "Frames per clip.", "count", "120");
+    parser.addOption(framesOption);
+    parser.process(a);
+
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+    const int frames = parser.value(framesOption).toInt();
+    if (frames <= 0) {
+        parser.showHelp(1);
+    }
+
+    QTextStream out(stdout);
+    for (const SyntheticResolution& resolution : syntheticResolutions()) {
+        const QString path = ensureSyntheticClip(parser.positionalArguments().first(), resolution, frames);
+        if (path.isEmpty()) return 1;
+        out << path << '\n';
+    }
+    return 0;
+}
@@ -0,0 +1,358 @@
+#include "SyntheticVideo.h"
+#include "GrayFrameRing.h"
+#include "MaskArchive.h"
+#include "MotionDetector.h"
+#include "MotionHeatmap.h"
+#include "MotionKernel.h"
+#include "MotionStats.h"
+#include "VideoDisplayWidget.h"
+#include "VideoProcessor.h"
+
+#include <QApplication>
+#include <QDir>
+#include <QEventLoop>
+#include <benchmark/benchmark.h>
+#include <atomic>
+
+// Benchmarks for the motion path. Inputs are the deterministic clips from
+// SyntheticVideo.h, so numbers are comparable between releases on the same machine.
+// Encoded clips are cached in $MOTPLAYER_BENCH_DATA (default: <tmp>/motplayer-bench).
+
+namespace {
+
+constexpr int kClipFrames = 120;
+constexpr int kDelta = 3;
+constexpr int kThreshold = 30;
+
+const SyntheticResolution& resolutionArg(const benchmark::State& state)
+{
+    return syntheticResolutions().at(static_cast<size_t>(state.range(0)));
+}
+
+void allResolutions(benchmark::internal::Benchmark* benchmark)
+{
+    benchmark->ArgName("res");
+    for (size_t i = 0; i < syntheticResolutions().size(); ++i) {
+        benchmark->Arg(static_cast<int64_t>(i));
+    }
+}
+
+void setPixelCounters(benchmark::State& state, const cv::Size& size)
+{
+    state.SetLabel(resolutionArg(state).name);
+    state.counters["pixels/s"] = benchmark::Counter(static_cast<double>(state.iterations()) * size.area(),
+                                                    benchmark::Counter::kIsRate);
+}
+
+QString benchDataDirectory()
+{
+    const QString configured = qEnvironmentVariable("MOTPLAYER_BENCH_DATA");
+    return configured.isEmpty() ? QDir::temp().filePath("motplayer-bench") : configured;
+}
+
+} // namespace
+
+// The pre-fusion path: two cvtColor passes, absdiff, threshold.
+static void BM_ReferenceMotionMask(benchmark::State& state)
+{
+    const cv::Size size = resolutionArg(state).size;
+    const cv::Mat frameN = makeSyntheticFrame(size, kDelta);
+    const cv::Mat frameNminusDelta = makeSyntheticFrame(size, 0);
+    cv::Mat grayN, grayNminusDelta, diff, mask;
+    for (auto _ : state) {
+        cv::cvtColor(frameN, grayN, cv::COLOR_BGR2GRAY);
+        cv::cvtColor(frameNminusDelta, grayNminusDelta, cv::COLOR_BGR2GRAY);
+        cv::absdiff(grayN, grayNminusDelta, diff);
+        cv::threshold(diff, mask, kThreshold, 255, cv::THRESH_BINARY);
+        benchmark::DoNotOptimize(mask.data);
+    }
+    setPixelCounters(state, size);
+}
+BENCHMARK(BM_ReferenceMotionMask)->Apply(allResolutions)->Unit(benchmark::kMillisecond);
+
+// What run() does per frame: one fused pass against a gray frame already in the ring.
+static void BM_FusedMotionMask(benchmark::State& state)
+{
+    const cv::Size size = resolutionArg(state).size;
+    const cv::Mat frameN = makeSyntheticFrame(size, kDelta);
+    cv::Mat previousGray, gray, mask;
+    convertToGray(makeSyntheticFrame(size, 0), previousGray);
+    for (auto _ : state) {
+        fusedGrayDiffThreshold(frameN, previousGray, kThreshold, gray, mask);
+        benchmark::DoNotOptimize(mask.data);
+    }
+    setPixelCounters(state, size);
+}
+BENCHMARK(BM_FusedMotionMask)->Apply(allResolutions)->Unit(benchmark::kMillisecond);
+
+// Frame buffer management: converting a frame into the history ring.
+// Every detector on the same frame sequence, steady state (history already full).
+static void BM_MotionDetector(benchmark::State& state)
+{
+    const auto algorithm = static_cast<MotionAlgorithm>(state.range(0));
+    const SyntheticResolution& resolution = syntheticResolutions().at(static_cast<size_t>(state.range(1)));
+    constexpr int kSequenceFrames = 16;
+    std::vector<cv::Mat> frames;
+    for (int i = 0; i < kSequenceFrames; ++i) {
+        frames.push_back(makeSyntheticFrame(resolution.size, i));
+    }
+
+    std::unique_ptr<MotionDetector> detector = createMotionDetector(algorithm, VideoProcessor::kMaxFrameDelta);
+    MotionParams params;
+    params.frameDelta = kDelta;
+    params.threshold = kThreshold;
+    cv::Mat mask;
+    for (const cv::Mat& frame : frames) {
+        detector->detect(frame, params, mask);
+    }
+
+    size_t next = 0;
+    for (auto _ : state) {
+        detector->detect(frames[next], params, mask);
+        benchmark::DoNotOptimize(mask.data);
+        next = (next + 1) % frames.size();
+    }
+    state.SetLabel(std::string(motionAlgorithmName(algorithm)) + "/" + resolution.name);
+    state.counters["pixels/s"] = benchmark::Counter(static_cast<double>(state.iterations()) * resolution.size.area(),
+                                                    benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_MotionDetector)
+    ->ArgNames({"algorithm", "res"})
+    ->ArgsProduct({{static_cast<int64_t>(MotionAlgorithm::FrameDifference),
+                    static_cast<int64_t>(MotionAlgorithm::ThreeFrameDifference),
+                    static_cast<int64_t>(MotionAlgorithm::RunningAverage),
+                    static_cast<int64_t>(MotionAlgorithm::Mog2),
+                    static_cast<int64_t>(MotionAlgorithm::Knn)},
+                   {0, 1, 2}})
+    ->Unit(benchmark::kMillisecond);
+
+// Masks for the deltas {1, 3, 10, 30}: one shared pass (multi=1) against one fused
+// single-delta pass per delta (multi=0), both on a full history.
+static void BM_MultiDeltaMask(benchmark::State& state)
+{
+    const bool multi = state.range(0) != 0;
+    const SyntheticResolution& resolution = syntheticResolutions().at(static_cast<size_t>(state.range(1)));
+    const std::vector<int> deltas = {1, 3, 10, 30};
+    constexpr int kSequenceFrames = 32;
+    std::vector<cv::Mat> frames;
+    for (int i = 0; i < kSequenceFrames; ++i) {
+        frames.push_back(makeSyntheticFrame(resolution.size, i));
+    }
+
+    MultiDeltaDetector multiDetector(VideoProcessor::kMaxFrameDelta);
+    std::vector<std::unique_ptr<MotionDetector>> detectors;
+    for (size_t i = 0; i < deltas.size(); ++i) {
+        detectors.push_back(createMotionDetector(MotionAlgorithm::FrameDifference, VideoProcessor::kMaxFrameDelta));
+    }
+    std::vector<cv::Mat> masks(deltas.size());
+    auto detect = [&](const cv::Mat& frame) {
+        if (multi) {
+            multiDetector.detect(frame, deltas, kThreshold, masks);
+            return;
+        }
+        for (size_t i = 0; i < deltas.size(); ++i) {
+            MotionParams params;
+            params.frameDelta = deltas[i];
+            params.threshold = kThreshold;
+            detectors[i]->detect(frame, params, masks[i]);
+        }
+    };
+    for (const cv::Mat& frame : frames) detect(frame);
+
+    size_t next = 0;
+    for (auto _ : state) {
+        detect(frames[next]);
+        benchmark::DoNotOptimize(masks.back().data);
+        next = (next + 1) % frames.size();
+    }
+    state.SetLabel(std::string(multi ? "shared" : "separate") + "/" + resolution.name);
+    state.counters["pixels/s"] = benchmark::Counter(static_cast<double>(state.iterations()) * resolution.size.area(),
+                                                    benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_MultiDeltaMask)->ArgNames({"multi", "res"})->ArgsProduct({{0, 1}, {0, 1, 2}})->Unit(benchmark::kMillisecond);
+
+// Statistics and blob extraction on the mask the fused kernel produced for the clip.
+static void BM_BlobExtract(benchmark::State& state)
+{
+    const cv::Size size = resolutionArg(state).size;
+    cv::Mat previousGray, gray, mask;
+    convertToGray(makeSyntheticFrame(size, 0), previousGray);
+    fusedGrayDiffThreshold(makeSyntheticFrame(size, kDelta), previousGray, kThreshold, gray, mask);
+    BlobExtractor extractor;
+    MotionStats stats;
+    for (auto _ : state) {
+        extractor.extract(mask, 16, 1, stats);
+        benchmark::DoNotOptimize(stats.blobs.data());
+    }
+    setPixelCounters(state, size);
+    state.counters["blobs"] = static_cast<double>(stats.blobs.size());
+}
+BENCHMARK(BM_BlobExtract)->Apply(allResolutions)->Unit(benchmark::kMillisecond);
+
+// Heatmap decay-and-add of one mask: a single pass over the map per frame.
+static void BM_HeatmapAccumulate(benchmark::State& state)
+{
+    const cv::Size size = resolutionArg(state).size;
+    cv::Mat previousGray, gray, mask;
+    convertToGray(makeSyntheticFrame(size, 0), previousGray);
+    fusedGrayDiffThreshold(makeSyntheticFrame(size, kDelta), previousGray, kThreshold, gray, mask);
+    MotionHeatmap heatmap;
+    heatmap.setWindowFrames(300);
+    for (auto _ : state) {
+        heatmap.accumulate(mask);
+        benchmark::DoNotOptimize(heatmap.heat().data);
+    }
+    setPixelCounters(state, size);
+}
+BENCHMARK(BM_HeatmapAccumulate)->Apply(allResolutions)->Unit(benchmark::kMicrosecond);
+
+// 1-bit mask archive coding of the clip's mask; "ratio" is encoded size over CV_8UC1 size.
+static void BM_MaskArchiveEncode(benchmark::State& state)
+{
+    const cv::Size size = resolutionArg(state).size;
+    cv::Mat previousGray, gray, mask;
+    convertToGray(makeSyntheticFrame(size, 0), previousGray);
+    fusedGrayDiffThreshold(makeSyntheticFrame(size, kDelta), previousGray, kThreshold, gray, mask);
+    std::string encoded;
+    for (auto _ : state) {
+        encoded.clear();
+        encodeMaskBlocks(mask, encoded);
+        benchmark::DoNotOptimize(encoded.data());
+    }
+    setPixelCounters(state, size);
+    state.counters["ratio"] = static_cast<double>(encoded.size()) / mask.total();
+}
+BENCHMARK(BM_MaskArchiveEncode)->Apply(allResolutions)->Unit(benchmark::kMicrosecond);
+
+static void BM_MaskArchiveDecode(benchmark::State& state)
+{
+    const cv::Size size = resolutionArg(state).size;
+    cv::Mat previousGray, gray, mask;
+    convertToGray(makeSyntheticFrame(size, 0), previousGray);
+    fusedGrayDiffThreshold(makeSyntheticFrame(size, kDelta), previousGray, kThreshold, gray, mask);
+    std::string encoded;
+    encodeMaskBlocks(mask, encoded);
+    cv::Mat decoded;
+    for (auto _ : state) {
+        decodeMaskBlocks(reinterpret_cast<const uchar*>(encoded.data()), encoded.size(), size, decoded);
+        benchmark::DoNotOptimize(decoded.data);
+    }
+    setPixelCounters(state, size);
+}
+BENCHMARK(BM_MaskArchiveDecode)->Apply(allResolutions)->Unit(benchmark::kMicrosecond);
+
+static void BM_GrayFrameRingPush(benchmark::State& state)
+{
+    const cv::Size size = resolutionArg(state).size;
+    const cv::Mat frame = makeSyntheticFrame(size, 0);
+    GrayFrameRing ring(VideoProcessor::kMaxFrameDelta + 1);
+    for (auto _ : state) {
+        ring.push(frame);
+        benchmark::DoNotOptimize(ring.ago(0).data);
+    }
+    setPixelCounters(state, size);
+}
+BENCHMARK(BM_GrayFrameRingPush)->Apply(allResolutions)->Unit(benchmark::kMillisecond);
+
+// GUI-thread cost of handing a frame to the display (cv::Mat -> QImage -> QPixmap).
+static void BM_DisplaySetFrame(benchmark::State& state)
+{
+    const cv::Size size = resolutionArg(state).size;
+    const cv::Mat frame = makeSyntheticFrame(size, 0);
+    VideoDisplayWidget widget;
+    widget.resize(640, 360);
+    for (auto _ : state) {
+        widget.setFrame(frame);
+    }
+    setPixelCounters(state, size);
+}
+BENCHMARK(BM_DisplaySetFrame)->Apply(allResolutions)->Unit(benchmark::kMillisecond);
+
+// Worker-side preparation for a 640x360 pane (downscale + BGRA) and the GUI-side
+// zero-copy handoff that follows it.
+static void BM_DisplayPrepareScaled(benchmark::State& state)
+{
+    const cv::Size size = resolutionArg(state).size;
+    const cv::Mat frame = makeSyntheticFrame(size, 0);
+    cv::Mat scaled, prepared;
+    for (auto _ : state) {
+        cv::resize(frame, scaled, cv::Size(640, 360), 0, 0, cv::INTER_AREA);
+        cv::cvtColor(scaled, prepared, cv::COLOR_BGR2BGRA);
+        benchmark::DoNotOptimize(prepared.data);
+    }
+    setPixelCounters(state, size);
+}
+BENCHMARK(BM_DisplayPrepareScaled)->Apply(allResolutions)->Unit(benchmark::kMillisecond);
+
+static void BM_DisplaySetPreparedFrame(benchmark::State& state)
+{
+    cv::Mat prepared;
+    cv::cvtColor(makeSyntheticFrame(cv::Size(640, 360), 0), prepared, cv::COLOR_BGR2BGRA);
+    VideoDisplayWidget widget;
+    widget.resize(640, 360);
+    for (auto _ : state) {
+        widget.setFrame(prepared);
+    }
+}
+BENCHMARK(BM_DisplaySetPreparedFrame)->Unit(benchmark::kMicrosecond);
+
+// End to end: decode + analysis through VideoProcessor with pacing disabled.
+// Arg "luma": decode straight to the Y plane instead of BGR (setLumaOnlyDecode).
+static void BM_DecodeAndAnalyze(benchmark::State& state)
+{
+    const bool lumaOnly = state.range(1) != 0;
+    const SyntheticResolution& resolution = resolutionArg(state);
+    const QString clip = ensureSyntheticClip(benchDataDirectory(), resolution, kClipFrames);
+    if (clip.isEmpty()) {
+        state.SkipWithError("Could not generate synthetic clip");
+        return;
+    }
+
+    std::atomic<qint64> frames{0};
+    for (auto _ : state) {
+        VideoProcessor processor;
+        processor.setRealtimePlayback(false);
+        processor.setFrameDelta(kDelta);
+        processor.setMotionThreshold(kThreshold);
+        processor.setLumaOnlyDecode(lumaOnly);
+        QObject::connect(&processor, &VideoProcessor::newFramesReady,
+                         [&frames](const cv::Mat&, const cv::Mat&) { frames.fetch_add(1, std::memory_order_relaxed); });
+
+        QEventLoop loop;
+        bool failed = false;
+        QObject::connect(&processor, &VideoProcessor::processingFinished, &loop, &QEventLoop::quit);
+        QObject::connect(&processor, &VideoProcessor::errorOccurred, &loop, [&loop, &failed]() {
+            failed = true;
+            loop.quit();
+        });
+        processor.loadVideo(clip);
+        if (failed) {
+            state.SkipWithError("Could not open synthetic clip");
+            return;
+        }
+        processor.startProcessing();
+        loop.exec();
+    }
+    state.SetLabel(std::string(resolution.name) + (lumaOnly ? "/luma" : "/bgr"));
+    state.counters["frames/s"] = benchmark::Counter(static_cast<double>(frames.load()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_DecodeAndAnalyze)
+    ->ArgNames({"res", "luma"})
+    ->ArgsProduct({{0, 1, 2}, {0, 1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+int main(int argc, char** argv)
+{
+    // VideoDisplayWidget needs a QApplication; render offscreen so no display is required.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,365 @@
+#include "FrameLayout.h"
+#include "KeyframeIndex.h"
+#include "MaskArchive.h"
+#include "MotionKernel.h"
+#include "SegmentedAnalyzer.h"
+#include "SyntheticVideo.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QtEndian>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Correctness checks for the optimised paths, each against a straightforward reference.
+// Built with the benchmarks, so the numbers MotionBenchmarks reports are known to come
+// from code that produces the same output. Exits non-zero if any check fails.
+
+namespace {
+
+int g_failures = 0;
+
+QTextStream& out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+void fail(const char* check, const QString& detail)
+{
+    out() << "FAIL " << check << ": " << detail << Qt::endl;
+    ++g_failures;
+}
+
+bool sameMat(const cv::Mat& a, const cv::Mat& b)
+{
+    return a.size() == b.size() && a.type() == b.type() && cv::norm(a, b, cv::NORM_INF) == 0;
+}
+
+QString sizeText(const cv::Size& size)
+{
+    return QString("%1x%2").arg(size.width).arg(size.height);
+}
+
+// Random BGR frames of odd and even widths (vector tails) and of sizes large enough to be
+// split into stripes; frame pairs share most pixels, as consecutive video frames do.
+void forEachFramePair(const std::function<void(const cv::Mat&, const cv::Mat&, const cv::Mat&)>& check)
+{
+    const std::vector<cv::Size> sizes = {{1, 1}, {17, 5}, {63, 9}, {641, 37}, {1920, 270}};
+    cv::RNG rng(0x6d6f7470);
+    for (const cv::Size& size : sizes) {
+        for (int i = 0; i < 4; ++i) {
+            cv::Mat older(size, CV_8UC3), previous(size, CV_8UC3), current(size, CV_8UC3);
+            rng.fill(older, cv::RNG::UNIFORM, 0, 256);
+            cv::Mat noise(size, CV_16SC3);
+            rng.fill(noise, cv::RNG::UNIFORM, -40, 41);
+            cv::add(older, noise, previous, cv::noArray(), CV_8U);
+            rng.fill(noise, cv::RNG::UNIFORM, -40, 41);
+            cv::add(previous, noise, current, cv::noArray(), CV_8U);
+            check(older, previous, current);
+        }
+    }
+}
+
+std::vector<int> checkThresholds(cv::RNG& rng)
+{
+    return {0, 1, 254, 255, rng.uniform(2, 254), rng.uniform(2, 254)};
+}
+
+void referenceMask(const cv::Mat& grayA, const cv::Mat& grayB, int threshold, cv::Mat& mask)
+{
+    cv::Mat diff;
+    cv::absdiff(grayA, grayB, diff);
+    cv::threshold(diff, mask, threshold, 255, cv::THRESH_BINARY);
+}
+
+// The fused kernels against cvtColor -> absdiff -> threshold, on the vectorised and the
+// scalar path.
+void checkFusedKernelsMatchReference()
+{
+    const bool optimized = cv::useOptimized();
+    for (const bool vectorize : {true, false}) {
+        cv::setUseOptimized(vectorize);
+        const char* path = vectorize ? " (vector)" : " (scalar)";
+        cv::RNG rng(3);
+
+        // The pixel where 14-bit YUV weights and cvtColor's 15-bit gray weights disagree.
+        const cv::Mat pixel(1, 1, CV_8UC3, cv::Scalar(180, 0, 224));
+        cv::Mat expectedPixel, pixelGray;
+        cv::cvtColor(pixel, expectedPixel, cv::COLOR_BGR2GRAY);
+        if (!convertToGray(pixel, pixelGray) || !sameMat(pixelGray, expectedPixel)) {
+            fail("convertToGray", QString("BGR (180, 0, 224)%1").arg(path));
+        }
+
+        forEachFramePair([&](const cv::Mat& older, const cv::Mat& previous, const cv::Mat& current) {
+            cv::Mat olderGray, previousGray, currentGray;
+            cv::cvtColor(older, olderGray, cv::COLOR_BGR2GRAY);
+            cv::cvtColor(previous, previousGray, cv::COLOR_BGR2GRAY);
+            cv::cvtColor(current, currentGray, cv::COLOR_BGR2GRAY);
+            const QString where = sizeText(current.size()) + path;
+
+            cv::Mat gray;
+            if (!convertToGray(current, gray) || !sameMat(gray, currentGray)) fail("convertToGray", where);
+
+            for (int threshold : checkThresholds(rng)) {
+                const QString at = QString("%1 threshold %2").arg(where).arg(threshold);
+                cv::Mat expected, mask;
+                referenceMask(currentGray, previousGray, threshold, expected);
+                if (!fusedGrayDiffThreshold(current, previousGray, threshold, gray, mask)
+                    || !sameMat(gray, currentGray) || !sameMat(mask, expected)) {
+                    fail("fusedGrayDiffThreshold", at);
+                }
+
+                cv::Mat olderMask;
+                referenceMask(previousGray, olderGray, threshold, olderMask);
+                cv::bitwise_and(expected, olderMask, olderMask);
+                if (!fusedGrayThreeFrameDiff(current, previousGray, olderGray, threshold, gray, mask)
+                    || !sameMat(mask, olderMask)) {
+                    fail("fusedGrayThreeFrameDiff", at);
+                }
+
+                std::vector<cv::Mat> masks;
+                const std::vector<const cv::Mat*> history = {&previousGray, &olderGray};
+                cv::Mat expectedOlder;
+                referenceMask(currentGray, olderGray, threshold, expectedOlder);
+                if (!fusedGrayMultiDiff(current, history, threshold, gray, masks) || masks.size() != 2
+                    || !sameMat(masks[0], expected) || !sameMat(masks[1], expectedOlder)) {
+                    fail("fusedGrayMultiDiff", at);
+                }
+            }
+        });
+    }
+    cv::setUseOptimized(optimized);
+}
+
+// Binary masks covering every block encoding: empty, full, sparse (PackBits) and noise
+// (raw), at widths with and without a partial last byte.
+std::vector<cv::Mat> checkMasks()
+{
+    std::vector<cv::Mat> masks;
+    cv::RNG rng(7);
+    for (const cv::Size& size : {cv::Size(1, 1), cv::Size(13, 17), cv::Size(64, 48), cv::Size(321, 181)}) {
+        masks.push_back(cv::Mat::zeros(size, CV_8UC1));
+        masks.push_back(cv::Mat(size, CV_8UC1, cv::Scalar(255)));
+
+        cv::Mat sparse = cv::Mat::zeros(size, CV_8UC1);
+        cv::rectangle(sparse, cv::Rect(size.width / 4, size.height / 3, size.width / 3 + 1, size.height / 4 + 1),
+                      cv::Scalar(255), cv::FILLED);
+        masks.push_back(sparse);
+
+        cv::Mat noise(size, CV_8UC1);
+        rng.fill(noise, cv::RNG::UNIFORM, 0, 256);
+        cv::threshold(noise, noise, 127, 255, cv::THRESH_BINARY);
+        masks.push_back(noise);
+    }
+    return masks;
+}
+
+// Encodes and decodes every mask, writes them all to an archive, reads the archive back
+// through its index, then again after cutting off the index and footer (a recording that
+// was killed), which the reader must recover by scanning.
+void checkMaskArchiveRoundTrip()
+{
+    const std::vector<cv::Mat> masks = checkMasks();
+    for (const cv::Mat& mask : masks) {
+        std::string encoded;
+        encodeMaskBlocks(mask, encoded);
+        cv::Mat decoded;
+        if (!decodeMaskBlocks(reinterpret_cast<const uchar*>(encoded.data()), encoded.size(), mask.size(), decoded)
+            || !sameMat(decoded, mask)) {
+            fail("encodeMaskBlocks/decodeMaskBlocks", sizeText(mask.size()));
+        }
+    }
+
+    QTemporaryDir directory;
+    const QString path = directory.filePath("check.motmask");
+    MaskArchiveWriter writer;
+    if (!directory.isValid() || !writer.open(path)) {
+        fail("MaskArchiveWriter", "cannot create " + path);
+        return;
+    }
+    writer.append(0, cv::Mat()); // A frame without mask
+    for (size_t i = 0; i < masks.size(); ++i) writer.append(static_cast<qint64>(i) + 1, masks[i]);
+    if (!writer.close()) fail("MaskArchiveWriter", "close() reported a write error");
+
+    auto compareArchive = [&](const char* check) {
+        MaskArchiveReader reader;
+        if (!reader.open(path) || reader.recordCount() != masks.size() + 1) {
+            fail(check, "wrong record count");
+            return;
+        }
+        cv::Mat mask;
+        if (!reader.readFrame(0, mask) || !mask.empty()) fail(check, "frame without mask");
+        for (size_t i = 0; i < masks.size(); ++i) {
+            if (!reader.readFrame(static_cast<qint64>(i) + 1, mask) || !sameMat(mask, masks[i])) {
+                fail(check, QString("frame %1 (%2)").arg(i + 1).arg(sizeText(masks[i].size())));
+            }
+        }
+    };
+    compareArchive("MaskArchiveReader (index)");
+
+    // The footer's first field is the offset of the index, i.e. the end of the records.
+    QFile file(path);
+    if (!file.open(QIODevice::ReadWrite) || file.size() < 16 || !file.seek(file.size() - 16)) {
+        fail("MaskArchiveReader (scan)", "cannot read the footer");
+        return;
+    }
+    const QByteArray footer = file.read(8);
+    const qint64 indexOffset = qFromLittleEndian<qint64>(footer.constData());
+    if (indexOffset <= 0 || indexOffset >= file.size() || !file.resize(indexOffset)) {
+        fail("MaskArchiveReader (scan)", "cannot truncate the archive");
+        return;
+    }
+    file.close();
+    compareArchive("MaskArchiveReader (scan)");
+}
+
+// What a sequential run produces: every frame decoded in order through one detector,
+// with the same downscale, statistics and mask encoding as SegmentedAnalyzer.
+std::vector<SegmentedFrame> sequentialFrames(const QString& path, const SegmentedAnalysisOptions& options)
+{
+    std::vector<SegmentedFrame> frames;
+    cv::VideoCapture capture(path.toStdString());
+    if (!capture.isOpened()) return frames;
+    capture.set(cv::CAP_PROP_CONVERT_RGB, 0);
+    const int codecPixelFormat = static_cast<int>(capture.get(cv::CAP_PROP_CODEC_PIXEL_FORMAT));
+    const int height = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+
+    std::unique_ptr<MotionDetector> detector = createMotionDetector(options.algorithm, options.frameDelta);
+    MotionParams params;
+    params.frameDelta = options.frameDelta;
+    params.threshold = options.motionThreshold;
+    BlobExtractor extractor;
+    cv::Mat image, input, mask;
+    for (qint64 frame = 0; capture.read(image) && !image.empty(); ++frame) {
+        FrameLayout layout;
+        if (!detectFrameLayout(image, height, codecPixelFormat, layout)) return {};
+        const cv::Mat luma = lumaView(image, layout, height);
+        cv::resize(luma, input,
+                   cv::Size(std::max(1, luma.cols / options.analysisScale), std::max(1, luma.rows / options.analysisScale)),
+                   0, 0, cv::INTER_AREA);
+        detector->detect(input, params, mask);
+
+        SegmentedFrame& out = frames.emplace_back();
+        out.stats.frameIndex = frame;
+        extractor.extract(mask, options.minBlobArea, options.analysisScale, out.stats);
+        if (!mask.empty()) {
+            out.maskSize = mask.size();
+            encodeMaskBlocks(mask, out.maskBlocks);
+        }
+    }
+    return frames;
+}
+
+bool sameFrame(const SegmentedFrame& a, const SegmentedFrame& b)
+{
+    if (a.stats.frameIndex != b.stats.frameIndex || a.stats.hasMask != b.stats.hasMask
+        || a.stats.changedPixels != b.stats.changedPixels || a.stats.blobs.size() != b.stats.blobs.size()
+        || a.maskSize != b.maskSize || a.maskBlocks != b.maskBlocks) {
+        return false;
+    }
+    for (size_t i = 0; i < a.stats.blobs.size(); ++i) {
+        if (a.stats.blobs[i].box != b.stats.blobs[i].box || a.stats.blobs[i].area != b.stats.blobs[i].area) return false;
+    }
+    return true;
+}
+
+// A segmented run on several workers against a sequential run over the same clip, for
+// both algorithms that can be segmented. The clip is cut into three segments, so two
+// segment starts have to rebuild their history from the frames in front of them.
+void checkSegmentedClip(const QString& path, int frameCount)
+{
+    const QString clip = QFileInfo(path).fileName();
+    for (const MotionAlgorithm algorithm : {MotionAlgorithm::FrameDifference, MotionAlgorithm::ThreeFrameDifference}) {
+        SegmentedAnalysisOptions options;
+        options.algorithm = algorithm;
+        options.analysisScale = 2;
+        options.workers = 4;
+        options.keepMasks = true;
+        const QString name = QString("%1, %2").arg(motionAlgorithmName(algorithm), clip);
+
+        const std::vector<SegmentedFrame> expected = sequentialFrames(path, options);
+        if (static_cast<int>(expected.size()) != frameCount) {
+            fail("sequential reference", QString("%1 of %2 frames (%3)").arg(expected.size()).arg(frameCount).arg(name));
+            continue;
+        }
+
+        SegmentedAnalyzer analyzer(options);
+        std::vector<SegmentedFrame> frames;
+        const std::atomic<bool> cancel(false);
+        if (!analyzer.open(path)
+            || !analyzer.run([&](const SegmentedFrame& frame) { frames.push_back(frame); }, cancel)) {
+            fail("SegmentedAnalyzer", "run failed (" + name + ")");
+            continue;
+        }
+        if (frames.size() != expected.size()) {
+            fail("SegmentedAnalyzer", QString("%1 of %2 frames (%3)").arg(frames.size()).arg(expected.size()).arg(name));
+            continue;
+        }
+        for (size_t i = 0; i < frames.size(); ++i) {
+            if (!sameFrame(frames[i], expected[i])) {
+                fail("SegmentedAnalyzer", QString("frame %1 differs from the sequential run (%2)").arg(i).arg(name));
+                break;
+            }
+        }
+    }
+}
+
+// Once on an all-keyframe MJPG clip and once on an MPEG-4 clip with GOPs of several
+// frames, where segment starts seek to an earlier keyframe and decode forward.
+void checkSegmentedMatchesSequential()
+{
+    QTemporaryDir directory;
+    const int frameCount = static_cast<int>(3 * SegmentedAnalyzer::kMinSegmentFrames + 100);
+    const cv::Size size(160, 120);
+    if (!directory.isValid()) {
+        fail("SegmentedAnalyzer", "cannot create a temporary directory");
+        return;
+    }
+
+    const QString intraPath = directory.filePath("segments.avi");
+    if (!writeSyntheticClip(intraPath, size, frameCount)) {
+        fail("SegmentedAnalyzer", "cannot write " + intraPath);
+    } else {
+        checkSegmentedClip(intraPath, frameCount);
+    }
+
+    const QString interPath = directory.filePath("segments.mp4");
+    if (!writeSyntheticClip(interPath, size, frameCount, 30.0, cv::VideoWriter::fourcc('m', 'p', '4', 'v'))) {
+        fail("SegmentedAnalyzer", "cannot write " + interPath);
+        return;
+    }
+    const std::atomic<bool> cancel(false);
+    const KeyframeIndex keyframes = KeyframeIndex::build(interPath.toStdString(), cancel);
+    if (keyframes.isExact() && keyframes.keyframeCount() >= static_cast<size_t>(frameCount)) {
+        fail("SegmentedAnalyzer", interPath + " has no inter-coded frames");
+        return;
+    }
+    checkSegmentedClip(interPath, frameCount);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+    const std::vector<std::pair<const char*, std::function<void()>>> checks = {
+        {"fused kernels match the reference chain", checkFusedKernelsMatchReference},
+        {"mask archive round trip", checkMaskArchiveRoundTrip},
+        {"segmented analysis matches a sequential run", checkSegmentedMatchesSequential},
+    };
+    for (const auto& [name, check] : checks) {
+        const int failuresBefore = g_failures;
+        check();
+        out() << (g_failures == failuresBefore ? "ok   " : "FAIL ") << name << Qt::endl;
+    }
+    return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+#include "ActivityIndex.h"
+#include "FrameLayout.h"
+#include "KeyframeIndex.h"
+#include "MotionDetector.h"
+#include <opencv2/opencv.hpp>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr char kMagic[8] = {'M', 'O', 'T', 'A', 'C', 'T', '\0', '\0'};
+constexpr quint32 kVersion = 1;
+// magic, version, frame delta, threshold, complete flag
+constexpr qint64 kHeaderBytes = 24;
+constexpr qint64 kCompleteFlagOffset = 20;
+constexpr qint64 kSampleBytes = 1024 * 1024;
+// Scores are appended in batches of this many frames.
+constexpr size_t kWriteBatchFrames = 256;
+// The container's frame count is only an estimate (FFmpeg derives it from the duration,
+// or reports 0). A stream that ends cleanly but short of this share of it is taken as
+// truncated rather than complete.
+constexpr double kMinEndShare = 0.9;
+
+QByteArray header(int frameDelta, int threshold, bool complete)
+{
+    QByteArray bytes(kMagic, sizeof(kMagic));
+    const quint32 fields[] = {kVersion, static_cast<quint32>(frameDelta), static_cast<quint32>(threshold),
+                              complete ? 1u : 0u};
+    for (quint32 field : fields) {
+        const quint32 le = qToLittleEndian(field);
+        bytes.append(reinterpret_cast<const char*>(&le), sizeof(le));
+    }
+    return bytes;
+}
+
+bool appendScores(QFile& file, const quint16* scores, size_t count)
+{
+    std::vector<quint16> le(scores, scores + count);
+    for (quint16& score : le) score = qToLittleEndian(score);
+    const qint64 bytes = static_cast<qint64>(count * sizeof(quint16));
+    return file.write(reinterpret_cast<const char*>(le.data()), bytes) == bytes && file.flush();
+}
+
+} // namespace
+
+QString ActivityIndex::cachePath(const QString& videoPath, int frameDelta, int threshold)
+{
+    QFile file(videoPath);
+    if (!file.open(QIODevice::ReadOnly)) return QString();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const qint64 size = file.size();
+    hash.addData(QByteArray::number(size));
+    for (qint64 offset : {qint64(0), size / 2 - kSampleBytes / 2, size - kSampleBytes}) {
+        if (!file.seek(std::max<qint64>(0, offset))) return QString();
+        hash.addData(file.read(kSampleBytes));
+    }
+
+    const QString directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/activity";
+    return QString("%1/%2-d%3-t%4.act")
+        .arg(directory, QString::fromLatin1(hash.result().toHex()))
+        .arg(frameDelta)
+        .arg(threshold);
+}
+
+ActivityIndex ActivityIndex::load(const QString& cachePath, int frameDelta, int threshold)
+{
+    ActivityIndex index;
+    QFile file(cachePath);
+    if (!file.open(QIODevice::ReadOnly)) return index;
+
+    const QByteArray bytes = file.readAll();
+    if (bytes.size() < kHeaderBytes
+        || !bytes.startsWith(header(frameDelta, threshold, false).left(kCompleteFlagOffset))) {
+        qWarning() << "Ignoring unreadable activity cache:" << cachePath;
+        return index;
+    }
+
+    const uchar* data = reinterpret_cast<const uchar*>(bytes.constData());
+    index.m_complete = qFromLittleEndian<quint32>(data + kCompleteFlagOffset) != 0;
+    // An odd trailing byte is a score that was only partly written.
+    const size_t count = static_cast<size_t>(bytes.size() - kHeaderBytes) / sizeof(quint16);
+    index.m_scores.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        index.m_scores[i] = qFromLittleEndian<quint16>(data + kHeaderBytes + i * sizeof(quint16));
+    }
+    return index;
+}
+
+bool ActivityIndex::build(const QString& videoPath, int frameDelta, int threshold, const std::atomic<bool>& cancel,
+                          const std::function<void(const ActivityIndex&)>& progress, ActivityIndex& index)
+{
+    const QString cache = cachePath(videoPath, frameDelta, threshold);
+    if (cache.isEmpty()) return false;
+
+    index = load(cache, frameDelta, threshold);
+    progress(index);
+    if (index.m_complete) return true;
+
+    QDir().mkpath(QFileInfo(cache).path());
+    QFile file(cache);
+    if (!file.open(QIODevice::ReadWrite)) {
+        qWarning() << "Failed to open activity cache:" << cache;
+        return false;
+    }
+    if (index.m_scores.empty()) {
+        // New (or unreadable) cache: start it over.
+        if (!file.resize(0) || file.write(header(frameDelta, threshold, false)) != kHeaderBytes) return false;
+    } else {
+        // Drop a partly written last score before appending.
+        if (!file.resize(kHeaderBytes + static_cast<qint64>(index.m_scores.size() * sizeof(quint16)))) return false;
+    }
+    file.seek(file.size());
+
+    cv::VideoCapture capture(videoPath.toStdString());
+    if (!capture.isOpened()) {
+        qWarning() << "ActivityIndex: Failed to open" << videoPath;
+        return false;
+    }
+    // Luma is all the scores need; see VideoProcessor::setLumaOnlyDecode().
+    capture.set(cv::CAP_PROP_CONVERT_RGB, 0);
+    const int codecPixelFormat = static_cast<int>(capture.get(cv::CAP_PROP_CODEC_PIXEL_FORMAT));
+    const int height = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+    const qint64 frameCount = static_cast<qint64>(capture.get(cv::CAP_PROP_FRAME_COUNT));
+
+    // Resume delta frames early so the first missing frame has its comparison frame.
+    // CAP_PROP_POS_FRAMES only lands exactly on a keyframe, so seek to the keyframe at or
+    // before that frame and decode forward; without an exact index, decode from the start.
+    const qint64 firstMissing = static_cast<qint64>(index.m_scores.size());
+    const qint64 resumeFrame = std::max<qint64>(0, firstMissing - frameDelta);
+    qint64 frame = 0;
+    if (resumeFrame > 0) {
+        const KeyframeIndex keyframes = KeyframeIndex::build(videoPath.toStdString(), cancel);
+        if (keyframes.isExact()) {
+            frame = keyframes.keyframeAtOrBefore(resumeFrame);
+            if (frame > 0) capture.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(frame));
+        }
+        while (frame < resumeFrame && !cancel.load() && capture.grab()) ++frame;
+    }
+    if (firstMissing > 0) qInfo() << "Resuming activity index of" << videoPath << "at frame" << firstMissing;
+
+    std::unique_ptr<MotionDetector> detector = createMotionDetector(MotionAlgorithm::FrameDifference, frameDelta);
+    MotionParams params;
+    params.frameDelta = frameDelta;
+    params.threshold = threshold;
+
+    cv::Mat image;
+    cv::Mat small;
+    cv::Mat mask;
+    size_t unwritten = 0;
+    QElapsedTimer progressTimer;
+    progressTimer.start();
+    bool ok = true;
+
+    while (!cancel.load()) {
+        if (!capture.read(image) || image.empty()) {
+            // Only a clean end of stream (a further grab() fails as well) completes the
+            // index; a decode error leaves it incomplete so the next build retries there.
+            const bool endOfStream = !capture.grab();
+            if (endOfStream && (frameCount <= 0 || frame >= kMinEndShare * frameCount)) {
+                index.m_complete = true;
+            } else {
+                qWarning() << "ActivityIndex: decoding" << videoPath << "stopped at frame" << frame << "of about"
+                           << frameCount;
+            }
+            break;
+        }
+        FrameLayout layout;
+        if (!detectFrameLayout(image, height, codecPixelFormat, layout)) {
+            qWarning() << "ActivityIndex: unsupported frame layout in" << videoPath;
+            ok = false;
+            break;
+        }
+        const cv::Mat luma = lumaView(image, layout, height);
+        cv::resize(luma, small, cv::Size(std::max(1, luma.cols / kAnalysisScale), std::max(1, luma.rows / kAnalysisScale)),
+                   0, 0, cv::INTER_AREA);
+        detector->detect(small, params, mask);
+
+        if (frame >= firstMissing) {
+            const double ratio = mask.empty() ? 0.0 : static_cast<double>(cv::countNonZero(mask)) / mask.total();
+            index.m_scores.push_back(static_cast<quint16>(std::lround(ratio * 65535.0)));
+            ++unwritten;
+        }
+        ++frame;
+
+        if (unwritten >= kWriteBatchFrames) {
+            ok = appendScores(file, index.m_scores.data() + index.m_scores.size() - unwritten, unwritten);
+            unwritten = 0;
+            if (!ok) break;
+        }
+        if (progressTimer.elapsed() >= kProgressIntervalMs) {
+            progress(index);
+            progressTimer.restart();
+        }
+    }
+
+    if (ok && unwritten > 0) ok = appendScores(file, index.m_scores.data() + index.m_scores.size() - unwritten, unwritten);
+    if (ok && index.m_complete) {
+        const quint32 complete = qToLittleEndian<quint32>(1);
+        ok = file.seek(kCompleteFlagOffset) && file.write(reinterpret_cast<const char*>(&complete), sizeof(complete)) == 4;
+    }
+    if (!ok) qWarning() << "Failed to write activity cache:" << cache;
+    progress(index);
+    return ok;
+}
+
+std::vector<std::pair<qint64, qint64>> ActivityIndex::events(double minRatio, qint64 maxGap) const
+{
+    const quint16 minScore = static_cast<quint16>(std::clamp(std::lround(minRatio * 65535.0), 1L, 65535L));
+    std::vector<std::pair<qint64, qint64>> result;
+    for (size_t frame = 0; frame < m_scores.size(); ++frame) {
+        if (m_scores[frame] < minScore) continue;
+        const qint64 current = static_cast<qint64>(frame);
+        if (!result.empty() && current - result.back().second <= maxGap + 1) result.back().second = current;
+        else result.emplace_back(current, current);
+    }
+    return result;
+}
+
+// --- ActivityIndexer ---
+
+ActivityIndexer::ActivityIndexer(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ActivityIndexer::~ActivityIndexer()
+{
+    cancel();
+    // Shutdown is the one place that waits: the builds call back into this object.
+    for (const auto& thread : m_retiredThreads) thread->wait();
+}
+
+void ActivityIndexer::start(const QString& videoPath, int frameDelta, int threshold)
+{
+    cancel();
+    quint64 generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        generation = m_generation;
+    }
+    auto cancelBuild = std::make_shared<std::atomic<bool>>(false);
+    m_cancel = cancelBuild;
+
+    m_thread.reset(QThread::create([this, videoPath, frameDelta, threshold, cancelBuild, generation] {
+        // A cancelled build may still be flushing the same cache file; let it finish first.
+        std::lock_guard<std::mutex> buildLock(m_buildMutex);
+        if (cancelBuild->load()) return;
+        ActivityIndex index;
+        QElapsedTimer timer;
+        timer.start();
+        const bool ok = ActivityIndex::build(videoPath, frameDelta, threshold, *cancelBuild,
+                                             [this, generation](const ActivityIndex& current) { publish(current, generation); },
+                                             index);
+        if (ok && index.isComplete() && !cancelBuild->load()) {
+            qInfo() << "Activity index ready:" << index.frameCount() << "frames in" << timer.elapsed() << "ms";
+        }
+    }));
+    m_thread->start(QThread::LowPriority);
+}
+
+void ActivityIndexer::cancel()
+{
+    // Called on the GUI thread, so the build is not joined: it stops at its next frame,
+    // and publish() drops anything it reports from now on.
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_generation;
+        m_snapshot.reset();
+    }
+    m_retiredThreads.erase(std::remove_if(m_retiredThreads.begin(), m_retiredThreads.end(),
+                                          [](const std::unique_ptr<QThread>& thread) { return thread->isFinished(); }),
+                           m_retiredThreads.end());
+    if (!m_thread) return;
+    m_cancel->store(true);
+    m_retiredThreads.push_back(std::move(m_thread));
+}
+
+std::shared_ptr<const ActivityIndex> ActivityIndexer::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_snapshot;
+}
+
+void ActivityIndexer::publish(const ActivityIndex& index, quint64 generation)
+{
+    auto snapshot = std::make_shared<const ActivityIndex>(index);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (generation != m_generation) return; // From a cancelled build
+        m_snapshot = snapshot;
+    }
+    emit indexUpdated(static_cast<qint64>(index.frameCount()), index.isComplete());
+}
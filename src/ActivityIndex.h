@@ -0,0 +1,93 @@
+#ifndef ACTIVITYINDEX_H
+#define ACTIVITYINDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Per-frame motion score of a whole video: the share of pixels that changed against the
+// frame delta frames earlier (frame difference at 1/kAnalysisScale resolution).
+//
+// Scores are cached on disk per (file content, delta, threshold) so a file only has to be
+// decoded once. The cache key hashes the file size and three 1 MiB samples (start,
+// middle, end) rather than the whole file, so it is cheap to compute for huge files and
+// survives renames. The cache file is a small header followed by one quint16 score per
+// frame, appended while the index is built; an interrupted build resumes at the first
+// missing frame.
+class ActivityIndex
+{
+public:
+    static constexpr int kAnalysisScale = 4;
+
+    // Cache file for this video and settings; empty if the video can't be read.
+    static QString cachePath(const QString& videoPath, int frameDelta, int threshold);
+
+    // Reads a (possibly partial) cache file. Returns an empty index if there is none.
+    static ActivityIndex load(const QString& cachePath, int frameDelta, int threshold);
+
+    // Blocking: decodes the frames missing from the cache and appends their scores,
+    // reporting progress roughly every kProgressIntervalMs. Returns early (keeping what
+    // was written) once cancel is set. Returns false if the video can't be read. The
+    // index is only marked complete when decoding reaches a clean end of the stream.
+    static bool build(const QString& videoPath, int frameDelta, int threshold, const std::atomic<bool>& cancel,
+                      const std::function<void(const ActivityIndex&)>& progress, ActivityIndex& index);
+
+    size_t frameCount() const { return m_scores.size(); }
+    bool isComplete() const { return m_complete; }
+    // Share of changed pixels, 0..1.
+    double motionRatio(size_t frame) const { return m_scores[frame] / 65535.0; }
+    const std::vector<quint16>& scores() const { return m_scores; }
+
+    // Frame ranges [first, last] whose score is at least minRatio; ranges closer than
+    // maxGap frames are merged.
+    std::vector<std::pair<qint64, qint64>> events(double minRatio, qint64 maxGap) const;
+
+private:
+    static constexpr int kProgressIntervalMs = 1000;
+
+    std::vector<quint16> m_scores;
+    bool m_complete = false;
+};
+
+// Builds the activity index of one video on a background thread (the same way
+// VideoProcessor builds its keyframe index) and publishes snapshots as it goes.
+class ActivityIndexer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ActivityIndexer(QObject *parent = nullptr);
+    ~ActivityIndexer() override;
+
+    // Cancels any running build, then loads the cache and resumes building if incomplete.
+    void start(const QString& videoPath, int frameDelta, int threshold);
+    // Does not wait: a cancelled build stops on its own and its results are dropped.
+    void cancel();
+
+    // Latest published state; null before the first one. Thread-safe.
+    std::shared_ptr<const ActivityIndex> snapshot() const;
+
+signals:
+    // Emitted from the build thread after each new snapshot.
+    void indexUpdated(qint64 framesIndexed, bool complete);
+
+private:
+    void publish(const ActivityIndex& index, quint64 generation);
+
+    std::unique_ptr<QThread> m_thread;
+    std::shared_ptr<std::atomic<bool>> m_cancel; // Of the current build
+    // Cancelled builds that may still be running; joined only by the destructor.
+    std::vector<std::unique_ptr<QThread>> m_retiredThreads;
+    std::mutex m_buildMutex; // Held by the running build so cache writes never overlap
+    mutable std::mutex m_mutex;
+    quint64 m_generation = 0; // Bumped by cancel(); guarded by m_mutex
+    std::shared_ptr<const ActivityIndex> m_snapshot;
+};
+
+#endif // ACTIVITYINDEX_H
@@ -0,0 +1,107 @@
+#include "ActivityStripWidget.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <algorithm>
+#include <cmath>
+
+ActivityStripWidget::ActivityStripWidget(QWidget *parent) : QWidget(parent)
+{
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    setToolTip("Motion activity (click to seek)");
+}
+
+QSize ActivityStripWidget::sizeHint() const
+{
+    return QSize(320, 24);
+}
+
+void ActivityStripWidget::setIndex(std::shared_ptr<const ActivityIndex> index, qint64 frameCount)
+{
+    m_index = std::move(index);
+    m_frameCount = std::max<qint64>(frameCount, m_index ? static_cast<qint64>(m_index->frameCount()) : 0);
+    renderStrip();
+    update();
+}
+
+void ActivityStripWidget::setCurrentFrame(qint64 frameIndex)
+{
+    if (frameIndex == m_currentFrame) return;
+    m_currentFrame = frameIndex;
+    update();
+}
+
+void ActivityStripWidget::clear()
+{
+    m_index.reset();
+    m_frameCount = 0;
+    m_currentFrame = -1;
+    m_strip = QImage();
+    update();
+}
+
+void ActivityStripWidget::renderStrip()
+{
+    if (!m_index || m_frameCount <= 0 || width() <= 0 || height() <= 0) {
+        m_strip = QImage();
+        return;
+    }
+
+    m_strip = QImage(width(), height(), QImage::Format_RGB32);
+    m_strip.fill(QColor(40, 40, 40));
+    QPainter painter(&m_strip);
+
+    const std::vector<quint16>& scores = m_index->scores();
+    const qint64 indexed = static_cast<qint64>(scores.size());
+    for (int x = 0; x < width(); ++x) {
+        const qint64 first = m_frameCount * x / width();
+        const qint64 last = std::max(first + 1, m_frameCount * (x + 1) / width());
+        if (first >= indexed) {
+            painter.fillRect(x, 0, 1, height(), QColor(90, 90, 90)); // Not indexed yet
+            continue;
+        }
+        const quint16 peak = *std::max_element(scores.begin() + first, scores.begin() + std::min(last, indexed));
+        if (peak == 0) continue;
+        // Square root so that small movers (a few percent of the frame) stay visible.
+        const double level = std::sqrt(peak / 65535.0);
+        const int bar = std::max(1, static_cast<int>(std::lround(level * height())));
+        painter.fillRect(x, height() - bar, 1, bar, QColor::fromHsvF(0.33 * (1.0 - level), 0.9, 0.95));
+    }
+}
+
+void ActivityStripWidget::paintEvent(QPaintEvent* event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+    if (m_strip.isNull()) {
+        painter.fillRect(rect(), QColor(40, 40, 40));
+    } else {
+        painter.drawImage(0, 0, m_strip);
+    }
+    if (m_frameCount > 0 && m_currentFrame >= 0) {
+        const int x = static_cast<int>(m_currentFrame * width() / m_frameCount);
+        painter.setPen(Qt::white);
+        painter.drawLine(x, 0, x, height());
+    }
+}
+
+void ActivityStripWidget::resizeEvent(QResizeEvent* event)
+{
+    QWidget::resizeEvent(event);
+    renderStrip();
+}
+
+qint64 ActivityStripWidget::frameAt(int x) const
+{
+    const int clamped = std::clamp(x, 0, std::max(0, width() - 1));
+    return std::min(m_frameCount - 1, m_frameCount * clamped / std::max(1, width()));
+}
+
+void ActivityStripWidget::mousePressEvent(QMouseEvent* event)
+{
+    if (event->button() == Qt::LeftButton && m_frameCount > 0) emit frameRequested(frameAt(event->position().toPoint().x()));
+}
+
+void ActivityStripWidget::mouseMoveEvent(QMouseEvent* event)
+{
+    if ((event->buttons() & Qt::LeftButton) && m_frameCount > 0) emit frameRequested(frameAt(event->position().toPoint().x()));
+}
@@ -0,0 +1,47 @@
+#ifndef ACTIVITYSTRIPWIDGET_H
+#define ACTIVITYSTRIPWIDGET_H
+
+#include <QWidget>
+#include <QImage>
+#include <memory>
+
+#include "ActivityIndex.h"
+
+// Thin strip above the timeline showing the motion score of every frame: one bar per
+// pixel column (the column's highest score), frames not yet indexed in gray, and the
+// current position as a line. Clicking or dragging requests a seek.
+class ActivityStripWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ActivityStripWidget(QWidget *parent = nullptr);
+
+    QSize sizeHint() const override;
+
+public slots:
+    // frameCount is the length of the video (the index may cover only part of it yet).
+    void setIndex(std::shared_ptr<const ActivityIndex> index, qint64 frameCount);
+    void setCurrentFrame(qint64 frameIndex);
+    void clear();
+
+signals:
+    void frameRequested(qint64 frameIndex);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+
+private:
+    void renderStrip();
+    qint64 frameAt(int x) const;
+
+    std::shared_ptr<const ActivityIndex> m_index;
+    qint64 m_frameCount = 0;
+    qint64 m_currentFrame = -1;
+    QImage m_strip; // Bars for the current index and width, redrawn only when those change
+};
+
+#endif // ACTIVITYSTRIPWIDGET_H
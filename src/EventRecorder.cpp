@@ -0,0 +1,225 @@
+#include "EventRecorder.h"
+#include "Profiler.h"
+#include "VideoExporter.h"
+#include <QDebug>
+#include <QDir>
+#include <algorithm>
+#include <cmath>
+
+EventRecorder::EventRecorder(QObject *parent)
+    : QObject(parent)
+{
+}
+
+EventRecorder::~EventRecorder()
+{
+    stop();
+}
+
+bool EventRecorder::start(const EventRecorderSettings& settings, double fps)
+{
+    stop();
+    if (settings.outputDir.isEmpty() || !QDir().mkpath(settings.outputDir)) {
+        qWarning() << "EventRecorder: Cannot write to" << settings.outputDir;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_settings = settings;
+    m_settings.triggerFrames = std::max(1, settings.triggerFrames);
+    m_fps = fps > 0 ? fps : 30.0;
+    // The trigger frames themselves are kept on top of the pre-roll, so the clip still
+    // starts preRollSeconds before the motion began.
+    m_preRollFrames = static_cast<size_t>(std::lround(std::max(0.0, settings.preRollSeconds) * m_fps)) +
+                      static_cast<size_t>(m_settings.triggerFrames);
+    m_postRollFrames = std::max<qint64>(1, std::lround(std::max(0.0, settings.postRollSeconds) * m_fps));
+    m_queue.clear();
+    m_nextFrame = -1;
+    m_motionFrames = 0;
+    m_clipsWritten = 0;
+    m_framesDropped = 0;
+    m_running = true;
+    m_stopping = false;
+    m_thread = std::thread([this] { recorderLoop(); });
+    return true;
+}
+
+bool EventRecorder::isRunning() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_running;
+}
+
+void EventRecorder::submit(qint64 frameIndex, const cv::Mat& frame, FrameLayout layout, const cv::Mat& mask)
+{
+    if (frame.empty()) return;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        // A dropped frame still advances the stream, so only a seek is a discontinuity.
+        const bool discontinuity = m_nextFrame >= 0 && frameIndex != m_nextFrame;
+        m_nextFrame = frameIndex + 1;
+        if (m_queue.size() >= kQueueCapacity) {
+            if (!m_settings.waitWhenBehind) {
+                m_framesDropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            m_itemTaken.wait(lock, [this] { return !m_running || m_queue.size() < kQueueCapacity; });
+            if (!m_running) return;
+        }
+        // Only references, as in VideoExporter::submit().
+        m_queue.push_back({frameIndex, frame, layout, mask, discontinuity});
+    }
+    m_itemQueued.notify_one();
+}
+
+void EventRecorder::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return;
+        m_running = false;
+        m_stopping = true;
+    }
+    m_itemQueued.notify_one();
+    m_itemTaken.notify_all(); // Release a producer waiting on a full queue
+    m_thread.join();
+
+    qInfo() << "EventRecorder:" << clipsWritten() << "clips written to" << m_settings.outputDir << "("
+            << framesDropped() << "frames dropped )";
+}
+
+void EventRecorder::recorderLoop()
+{
+    Profiler::setThreadName("events");
+    Item item;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_itemQueued.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty()) break; // Stopping and drained
+            item = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        m_itemTaken.notify_one();
+
+        process(item);
+        item = Item(); // Let go of the frame before waiting for the next one
+    }
+
+    finishClip();
+    clearPreRoll();
+    m_colorScratch.release();
+    m_bgr.release();
+    m_resized.release();
+}
+
+void EventRecorder::process(const Item& item)
+{
+    if (item.discontinuity) {
+        // The footage before a seek is no pre-roll for what follows it.
+        finishClip();
+        clearPreRoll();
+        m_motionFrames = 0;
+    }
+
+    const cv::Mat& image = displayImage(item.frame, item.layout, m_colorScratch);
+    if (image.channels() == 4) cv::cvtColor(image, m_bgr, cv::COLOR_BGRA2BGR);
+    else if (image.channels() == 1) cv::cvtColor(image, m_bgr, cv::COLOR_GRAY2BGR);
+    else image.copyTo(m_bgr);
+
+    const double ratio = item.mask.empty() ? 0.0 : static_cast<double>(cv::countNonZero(item.mask)) / item.mask.total();
+    const bool motion = ratio >= m_settings.triggerRatio;
+    m_motionFrames = motion ? m_motionFrames + 1 : 0;
+
+    if (m_writer.isOpened()) {
+        writeFrame(m_bgr);
+        m_clipLastFrame = item.frameIndex;
+        m_quietFrames = motion ? 0 : m_quietFrames + 1;
+        if (m_quietFrames >= m_postRollFrames) finishClip();
+        return;
+    }
+
+    if (m_motionFrames >= m_settings.triggerFrames) {
+        startClip(item.frameIndex, m_bgr.size());
+        if (m_writer.isOpened()) {
+            writeFrame(m_bgr);
+            m_clipLastFrame = item.frameIndex;
+            return;
+        }
+        m_motionFrames = 0; // Could not create the file; try again on the next trigger
+    }
+    pushPreRoll(item.frameIndex, m_bgr);
+}
+
+void EventRecorder::pushPreRoll(qint64 frameIndex, const cv::Mat& bgr)
+{
+    CompressedFrame compressed;
+    compressed.frameIndex = frameIndex;
+    // Recycle the oldest buffer once the ring is full instead of allocating a new one.
+    if (m_preRoll.size() >= m_preRollFrames) {
+        compressed.jpeg = std::move(m_preRoll.front().jpeg);
+        m_preRollBytes -= compressed.jpeg.size();
+        m_preRoll.pop_front();
+    }
+
+    static const std::vector<int> params = {cv::IMWRITE_JPEG_QUALITY, kJpegQuality};
+    if (!cv::imencode(".jpg", bgr, compressed.jpeg, params)) return;
+    m_preRollBytes += compressed.jpeg.size();
+    m_preRoll.push_back(std::move(compressed));
+    while (m_preRoll.size() > 1 && m_preRollBytes > kPreRollBytes) {
+        m_preRollBytes -= m_preRoll.front().jpeg.size();
+        m_preRoll.pop_front();
+    }
+}
+
+void EventRecorder::clearPreRoll()
+{
+    m_preRoll.clear();
+    m_preRollBytes = 0;
+}
+
+void EventRecorder::startClip(qint64 frameIndex, const cv::Size& size)
+{
+    m_clipFirstFrame = m_preRoll.empty() ? frameIndex : m_preRoll.front().frameIndex;
+    m_clipPath = QDir(m_settings.outputDir)
+                     .filePath(QString("%1.event-%2.%3")
+                                   .arg(m_settings.baseName)
+                                   .arg(m_clipFirstFrame, 6, 10, QChar('0'))
+                                   .arg(m_settings.extension));
+    if (!openVideoWriter(m_writer, m_clipPath, m_fps, size, true)) {
+        qWarning() << "EventRecorder: Failed to create video file:" << m_clipPath;
+        clearPreRoll();
+        return;
+    }
+    m_clipSize = size;
+    m_quietFrames = 0;
+    emit clipStarted(m_clipPath, m_clipFirstFrame);
+
+    cv::Mat decoded;
+    for (const CompressedFrame& compressed : m_preRoll) {
+        decoded = cv::imdecode(compressed.jpeg, cv::IMREAD_COLOR);
+        if (!decoded.empty()) writeFrame(decoded);
+    }
+    clearPreRoll();
+}
+
+void EventRecorder::finishClip()
+{
+    if (!m_writer.isOpened()) return;
+    m_writer.release();
+    m_clipsWritten.fetch_add(1, std::memory_order_relaxed);
+    qInfo() << "EventRecorder: Wrote" << m_clipPath << "frames" << m_clipFirstFrame << "to" << m_clipLastFrame;
+    emit clipFinished(m_clipPath, m_clipFirstFrame, m_clipLastFrame);
+}
+
+void EventRecorder::writeFrame(const cv::Mat& bgr)
+{
+    // The clip keeps the size of the frame that triggered it.
+    if (bgr.size() != m_clipSize) {
+        cv::resize(bgr, m_resized, m_clipSize, 0, 0, cv::INTER_AREA);
+        m_writer.write(m_resized);
+        return;
+    }
+    m_writer.write(bgr);
+}
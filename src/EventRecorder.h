@@ -0,0 +1,126 @@
+#ifndef EVENTRECORDER_H
+#define EVENTRECORDER_H
+
+#include "FrameLayout.h"
+#include <QObject>
+#include <QString>
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct EventRecorderSettings
+{
+    QString outputDir;            // Clips are written here...
+    QString baseName = "motion";  // ... as <baseName>.event-<first frame>.<extension>
+    QString extension = "mp4";    // See openVideoWriter()
+    double triggerRatio = 0.01;   // Share of changed mask pixels that counts as motion
+    int triggerFrames = 5;        // Consecutive motion frames that start a clip
+    double preRollSeconds = 5.0;  // Footage before the trigger included in the clip
+    double postRollSeconds = 5.0; // A clip ends after this long without motion
+    // Headless analysis has no clock to keep, so it may wait for the recorder instead of
+    // dropping frames.
+    bool waitWhenBehind = false;
+};
+
+// Writes a clip around every stretch of motion. submit() takes references to each
+// analysed frame and its mask; everything else happens on the recorder thread. Until
+// motion is seen, frames are JPEG-compressed into a pre-roll ring bounded by
+// preRollSeconds and kPreRollBytes. Once the changed-pixel share stays above
+// triggerRatio for triggerFrames frames, a clip is opened. The ring is written to it
+// first, then the frames that follow, until postRollSeconds pass without motion.
+//
+// submit() never blocks (unless waitWhenBehind): when the recorder is kQueueCapacity
+// frames behind, the frame is dropped and counted. Memory is bounded by the queue and
+// the ring however long the input is. A jump in frame numbers (seek) ends the clip and
+// empties the ring.
+class EventRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Frames the recorder may lag behind before submit() drops frames.
+    static constexpr size_t kQueueCapacity = 32;
+    // Upper bound on the compressed pre-roll, whatever preRollSeconds says.
+    static constexpr size_t kPreRollBytes = 256 * 1024 * 1024;
+    static constexpr int kJpegQuality = 90;
+
+    explicit EventRecorder(QObject *parent = nullptr);
+    ~EventRecorder() override;
+
+    // Starts the recorder thread; stops a previous recording first.
+    bool start(const EventRecorderSettings& settings, double fps);
+    // Finishes the clip in progress (post-roll cut short) and stops the thread.
+    void stop();
+    bool isRunning() const;
+
+    // Producer (processing thread) only. mask may be empty (no motion history yet).
+    void submit(qint64 frameIndex, const cv::Mat& frame, FrameLayout layout, const cv::Mat& mask);
+
+    quint64 clipsWritten() const { return m_clipsWritten.load(std::memory_order_relaxed); }
+    quint64 framesDropped() const { return m_framesDropped.load(std::memory_order_relaxed); }
+
+signals:
+    // Emitted from the recorder thread.
+    void clipStarted(const QString& path, qint64 firstFrame);
+    void clipFinished(const QString& path, qint64 firstFrame, qint64 lastFrame);
+
+private:
+    struct Item
+    {
+        qint64 frameIndex = -1;
+        cv::Mat frame;
+        FrameLayout layout = FrameLayout::Bgr;
+        cv::Mat mask;
+        bool discontinuity = false; // Not the frame after the previous submit (seek)
+    };
+
+    struct CompressedFrame
+    {
+        qint64 frameIndex = -1;
+        std::vector<uchar> jpeg;
+    };
+
+    void recorderLoop();
+    void process(const Item& item);
+    void pushPreRoll(qint64 frameIndex, const cv::Mat& bgr);
+    void clearPreRoll();
+    void startClip(qint64 frameIndex, const cv::Size& size);
+    void finishClip();
+    void writeFrame(const cv::Mat& bgr);
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_itemQueued;
+    std::condition_variable m_itemTaken;
+    std::deque<Item> m_queue; // Guarded by m_mutex
+    bool m_running = false;
+    bool m_stopping = false;
+    EventRecorderSettings m_settings;
+    double m_fps = 30.0;
+    std::thread m_thread;
+    qint64 m_nextFrame = -1; // Producer only: the frame index that continues the stream
+
+    // Recorder thread only
+    std::deque<CompressedFrame> m_preRoll;
+    size_t m_preRollBytes = 0;
+    size_t m_preRollFrames = 0; // Capacity in frames
+    int m_motionFrames = 0;     // Consecutive frames above the trigger ratio
+    qint64 m_quietFrames = 0;   // Frames without motion since the clip's last motion
+    qint64 m_postRollFrames = 0;
+    cv::VideoWriter m_writer;
+    QString m_clipPath;
+    cv::Size m_clipSize;
+    qint64 m_clipFirstFrame = -1;
+    qint64 m_clipLastFrame = -1;
+    cv::Mat m_colorScratch;
+    cv::Mat m_bgr;
+    cv::Mat m_resized;
+
+    std::atomic<quint64> m_clipsWritten{0};
+    std::atomic<quint64> m_framesDropped{0};
+};
+
+#endif // EVENTRECORDER_H
@@ -0,0 +1,74 @@
+#include "FrameLayout.h"
+
+namespace {
+
+constexpr int fourcc(char a, char b, char c, char d)
+{
+    return (a & 0xFF) | ((b & 0xFF) << 8) | ((c & 0xFF) << 16) | ((d & 0xFF) << 24);
+}
+
+} // namespace
+
+bool detectFrameLayout(const cv::Mat& frame, int height, int codecPixelFormat, FrameLayout& layout)
+{
+    if (frame.empty() || frame.depth() != CV_8U) return false;
+
+    if (frame.channels() == 3) {
+        layout = FrameLayout::Bgr;
+        return true;
+    }
+    if (frame.channels() == 2 && frame.rows == height) {
+        layout = FrameLayout::Yuy2;
+        return true;
+    }
+    if (frame.channels() != 1) return false;
+
+    if (frame.rows == height) {
+        layout = FrameLayout::Gray;
+        return true;
+    }
+    if (frame.rows != height * 3 / 2) return false;
+
+    if (codecPixelFormat == fourcc('Y', 'V', '1', '2')) layout = FrameLayout::Yv12;
+    else if (codecPixelFormat == fourcc('N', 'V', '1', '2')) layout = FrameLayout::Nv12;
+    else if (codecPixelFormat == fourcc('N', 'V', '2', '1')) layout = FrameLayout::Nv21;
+    else layout = FrameLayout::I420; // Also the usual layout when the backend does not say
+    return true;
+}
+
+cv::Mat lumaView(const cv::Mat& frame, FrameLayout layout, int height)
+{
+    switch (layout) {
+    case FrameLayout::I420:
+    case FrameLayout::Yv12:
+    case FrameLayout::Nv12:
+    case FrameLayout::Nv21:
+        return frame.rowRange(0, height);
+    case FrameLayout::Yuy2: {
+        cv::Mat luma;
+        cv::extractChannel(frame, luma, 0);
+        return luma;
+    }
+    case FrameLayout::Bgr:
+    case FrameLayout::Gray:
+        break;
+    }
+    return frame;
+}
+
+const cv::Mat& displayImage(const cv::Mat& frame, FrameLayout layout, cv::Mat& out)
+{
+    int code = -1;
+    switch (layout) {
+    case FrameLayout::I420: code = cv::COLOR_YUV2BGRA_I420; break;
+    case FrameLayout::Yv12: code = cv::COLOR_YUV2BGRA_YV12; break;
+    case FrameLayout::Nv12: code = cv::COLOR_YUV2BGRA_NV12; break;
+    case FrameLayout::Nv21: code = cv::COLOR_YUV2BGRA_NV21; break;
+    case FrameLayout::Yuy2: code = cv::COLOR_YUV2BGRA_YUY2; break;
+    case FrameLayout::Bgr:
+    case FrameLayout::Gray:
+        return frame;
+    }
+    cv::cvtColor(frame, out, code);
+    return out;
+}
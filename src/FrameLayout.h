@@ -0,0 +1,37 @@
+#ifndef FRAMELAYOUT_H
+#define FRAMELAYOUT_H
+
+#include <opencv2/opencv.hpp>
+
+// Pixel layout of the frames the decoder stage hands on. BGR is what VideoCapture
+// produces by default; the others come from reading with CAP_PROP_CONVERT_RGB off,
+// where backends return either gray (FFmpeg) or their native YUV buffer (e.g. V4L2,
+// GStreamer).
+enum class FrameLayout
+{
+    Bgr,  // CV_8UC3
+    Gray, // CV_8UC1, height rows
+    I420, // CV_8UC1, Y plane then U and V planes (height * 3 / 2 rows)
+    Yv12, // As I420 with V before U
+    Nv12, // CV_8UC1, Y plane then interleaved UV (height * 3 / 2 rows)
+    Nv21, // As NV12 with VU order
+    Yuy2  // CV_8UC2, packed Y0 U Y1 V
+};
+
+// Works out the layout of a frame read from a video of the given height.
+// codecPixelFormat is CAP_PROP_CODEC_PIXEL_FORMAT (a FourCC, or 0 if unknown); it tells
+// apart the 4:2:0 variants, which are otherwise identical in shape. Returns false for
+// layouts nothing downstream can handle.
+bool detectFrameLayout(const cv::Mat& frame, int height, int codecPixelFormat, FrameLayout& layout);
+
+// Gray image for motion analysis. For the planar/semi-planar YUV layouts this is a
+// zero-copy view of the Y plane; YUY2 needs a copy; BGR is returned unchanged and is
+// converted by the motion kernel.
+cv::Mat lumaView(const cv::Mat& frame, FrameLayout layout, int height);
+
+// Converts frame to BGRA (or GRAY for Gray) into out. Only called for frames that are
+// actually displayed, so skipped and headless frames never pay for colour conversion.
+// Returns frame itself for Bgr and Gray.
+const cv::Mat& displayImage(const cv::Mat& frame, FrameLayout layout, cv::Mat& out);
+
+#endif // FRAMELAYOUT_H
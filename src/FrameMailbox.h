@@ -0,0 +1,58 @@
+#ifndef FRAMEMAILBOX_H
+#define FRAMEMAILBOX_H
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free "latest wins" handoff between one producer thread and one consumer
+// thread (triple buffering). The producer fills back() and publish()es it; the
+// consumer take()s the newest published value. Values the consumer never saw are
+// overwritten and counted as dropped, so at most one value is ever waiting.
+template <typename T>
+class FrameMailbox
+{
+public:
+    FrameMailbox() = default;
+    FrameMailbox(const FrameMailbox&) = delete;
+    FrameMailbox& operator=(const FrameMailbox&) = delete;
+
+    // Producer: slot to fill before publish(). Never visible to the consumer until then.
+    T& back() { return m_slots[m_back]; }
+
+    // Producer: makes back() the latest value. Returns false if it replaced a value
+    // the consumer had not taken yet.
+    bool publish()
+    {
+        const int previous = m_ready.exchange(m_back | kFresh, std::memory_order_acq_rel);
+        m_back = previous & kIndexMask;
+        if (previous & kFresh) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // Consumer: the newest value published since the last take(), or nullptr. The
+    // pointer stays valid (and untouched by the producer) until the next take().
+    const T* take()
+    {
+        if (!(m_ready.load(std::memory_order_acquire) & kFresh)) return nullptr;
+        const int previous = m_ready.exchange(m_front, std::memory_order_acq_rel);
+        m_front = previous & kIndexMask;
+        return &m_slots[m_front];
+    }
+
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int kIndexMask = 0x3;
+    static constexpr int kFresh = 0x4;
+
+    T m_slots[3];
+    int m_back = 0;                  // Producer only
+    int m_front = 2;                 // Consumer only
+    std::atomic<int> m_ready{1};     // Index of the middle slot, plus kFresh if unread
+    std::atomic<uint64_t> m_dropped{0};
+};
+
+#endif // FRAMEMAILBOX_H
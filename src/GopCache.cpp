@@ -0,0 +1,69 @@
+#include "GopCache.h"
+
+GopCache::GopCache(size_t byteBudget)
+    : m_byteBudget(byteBudget)
+{
+}
+
+void GopCache::insert(qint64 gopStart, qint64 frameIndex, const cv::Mat& frame)
+{
+    if (frame.empty()) return;
+    const size_t frameBytes = frame.total() * frame.elemSize();
+    if (frameBytes > m_byteBudget) return;
+
+    auto found = m_gops.find(gopStart);
+    std::list<Gop>::iterator gop;
+    if (found == m_gops.end()) {
+        m_lru.push_front(Gop());
+        gop = m_lru.begin();
+        gop->start = gopStart;
+        m_gops.emplace(gopStart, gop);
+    } else {
+        gop = found->second;
+        touch(gop);
+    }
+
+    if (gop->frames.count(frameIndex)) return; // Already cached
+
+    // Make room by evicting other GOPs, least recently used first. If this GOP alone
+    // fills the budget, its remaining frames are simply not cached.
+    while (m_bytes + frameBytes > m_byteBudget && m_lru.back().start != gopStart) {
+        evictLeastRecentlyUsed();
+    }
+    if (m_bytes + frameBytes > m_byteBudget) return;
+
+    gop->frames.emplace(frameIndex, frame);
+    gop->bytes += frameBytes;
+    m_bytes += frameBytes;
+}
+
+bool GopCache::lookup(qint64 gopStart, qint64 frameIndex, cv::Mat& frame)
+{
+    auto found = m_gops.find(gopStart);
+    if (found == m_gops.end()) return false;
+    auto cached = found->second->frames.find(frameIndex);
+    if (cached == found->second->frames.end()) return false;
+    touch(found->second);
+    frame = cached->second;
+    return true;
+}
+
+void GopCache::clear()
+{
+    m_lru.clear();
+    m_gops.clear();
+    m_bytes = 0;
+}
+
+void GopCache::touch(std::list<Gop>::iterator gop)
+{
+    m_lru.splice(m_lru.begin(), m_lru, gop);
+}
+
+void GopCache::evictLeastRecentlyUsed()
+{
+    Gop& oldest = m_lru.back();
+    m_bytes -= oldest.bytes;
+    m_gops.erase(oldest.start);
+    m_lru.pop_back();
+}
@@ -0,0 +1,43 @@
+#ifndef GOPCACHE_H
+#define GOPCACHE_H
+
+#include <QtGlobal>
+#include <opencv2/opencv.hpp>
+#include <list>
+#include <map>
+#include <unordered_map>
+
+// LRU cache of decoded frames grouped by GOP (keyed by the GOP's keyframe). Whole GOPs
+// are evicted, least recently used first, once the byte budget is exceeded. Frames
+// are shared by reference, so inserting a decoded frame does not copy it.
+// Not thread-safe: owned by the decoder stage.
+class GopCache
+{
+public:
+    explicit GopCache(size_t byteBudget);
+
+    void insert(qint64 gopStart, qint64 frameIndex, const cv::Mat& frame);
+    // On a hit, frame is set and the GOP becomes most recently used.
+    bool lookup(qint64 gopStart, qint64 frameIndex, cv::Mat& frame);
+    void clear();
+
+    size_t bytes() const { return m_bytes; }
+
+private:
+    struct Gop
+    {
+        qint64 start = 0;
+        std::map<qint64, cv::Mat> frames;
+        size_t bytes = 0;
+    };
+
+    void touch(std::list<Gop>::iterator gop);
+    void evictLeastRecentlyUsed();
+
+    size_t m_byteBudget;
+    size_t m_bytes = 0;
+    std::list<Gop> m_lru; // Front is most recently used
+    std::unordered_map<qint64, std::list<Gop>::iterator> m_gops;
+};
+
+#endif // GOPCACHE_H
@@ -0,0 +1,46 @@
+#include "GrayFrameRing.h"
+#include "MotionKernel.h"
+
+GrayFrameRing::GrayFrameRing(int capacity)
+    : m_slots(static_cast<size_t>(capacity > 0 ? capacity : 1))
+{
+}
+
+void GrayFrameRing::reset()
+{
+    m_head = -1;
+    m_count = 0;
+}
+
+cv::Mat& GrayFrameRing::nextSlot(const cv::Size& frameSize)
+{
+    if (frameSize != m_frameSize) {
+        // Older slots hold frames of the previous size and can no longer be compared.
+        m_frameSize = frameSize;
+        reset();
+    }
+    cv::Mat& slot = m_slots[static_cast<size_t>((m_head + 1) % capacity())];
+    slot.create(frameSize, CV_8UC1); // No-op once the slot has been allocated at this size
+    return slot;
+}
+
+void GrayFrameRing::commit()
+{
+    m_head = (m_head + 1) % capacity();
+    if (m_count < capacity()) ++m_count;
+}
+
+void GrayFrameRing::push(const cv::Mat& frame)
+{
+    cv::Mat& slot = nextSlot(frame.size());
+    if (convertToGray(frame, slot)) {
+        commit();
+    }
+}
+
+const cv::Mat& GrayFrameRing::ago(int framesBack) const
+{
+    CV_Assert(framesBack >= 0 && framesBack < m_count);
+    const int index = (m_head - framesBack + capacity()) % capacity();
+    return m_slots[static_cast<size_t>(index)];
+}
@@ -0,0 +1,39 @@
+#ifndef GRAYFRAMERING_H
+#define GRAYFRAMERING_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Fixed-capacity history of grayscale frames. Slots are allocated once per frame
+// size and then reused, so steady-state pushes never touch the heap. Each frame is
+// converted to gray exactly once, when it enters the ring.
+class GrayFrameRing
+{
+public:
+    explicit GrayFrameRing(int capacity);
+
+    // Forget all history. Slot buffers are kept for reuse.
+    void reset();
+
+    // Converts frame (CV_8UC3 BGR or CV_8UC1) into the next slot and makes it the latest.
+    void push(const cv::Mat& frame);
+
+    // Slot that the next commit() will publish, sized for frameSize. Lets callers write
+    // gray data in place (e.g. from a fused kernel) instead of going through push().
+    cv::Mat& nextSlot(const cv::Size& frameSize);
+    void commit();
+
+    // framesBack = 0 is the most recent frame; requires framesBack < size().
+    const cv::Mat& ago(int framesBack) const;
+
+    int size() const { return m_count; }
+    int capacity() const { return static_cast<int>(m_slots.size()); }
+
+private:
+    std::vector<cv::Mat> m_slots;
+    cv::Size m_frameSize;
+    int m_head = -1;  // Index of the latest frame
+    int m_count = 0;
+};
+
+#endif // GRAYFRAMERING_H
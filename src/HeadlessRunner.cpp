@@ -0,0 +1,252 @@
+#include "HeadlessRunner.h"
+#include "VideoProcessor.h"
+#include "Profiler.h"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QTextStream>
+
+HeadlessRunner::HeadlessRunner(const HeadlessOptions& options, QObject *parent)
+    : QObject(parent),
+      m_options(options),
+      m_videoProcessor(std::make_unique<VideoProcessor>())
+{
+    // Frames are consumed directly on the processing thread so nothing queues up in
+    // the event loop; the remaining signals are delivered to this thread as usual.
+    connect(m_videoProcessor.get(), &VideoProcessor::motionStatsReady, this, &HeadlessRunner::handleMotionStats, Qt::DirectConnection);
+    connect(m_videoProcessor.get(), &VideoProcessor::frameAnalyzed, this, &HeadlessRunner::handleFrameAnalyzed, Qt::DirectConnection);
+    connect(m_videoProcessor.get(), &VideoProcessor::multiDeltaMasksReady, this, &HeadlessRunner::handleMultiDeltaMasks,
+            Qt::DirectConnection);
+    connect(m_videoProcessor.get(), &VideoProcessor::processingFinished, this, &HeadlessRunner::handleProcessingFinished);
+    connect(m_videoProcessor.get(), &VideoProcessor::errorOccurred, this, &HeadlessRunner::handleError);
+}
+
+HeadlessRunner::~HeadlessRunner()
+{
+    // Stop the workers before the writers they feed go away.
+    if (m_segmentedThread) {
+        m_cancelSegmented = true;
+        m_segmentedThread->wait();
+    }
+    m_videoProcessor.reset();
+}
+
+bool HeadlessRunner::start()
+{
+    if (!m_writer.open(m_options.outputPath, m_options.format)) {
+        qCritical() << "Failed to open output file:" << m_options.outputPath;
+        return false;
+    }
+    // The first delta of a set uses the main output; the others get one file each.
+    m_deltaOutputs.clear();
+    for (size_t i = 1; i < m_options.deltaSet.size(); ++i) {
+        auto output = std::make_unique<DeltaOutput>();
+        output->delta = m_options.deltaSet[i];
+        const QString path = deltaOutputPath(m_options.outputPath, output->delta);
+        if (!output->writer.open(path, m_options.format)) {
+            qCritical() << "Failed to open output file:" << path;
+            return false;
+        }
+        m_deltaOutputs.push_back(std::move(output));
+    }
+
+    if (m_options.segmentWorkers >= 0 && canRunSegmented()) return startSegmented();
+
+    m_videoProcessor->setRealtimePlayback(false);
+    // Nothing is displayed, so the colour planes are only needed for an overlay video or
+    // event clips.
+    m_videoProcessor->setLumaOnlyDecode(m_options.overlayVideoPath.isEmpty() && m_options.events.outputDir.isEmpty());
+    m_videoProcessor->setFrameDelta(m_options.frameDelta);
+    m_videoProcessor->setFrameDeltaSet(m_options.deltaSet);
+    m_videoProcessor->setMotionThreshold(m_options.motionThreshold);
+    m_videoProcessor->setMotionAlgorithm(m_options.algorithm);
+    m_videoProcessor->setAnalysisThreads(m_options.analysisThreads);
+    m_videoProcessor->setAnalysisScale(m_options.analysisScale);
+    m_videoProcessor->setMinBlobArea(m_options.minBlobArea);
+    m_videoProcessor->setMotionStatsEnabled(true);
+
+    // loadVideo() opens in the background; there is nothing else to do meanwhile.
+    m_videoProcessor->loadVideo(m_options.inputPath);
+    if (!m_videoProcessor->waitForOpen()) {
+        qCritical() << "Failed to open video file:" << m_options.inputPath;
+        return false;
+    }
+    m_videoFps = m_videoProcessor->videoFps();
+
+    // Without playback pacing the exporters' bounded queues are what keeps analysis from
+    // running ahead of the encoders, so submit() waits rather than dropping frames.
+    if (!m_options.maskVideoPath.isEmpty()) m_maskExporter.open(m_options.maskVideoPath, m_videoFps, true);
+    if (!m_options.overlayVideoPath.isEmpty()) m_overlayExporter.open(m_options.overlayVideoPath, m_videoFps, true);
+    if (!m_options.maskArchivePath.isEmpty() && !m_maskArchive.open(m_options.maskArchivePath)) {
+        qCritical() << "Failed to open mask archive:" << m_options.maskArchivePath;
+        return false;
+    }
+    if (!m_options.events.outputDir.isEmpty()) {
+        EventRecorderSettings events = m_options.events;
+        events.baseName = QFileInfo(m_options.inputPath).completeBaseName();
+        events.waitWhenBehind = true; // No clock to keep, and every event should get its clip
+        if (!m_eventRecorder.start(events, m_videoFps)) return false;
+    }
+
+    Profiler::setEnabled(m_options.profile);
+    if (!m_options.tracePath.isEmpty()) Profiler::startTrace(m_options.tracePath);
+
+    m_framesProcessed = 0;
+    m_timer.start();
+    m_videoProcessor->startProcessing();
+    return !m_failed;
+}
+
+bool HeadlessRunner::canRunSegmented() const
+{
+    const char* reason = nullptr;
+    if (!SegmentedAnalyzer::supportsAlgorithm(m_options.algorithm)) {
+        reason = "the algorithm keeps unbounded history";
+    } else if (!m_options.deltaSet.empty()) {
+        reason = "a delta set is analysed in a single pass";
+    } else if (!m_options.overlayVideoPath.isEmpty()) {
+        reason = "an overlay video needs the colour frames in order";
+    } else if (!m_options.events.outputDir.isEmpty()) {
+        reason = "event clips need the colour frames in order";
+    }
+    if (!reason) return true;
+    qWarning() << "Segmented analysis is not possible because" << reason << "; analysing sequentially.";
+    return false;
+}
+
+bool HeadlessRunner::startSegmented()
+{
+    SegmentedAnalysisOptions options;
+    options.frameDelta = m_options.frameDelta;
+    options.motionThreshold = m_options.motionThreshold;
+    options.algorithm = m_options.algorithm;
+    options.analysisScale = m_options.analysisScale;
+    options.minBlobArea = m_options.minBlobArea;
+    options.workers = m_options.segmentWorkers;
+    options.keepMasks = !m_options.maskVideoPath.isEmpty() || !m_options.maskArchivePath.isEmpty();
+
+    m_segmentedAnalyzer = std::make_unique<SegmentedAnalyzer>(options);
+    if (!m_segmentedAnalyzer->open(m_options.inputPath)) {
+        qCritical() << "Failed to open video file:" << m_options.inputPath;
+        return false;
+    }
+    m_videoFps = m_segmentedAnalyzer->fps();
+    if (!m_options.maskVideoPath.isEmpty()) m_maskExporter.open(m_options.maskVideoPath, m_videoFps, true);
+    if (!m_options.maskArchivePath.isEmpty() && !m_maskArchive.open(m_options.maskArchivePath)) {
+        qCritical() << "Failed to open mask archive:" << m_options.maskArchivePath;
+        return false;
+    }
+
+    Profiler::setEnabled(m_options.profile);
+    if (!m_options.tracePath.isEmpty()) Profiler::startTrace(m_options.tracePath);
+
+    m_framesProcessed = 0;
+    m_timer.start();
+    m_cancelSegmented = false;
+    // The run (and the in-order merge into the writers) blocks, so it gets its own thread.
+    m_segmentedThread.reset(QThread::create([this] {
+        Profiler::setThreadName("merge");
+        const bool ok = m_segmentedAnalyzer->run([this](const SegmentedFrame& frame) { handleSegmentedFrame(frame); },
+                                                 m_cancelSegmented);
+        QMetaObject::invokeMethod(this, [this, ok] { handleSegmentedFinished(ok); }, Qt::QueuedConnection);
+    }));
+    m_segmentedThread->start();
+    return true;
+}
+
+void HeadlessRunner::handleSegmentedFrame(const SegmentedFrame& frame)
+{
+    m_writer.write(frame.stats);
+    ++m_framesProcessed;
+    if (m_maskArchive.isOpen()) m_maskArchive.appendEncoded(frame.stats.frameIndex, frame.maskSize, frame.maskBlocks);
+    if (m_maskExporter.isOpen()) {
+        // Decoded into a new buffer per frame: the exporter keeps a reference.
+        m_segmentedMask = cv::Mat();
+        if (!frame.maskSize.empty()) {
+            decodeMaskBlocks(reinterpret_cast<const uchar*>(frame.maskBlocks.data()), frame.maskBlocks.size(),
+                             frame.maskSize, m_segmentedMask);
+        }
+        m_maskExporter.submit(cv::Mat(), FrameLayout::Gray, m_segmentedMask);
+    }
+}
+
+void HeadlessRunner::handleSegmentedFinished(bool ok)
+{
+    m_segmentedThread->wait();
+    if (!ok) {
+        qCritical() << "Segmented analysis of" << m_options.inputPath << "failed.";
+        m_failed = true;
+    }
+    handleProcessingFinished();
+}
+
+void HeadlessRunner::handleMotionStats(const MotionStats& stats)
+{
+    m_writer.write(stats);
+    ++m_framesProcessed;
+}
+
+void HeadlessRunner::handleFrameAnalyzed(qint64 frameIndex, const cv::Mat& frame, FrameLayout layout, const cv::Mat& mask)
+{
+    m_maskExporter.submit(frame, layout, mask);
+    m_overlayExporter.submit(frame, layout, mask);
+    m_eventRecorder.submit(frameIndex, frame, layout, mask);
+    m_maskArchive.append(frameIndex, mask);
+}
+
+void HeadlessRunner::handleMultiDeltaMasks(qint64 frameIndex, const std::vector<int>&,
+                                           const std::vector<cv::Mat>& masks)
+{
+    // masks follows the delta set, so masks[i + 1] belongs to m_deltaOutputs[i].
+    for (size_t i = 0; i < m_deltaOutputs.size() && i + 1 < masks.size(); ++i) {
+        DeltaOutput& output = *m_deltaOutputs[i];
+        output.stats.frameIndex = frameIndex;
+        output.extractor.extract(masks[i + 1], m_options.minBlobArea, m_options.analysisScale, output.stats);
+        output.writer.write(output.stats);
+    }
+}
+
+QString HeadlessRunner::deltaOutputPath(const QString& outputPath, int delta)
+{
+    const QFileInfo info(outputPath);
+    const QString name = QString("%1.d%2").arg(info.completeBaseName()).arg(delta);
+    return info.dir().filePath(info.suffix().isEmpty() ? name : name + "." + info.suffix());
+}
+
+void HeadlessRunner::handleProcessingFinished()
+{
+    if (!m_writer.close()) {
+        qCritical() << "Failed to write motion stats:" << m_options.outputPath;
+        m_failed = true;
+    }
+    for (const auto& output : m_deltaOutputs) {
+        if (!output->writer.close()) {
+            qCritical() << "Failed to write motion stats:" << output->writer.path();
+            m_failed = true;
+        }
+    }
+    m_maskExporter.close();
+    m_overlayExporter.close();
+    m_eventRecorder.stop();
+    if (!m_maskArchive.close()) {
+        qCritical() << "Failed to write mask archive:" << m_options.maskArchivePath;
+        m_failed = true;
+    }
+    if (m_maskExporter.hasFailed() || m_overlayExporter.hasFailed()) m_failed = true;
+
+    const double seconds = m_timer.elapsed() / 1000.0;
+    const double fps = seconds > 0.0 ? m_framesProcessed / seconds : 0.0;
+    QTextStream(stdout) << "Processed " << m_framesProcessed << " frames in "
+                        << QString::number(seconds, 'f', 2) << " s ("
+                        << QString::number(fps, 'f', 1) << " frames/sec)\n";
+    if (m_options.profile) QTextStream(stdout) << "Stage latency:\n" << Profiler::summaryText();
+    Profiler::stopTrace();
+    emit finished(m_failed ? 1 : 0);
+}
+
+void HeadlessRunner::handleError(const QString& message)
+{
+    qCritical() << message;
+    m_failed = true;
+    emit finished(1);
+}
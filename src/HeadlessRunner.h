@@ -0,0 +1,105 @@
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <QObject>
+#include <QString>
+#include <QElapsedTimer>
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "MotionDetector.h"
+#include "MotionStatsWriter.h"
+#include "VideoExporter.h"
+#include "MaskArchive.h"
+#include "EventRecorder.h"
+#include "SegmentedAnalyzer.h"
+
+class VideoProcessor;
+
+struct HeadlessOptions
+{
+    QString inputPath;
+    QString outputPath;
+    int frameDelta = 3;
+    std::vector<int> deltaSet; // Non-empty: analyse all these deltas in one pass
+    int segmentWorkers = -1;   // >= 0: split the file into segments on this many workers (0 = one per core)
+    int motionThreshold = 30;
+    MotionAlgorithm algorithm = MotionAlgorithm::FrameDifference;
+    int analysisThreads = 0; // 0 = one per core
+    int analysisScale = 1;   // Downscale divisor for motion analysis
+    int minBlobArea = 16;    // Pixels at analysis resolution
+    MotionStatsWriter::Format format = MotionStatsWriter::Format::Csv;
+    QString maskVideoPath;    // Empty: no mask video
+    QString overlayVideoPath; // Empty: no overlay video
+    QString maskArchivePath;  // Empty: no mask archive
+    EventRecorderSettings events; // Empty outputDir: no event clips
+    bool profile = false;    // Print per-stage latencies when done
+    QString tracePath;       // Chrome trace output, empty for none
+};
+
+// Drives a VideoProcessor without a GUI: no playback pacing, one CSV/JSONL row of motion
+// stats per frame, and a throughput summary when the file has been processed. With
+// segment workers the file is analysed by a SegmentedAnalyzer instead, on all cores;
+// the output is the same.
+class HeadlessRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HeadlessRunner(const HeadlessOptions& options, QObject *parent = nullptr);
+    ~HeadlessRunner() override;
+
+    // Returns false if the input or output could not be opened.
+    bool start();
+
+signals:
+    void finished(int exitCode);
+
+private slots:
+    void handleMotionStats(const MotionStats& stats);
+    void handleFrameAnalyzed(qint64 frameIndex, const cv::Mat& frame, FrameLayout layout, const cv::Mat& mask);
+    void handleMultiDeltaMasks(qint64 frameIndex, const std::vector<int>& deltas, const std::vector<cv::Mat>& masks);
+    void handleProcessingFinished();
+    void handleSegmentedFinished(bool ok);
+    void handleError(const QString& message);
+
+private:
+    // Stats of one additional delta of the delta set (the first one goes to m_writer).
+    struct DeltaOutput
+    {
+        int delta = 0;
+        BlobExtractor extractor;
+        MotionStats stats;
+        MotionStatsWriter writer;
+    };
+
+    // Whether the options allow the segmented path; logs why not otherwise.
+    bool canRunSegmented() const;
+    bool startSegmented();
+    void handleSegmentedFrame(const SegmentedFrame& frame);
+
+    // <dir>/<name>.<ext> -> <dir>/<name>.d<delta>.<ext>
+    static QString deltaOutputPath(const QString& outputPath, int delta);
+
+    HeadlessOptions m_options;
+    std::unique_ptr<VideoProcessor> m_videoProcessor;
+
+    MotionStatsWriter m_writer;
+    std::vector<std::unique_ptr<DeltaOutput>> m_deltaOutputs; // Processing thread while running
+    VideoExporter m_maskExporter{VideoExporter::Content::Mask};
+    VideoExporter m_overlayExporter{VideoExporter::Content::Overlay};
+    MaskArchiveWriter m_maskArchive;
+    EventRecorder m_eventRecorder;
+    std::unique_ptr<SegmentedAnalyzer> m_segmentedAnalyzer;
+    std::unique_ptr<QThread> m_segmentedThread;
+    std::atomic<bool> m_cancelSegmented{false};
+    cv::Mat m_segmentedMask; // Segmented merge thread only: decoded mask for the mask video
+    double m_videoFps = 0.0;
+    QElapsedTimer m_timer;
+    qint64 m_framesProcessed = 0; // Written from the processing thread only
+    bool m_failed = false;
+};
+
+#endif // HEADLESSRUNNER_H
@@ -0,0 +1,49 @@
+#include "KeyframeIndex.h"
+#include <opencv2/opencv.hpp>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+KeyframeIndex KeyframeIndex::build(const std::string& filePath, const std::atomic<bool>& cancel)
+{
+    KeyframeIndex index;
+
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 7)
+    // Raw mode (CAP_PROP_FORMAT = -1): grab() returns packets, nothing is decoded.
+    cv::VideoCapture rawCapture(filePath, cv::CAP_FFMPEG, {cv::CAP_PROP_FORMAT, -1});
+    if (rawCapture.isOpened()) {
+        qint64 frame = 0;
+        while (!cancel.load() && rawCapture.grab()) {
+            if (rawCapture.get(cv::CAP_PROP_LRF_HAS_KEY_FRAME) != 0.0) {
+                index.m_keyframes.push_back(frame);
+            }
+            ++frame;
+        }
+        if (!index.m_keyframes.empty()) {
+            index.m_exact = !cancel.load();
+            return index;
+        }
+    }
+#endif
+
+    // Approximate: one seek point per second of video.
+    cv::VideoCapture capture(filePath);
+    if (!capture.isOpened()) {
+        qWarning() << "KeyframeIndex: Failed to open" << QString::fromStdString(filePath);
+        return index;
+    }
+    const double fps = capture.get(cv::CAP_PROP_FPS);
+    const qint64 frameCount = static_cast<qint64>(capture.get(cv::CAP_PROP_FRAME_COUNT));
+    const qint64 step = std::max<qint64>(1, static_cast<qint64>(std::lround(fps > 0 ? fps : 30.0)));
+    for (qint64 frame = 0; frame < std::max<qint64>(frameCount, 1); frame += step) {
+        index.m_keyframes.push_back(frame);
+    }
+    return index;
+}
+
+qint64 KeyframeIndex::keyframeAtOrBefore(qint64 frameIndex) const
+{
+    auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), frameIndex);
+    if (it == m_keyframes.begin()) return 0;
+    return *(it - 1);
+}
@@ -0,0 +1,33 @@
+#ifndef KEYFRAMEINDEX_H
+#define KEYFRAMEINDEX_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Sorted list of keyframe (GOP start) frame numbers for one video file.
+//
+// With OpenCV 4.7+ the FFmpeg backend is read in raw packet mode, which reports the
+// key-frame flag without decoding anything, so a scan is I/O bound. Older OpenCV
+// versions (or other backends) get an approximate index with one entry per second
+// of video; it is still usable for grouping frames, just not exact.
+class KeyframeIndex
+{
+public:
+    // Blocking scan; returns early (with whatever was found) once cancel is set.
+    static KeyframeIndex build(const std::string& filePath, const std::atomic<bool>& cancel);
+
+    // Largest keyframe <= frameIndex (0 if the index is empty).
+    qint64 keyframeAtOrBefore(qint64 frameIndex) const;
+
+    bool isEmpty() const { return m_keyframes.empty(); }
+    size_t keyframeCount() const { return m_keyframes.size(); }
+    bool isExact() const { return m_exact; }
+
+private:
+    std::vector<qint64> m_keyframes;
+    bool m_exact = false;
+};
+
+#endif // KEYFRAMEINDEX_H
@@ -1,26 +1,41 @@
 #include "MainWindow.h"
 #include "VideoProcessor.h"
 #include "VideoDisplayWidget.h"
+#include "ActivityStripWidget.h"
+#include "MosaicWindow.h"
+#include "MotionKernel.h"
+#include "Profiler.h"
 
 #include <QApplication>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QMenuBar>
 #include <QToolBar>
 #include <QStatusBar>
 #include <QPushButton>
 #include <QSlider>
 #include <QSpinBox>
+#include <QComboBox>
+#include <QCheckBox>
+#include <QLineEdit>
 #include <QLabel>
 #include <QHBoxLayout>
 #include <QVBoxLayout>
 #include <QMessageBox>
 #include <QStyle>
+#include <QThread>
+#include <QTimer>
+#include <QScreen>
+#include <QSignalBlocker>
+#include <QStringList>
 #include <QDebug>
+#include <algorithm>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
       m_videoProcessor(std::make_unique<VideoProcessor>())
 {
+    Profiler::setThreadName("gui");
     setupUI();
     createActions();
     createMenus();
@@ -37,6 +52,7 @@ MainWindow::MainWindow(QWidget *parent)
 MainWindow::~MainWindow()
 {
     // VideoProcessor unique_ptr handles deletion and thread cleanup via its destructor
+    Profiler::stopTrace();
     qInfo() << "MainWindow destructor called";
 }
 
@@ -47,10 +63,36 @@ void MainWindow::setupUI()
 
     m_originalDisplayWidget = new VideoDisplayWidget(m_centralWidget);
     m_maskDisplayWidget = new VideoDisplayWidget(m_centralWidget);
+    m_heatmapDisplayWidget = new VideoDisplayWidget(m_centralWidget);
+    m_heatmapDisplayWidget->setVisible(false);
 
     QHBoxLayout* displayLayout = new QHBoxLayout();
     displayLayout->addWidget(m_originalDisplayWidget, 1);
     displayLayout->addWidget(m_maskDisplayWidget, 1);
+    displayLayout->addWidget(m_heatmapDisplayWidget, 1);
+
+    // Timeline
+    m_timelineSlider = new QSlider(Qt::Horizontal, m_centralWidget);
+    m_timelineSlider->setRange(0, 0);
+    m_timeLabel = new QLabel(m_centralWidget);
+    m_timeLabel->setMinimumWidth(120);
+    QHBoxLayout* timelineLayout = new QHBoxLayout();
+    timelineLayout->addWidget(m_timelineSlider, 1);
+    timelineLayout->addWidget(m_timeLabel);
+
+    // Activity strip, aligned with the slider
+    m_activityStrip = new ActivityStripWidget(m_centralWidget);
+    QHBoxLayout* activityLayout = new QHBoxLayout();
+    activityLayout->addWidget(m_activityStrip, 1);
+    activityLayout->addSpacing(m_timeLabel->minimumWidth() + timelineLayout->spacing());
+    m_activityRestartTimer = new QTimer(this);
+    m_activityRestartTimer->setSingleShot(true);
+    m_activityRestartTimer->setInterval(1000);
+
+    QVBoxLayout* displayColumnLayout = new QVBoxLayout();
+    displayColumnLayout->addLayout(displayLayout, 1);
+    displayColumnLayout->addLayout(activityLayout);
+    displayColumnLayout->addLayout(timelineLayout);
 
     m_openButton = new QPushButton("Open Video", m_centralWidget);
     m_playPauseButton = new QPushButton(m_centralWidget);
@@ -58,7 +100,7 @@ void MainWindow::setupUI()
     // Delta Control
     QLabel* deltaLabel = new QLabel("Frame Delta:", m_centralWidget);
     m_deltaSpinBox = new QSpinBox(m_centralWidget);
-    m_deltaSpinBox->setRange(1, 30);
+    m_deltaSpinBox->setRange(1, VideoProcessor::kMaxFrameDelta);
     m_deltaSpinBox->setValue(3);
     m_deltaSpinBox->setSuffix(" frames");
     QHBoxLayout* deltaLayout = new QHBoxLayout();
@@ -66,6 +108,21 @@ void MainWindow::setupUI()
     deltaLayout->addWidget(m_deltaSpinBox);
     deltaLayout->addStretch();
 
+    // Delta Set Control: several deltas analysed in one pass
+    QLabel* deltaSetLabel = new QLabel("Delta Set:", m_centralWidget);
+    m_deltaSetEdit = new QLineEdit(m_centralWidget);
+    m_deltaSetEdit->setPlaceholderText("e.g. 1,3,10,30");
+    m_deltaSetEdit->setToolTip(QString("Up to %1 frame deltas, analysed together. The first one drives "
+                                       "stats and exports; empty uses the single Frame Delta.")
+                                   .arg(kMaxFusedDeltas));
+    m_deltaGridCheckBox = new QCheckBox("Grid", m_centralWidget);
+    m_deltaGridCheckBox->setChecked(true);
+    m_deltaGridCheckBox->setToolTip("Show the masks of all deltas in the mask pane");
+    QHBoxLayout* deltaSetLayout = new QHBoxLayout();
+    deltaSetLayout->addWidget(deltaSetLabel);
+    deltaSetLayout->addWidget(m_deltaSetEdit);
+    deltaSetLayout->addWidget(m_deltaGridCheckBox);
+
     // Threshold Control
     QLabel* thresholdLabel = new QLabel("Motion Threshold:", m_centralWidget);
     m_thresholdSlider = new QSlider(Qt::Horizontal, m_centralWidget);
@@ -78,6 +135,66 @@ void MainWindow::setupUI()
     thresholdLayout->addWidget(m_thresholdSlider);
     thresholdLayout->addWidget(m_thresholdValueLabel);
 
+    // Algorithm Control
+    QLabel* algorithmLabel = new QLabel("Algorithm:", m_centralWidget);
+    m_algorithmComboBox = new QComboBox(m_centralWidget);
+    m_algorithmComboBox->addItem("Frame Difference", static_cast<int>(MotionAlgorithm::FrameDifference));
+    m_algorithmComboBox->addItem("Three-Frame Difference", static_cast<int>(MotionAlgorithm::ThreeFrameDifference));
+    m_algorithmComboBox->addItem("Running Average", static_cast<int>(MotionAlgorithm::RunningAverage));
+    m_algorithmComboBox->addItem("MOG2", static_cast<int>(MotionAlgorithm::Mog2));
+    m_algorithmComboBox->addItem("KNN", static_cast<int>(MotionAlgorithm::Knn));
+    QHBoxLayout* algorithmLayout = new QHBoxLayout();
+    algorithmLayout->addWidget(algorithmLabel);
+    algorithmLayout->addWidget(m_algorithmComboBox);
+    algorithmLayout->addStretch();
+
+    // Analysis Threads Control
+    QLabel* threadsLabel = new QLabel("Analysis Threads:", m_centralWidget);
+    m_threadsSpinBox = new QSpinBox(m_centralWidget);
+    m_threadsSpinBox->setRange(0, QThread::idealThreadCount());
+    m_threadsSpinBox->setValue(0);
+    m_threadsSpinBox->setSpecialValueText("Auto");
+    QHBoxLayout* threadsLayout = new QHBoxLayout();
+    threadsLayout->addWidget(threadsLabel);
+    threadsLayout->addWidget(m_threadsSpinBox);
+    threadsLayout->addStretch();
+
+    // Analysis Scale Control
+    QLabel* scaleLabel = new QLabel("Analysis Scale:", m_centralWidget);
+    m_scaleComboBox = new QComboBox(m_centralWidget);
+    m_scaleComboBox->addItem("Full", 1);
+    for (int divisor = 2; divisor <= VideoProcessor::kMaxAnalysisScale; divisor *= 2) {
+        m_scaleComboBox->addItem(QString("1/%1").arg(divisor), divisor);
+    }
+    QHBoxLayout* scaleLayout = new QHBoxLayout();
+    scaleLayout->addWidget(scaleLabel);
+    scaleLayout->addWidget(m_scaleComboBox);
+    scaleLayout->addStretch();
+
+    // Playback Speed Control
+    QLabel* speedLabel = new QLabel("Speed:", m_centralWidget);
+    m_speedComboBox = new QComboBox(m_centralWidget);
+    for (double speed : {0.25, 0.5, 1.0, 2.0, 4.0, 8.0, 16.0}) {
+        m_speedComboBox->addItem(QString("%1x").arg(speed), speed);
+    }
+    m_speedComboBox->setCurrentIndex(m_speedComboBox->findData(1.0));
+    QHBoxLayout* speedLayout = new QHBoxLayout();
+    speedLayout->addWidget(speedLabel);
+    speedLayout->addWidget(m_speedComboBox);
+    speedLayout->addStretch();
+
+    // Heatmap Control: where motion happened over the last N seconds, in a third pane
+    m_heatmapCheckBox = new QCheckBox("Heatmap", m_centralWidget);
+    m_heatmapCheckBox->setToolTip("Show where motion happened recently in a third pane");
+    m_heatmapWindowSpinBox = new QSpinBox(m_centralWidget);
+    m_heatmapWindowSpinBox->setRange(1, 600);
+    m_heatmapWindowSpinBox->setValue(10);
+    m_heatmapWindowSpinBox->setSuffix(" s");
+    m_heatmapWindowSpinBox->setToolTip("Seconds of video over which motion fades from the heatmap");
+    QHBoxLayout* heatmapLayout = new QHBoxLayout();
+    heatmapLayout->addWidget(m_heatmapCheckBox);
+    heatmapLayout->addWidget(m_heatmapWindowSpinBox);
+    heatmapLayout->addStretch();
 
     // Info Label
     m_videoInfoLabel = new QLabel("No video loaded.", m_centralWidget);
@@ -87,13 +204,19 @@ void MainWindow::setupUI()
     controlLayout->addWidget(m_openButton);
     controlLayout->addWidget(m_playPauseButton);
     controlLayout->addLayout(deltaLayout);
+    controlLayout->addLayout(deltaSetLayout);
     controlLayout->addLayout(thresholdLayout);
+    controlLayout->addLayout(algorithmLayout);
+    controlLayout->addLayout(threadsLayout);
+    controlLayout->addLayout(scaleLayout);
+    controlLayout->addLayout(speedLayout);
+    controlLayout->addLayout(heatmapLayout);
     controlLayout->addWidget(m_videoInfoLabel);
     controlLayout->addStretch();
 
 
     QHBoxLayout* mainBodyLayout = new QHBoxLayout();
-    mainBodyLayout->addLayout(displayLayout, 4);
+    mainBodyLayout->addLayout(displayColumnLayout, 4);
     mainBodyLayout->addLayout(controlLayout, 1);
 
 
@@ -115,6 +238,62 @@ void MainWindow::createActions()
     connect(m_playPauseAction, &QAction::triggered, this, &MainWindow::onPlayPause);
 
 
+    m_exportStatsAction = new QAction("&Export Motion Stats...", this);
+    m_exportStatsAction->setStatusTip("Stream per-frame motion statistics and blobs to a CSV or JSONL file");
+    connect(m_exportStatsAction, &QAction::triggered, this, &MainWindow::onExportMotionStats);
+
+    m_exportMaskVideoAction = new QAction("Export &Mask Video...", this);
+    m_exportMaskVideoAction->setStatusTip("Encode the motion mask of every analysed frame to a video file");
+    connect(m_exportMaskVideoAction, &QAction::triggered, this, [this]() { onExportVideo(&m_maskExporter); });
+
+    m_exportOverlayVideoAction = new QAction("Export &Overlay Video...", this);
+    m_exportOverlayVideoAction->setStatusTip("Encode every analysed frame with its moving pixels tinted red to a video file");
+    connect(m_exportOverlayVideoAction, &QAction::triggered, this, [this]() { onExportVideo(&m_overlayExporter); });
+
+    m_recordMaskArchiveAction = new QAction("Record Mask &Archive...", this);
+    m_recordMaskArchiveAction->setStatusTip("Store every analysed mask in a compact 1-bit .motmask archive");
+    connect(m_recordMaskArchiveAction, &QAction::triggered, this, &MainWindow::onRecordMaskArchive);
+
+    m_recordEventsAction = new QAction("Record Motion &Events...", this);
+    m_recordEventsAction->setStatusTip("Save a clip, with a few seconds before and after, whenever motion persists");
+    connect(m_recordEventsAction, &QAction::triggered, this, &MainWindow::onRecordMotionEvents);
+
+    m_openMaskArchiveAction = new QAction("Open Mask Arc&hive...", this);
+    m_openMaskArchiveAction->setStatusTip("Browse the masks of a .motmask archive with the timeline");
+    connect(m_openMaskArchiveAction, &QAction::triggered, this, &MainWindow::onOpenMaskArchive);
+
+    m_openMosaicAction = new QAction("Open Mo&saic...", this);
+    m_openMosaicAction->setStatusTip("Play many recordings side by side in a grid, each with its motion tinted");
+    connect(m_openMosaicAction, &QAction::triggered, this, &MainWindow::onOpenMosaic);
+
+    m_exportHeatmapAction = new QAction("Export &Heatmap Image...", this);
+    m_exportHeatmapAction->setStatusTip("Save the current motion heatmap as an image");
+    m_exportHeatmapAction->setEnabled(false);
+    connect(m_exportHeatmapAction, &QAction::triggered, this, &MainWindow::onExportHeatmap);
+
+    m_lumaDecodeAction = new QAction("&Luma-Only Decode", this);
+    m_lumaDecodeAction->setCheckable(true);
+    m_lumaDecodeAction->setStatusTip("Decode only the brightness plane (faster; colour only if the backend provides YUV). "
+                                     "Takes effect the next time playback starts");
+    connect(m_lumaDecodeAction, &QAction::toggled, m_videoProcessor.get(), &VideoProcessor::setLumaOnlyDecode,
+            Qt::DirectConnection);
+
+    m_adaptiveQualityAction = new QAction("&Adaptive Quality", this);
+    m_adaptiveQualityAction->setCheckable(true);
+    m_adaptiveQualityAction->setChecked(true);
+    m_adaptiveQualityAction->setStatusTip("Lower analysis resolution, analyse or show fewer frames when playback "
+                                          "cannot keep up, and restore quality when it can");
+    connect(m_adaptiveQualityAction, &QAction::toggled, this, &MainWindow::onAdaptiveQualityToggled);
+
+    m_showProfileAction = new QAction("Show Pipeline &Profile", this);
+    m_showProfileAction->setCheckable(true);
+    m_showProfileAction->setStatusTip("Time each pipeline stage and show p50/p99 latencies in the status bar");
+    connect(m_showProfileAction, &QAction::toggled, this, &MainWindow::onShowProfileToggled);
+
+    m_recordTraceAction = new QAction("Record &Trace...", this);
+    m_recordTraceAction->setStatusTip("Record every pipeline stage to a Chrome trace file (open in Perfetto)");
+    connect(m_recordTraceAction, &QAction::triggered, this, &MainWindow::onRecordTrace);
+
     m_exitAction = new QAction(style()->standardIcon(QStyle::SP_DialogCloseButton), "E&xit", this);
     m_exitAction->setShortcut(QKeySequence::Quit);
     m_exitAction->setStatusTip("Exit the application");
@@ -125,11 +304,25 @@ void MainWindow::createMenus()
 {
     QMenu* fileMenu = menuBar()->addMenu("&File");
     fileMenu->addAction(m_openAction);
+    fileMenu->addAction(m_exportStatsAction);
+    fileMenu->addAction(m_exportMaskVideoAction);
+    fileMenu->addAction(m_exportOverlayVideoAction);
+    fileMenu->addAction(m_recordMaskArchiveAction);
+    fileMenu->addAction(m_recordEventsAction);
+    fileMenu->addAction(m_exportHeatmapAction);
+    fileMenu->addAction(m_openMaskArchiveAction);
+    fileMenu->addAction(m_openMosaicAction);
     fileMenu->addSeparator();
     fileMenu->addAction(m_exitAction);
 
     QMenu* controlMenu = menuBar()->addMenu("&Control");
     controlMenu->addAction(m_playPauseAction);
+    controlMenu->addSeparator();
+    controlMenu->addAction(m_lumaDecodeAction);
+    controlMenu->addAction(m_adaptiveQualityAction);
+    controlMenu->addSeparator();
+    controlMenu->addAction(m_showProfileAction);
+    controlMenu->addAction(m_recordTraceAction);
 }
 
 void MainWindow::createToolBar()
@@ -145,6 +338,19 @@ void MainWindow::createStatusBar()
 {
     m_statusLabel = new QLabel("Ready");
     statusBar()->addWidget(m_statusLabel);
+    m_droppedFramesLabel = new QLabel();
+    statusBar()->addPermanentWidget(m_droppedFramesLabel);
+    m_playbackRateLabel = new QLabel();
+    statusBar()->addPermanentWidget(m_playbackRateLabel);
+    m_qualityLabel = new QLabel();
+    statusBar()->addPermanentWidget(m_qualityLabel);
+    m_profileLabel = new QLabel();
+    m_profileLabel->setVisible(false);
+    statusBar()->addPermanentWidget(m_profileLabel);
+
+    m_profileTimer = new QTimer(this);
+    m_profileTimer->setInterval(500);
+    connect(m_profileTimer, &QTimer::timeout, this, &MainWindow::updateProfileLabel);
 }
 
 void MainWindow::connectSignalsSlots()
@@ -154,13 +360,56 @@ void MainWindow::connectSignalsSlots()
     connect(m_openAction, &QAction::triggered, this, &MainWindow::onOpenFile);
     connect(m_playPauseButton, &QPushButton::clicked, this, &MainWindow::onPlayPause);
     connect(m_deltaSpinBox, qOverload<int>(&QSpinBox::valueChanged), this, &MainWindow::onDeltaChanged);
+    connect(m_deltaSetEdit, &QLineEdit::editingFinished, this, &MainWindow::onDeltaSetEdited);
+    connect(m_deltaGridCheckBox, &QCheckBox::toggled, this,
+            [this](bool checked) { m_videoProcessor->setDeltaGridDisplay(checked); });
     connect(m_thresholdSlider, &QSlider::valueChanged, this, &MainWindow::onThresholdChanged);
+    connect(m_algorithmComboBox, qOverload<int>(&QComboBox::currentIndexChanged), this, &MainWindow::onAlgorithmChanged);
+    connect(m_threadsSpinBox, qOverload<int>(&QSpinBox::valueChanged), this, &MainWindow::onAnalysisThreadsChanged);
+    connect(m_speedComboBox, qOverload<int>(&QComboBox::currentIndexChanged), this, &MainWindow::onSpeedChanged);
+    connect(m_scaleComboBox, qOverload<int>(&QComboBox::currentIndexChanged), this, &MainWindow::onAnalysisScaleChanged);
+    connect(m_heatmapCheckBox, &QCheckBox::toggled, this, &MainWindow::onHeatmapToggled);
+    connect(m_heatmapWindowSpinBox, qOverload<int>(&QSpinBox::valueChanged), this,
+            [this](int seconds) { m_videoProcessor->setHeatmapWindow(seconds); });
+    // actionTriggered fires for drags, clicks and keys but not for setValue() from playback.
+    connect(m_timelineSlider, &QSlider::actionTriggered, this, &MainWindow::onTimelineActionTriggered);
+    connect(m_activityStrip, &ActivityStripWidget::frameRequested, this, &MainWindow::onActivityFrameRequested);
+    connect(m_activityRestartTimer, &QTimer::timeout, this, &MainWindow::restartActivityIndex);
+    // Emitted on the indexing thread; queued to this thread.
+    connect(&m_activityIndexer, &ActivityIndexer::indexUpdated, this, &MainWindow::handleActivityIndexUpdated);
+    // Both panes share a layout stretch, so the original pane's size stands for both.
+    connect(m_originalDisplayWidget, &VideoDisplayWidget::targetFrameSizeChanged, this, &MainWindow::onDisplaySizeChanged);
 
     // VideoProcessor -> MainWindow Slots
-    connect(m_videoProcessor.get(), &VideoProcessor::newFramesReady, this, &MainWindow::updateFrames);
+    connect(m_videoProcessor.get(), &VideoProcessor::framesAvailable, this, &MainWindow::presentLatestFrames);
     connect(m_videoProcessor.get(), &VideoProcessor::processingFinished, this, &MainWindow::handleProcessingFinished);
     connect(m_videoProcessor.get(), &VideoProcessor::errorOccurred, this, &MainWindow::handleVideoLoadError);
     connect(m_videoProcessor.get(), &VideoProcessor::videoInfoReady, this, &MainWindow::handleVideoInfoReady);
+    connect(m_videoProcessor.get(), &VideoProcessor::playbackRateUpdated, this, &MainWindow::handlePlaybackRateUpdated);
+    connect(m_videoProcessor.get(), &VideoProcessor::qualityLevelChanged, this, &MainWindow::handleQualityLevelChanged);
+    connect(m_videoProcessor.get(), &VideoProcessor::keyframeIndexReady, this, &MainWindow::handleKeyframeIndexReady);
+    // Emitted on the recorder thread, so these are queued.
+    connect(&m_eventRecorder, &EventRecorder::clipStarted, this, [this](const QString& path, qint64) {
+        statusBar()->showMessage("Motion event: recording " + QFileInfo(path).fileName(), 3000);
+    });
+    connect(&m_eventRecorder, &EventRecorder::clipFinished, this,
+            [this](const QString& path, qint64 firstFrame, qint64 lastFrame) {
+                statusBar()->showMessage(QString("Saved %1 (frames %2-%3)")
+                                         .arg(QFileInfo(path).fileName())
+                                         .arg(firstFrame)
+                                         .arg(lastFrame), 5000);
+            });
+    // Written on the processing thread; the writer only buffers, so this never waits on disk.
+    connect(m_videoProcessor.get(), &VideoProcessor::motionStatsReady, this,
+            [this](const MotionStats& stats) { m_statsWriter.write(stats); }, Qt::DirectConnection);
+    // Only queues references; the exporters and the event recorder encode on their own threads.
+    connect(m_videoProcessor.get(), &VideoProcessor::frameAnalyzed, this,
+            [this](qint64 frameIndex, const cv::Mat& frame, FrameLayout layout, const cv::Mat& mask) {
+                m_maskExporter.submit(frame, layout, mask);
+                m_overlayExporter.submit(frame, layout, mask);
+                m_eventRecorder.submit(frameIndex, frame, layout, mask);
+                m_maskArchiveWriter.append(frameIndex, mask);
+            }, Qt::DirectConnection);
 }
 
 void MainWindow::onOpenFile()
@@ -171,14 +420,288 @@ void MainWindow::onOpenFile()
                                                     "Video Files (*.mp4 *.avi *.mov *.mkv *.wmv);;All Files (*)");
 
     if (!fileName.isEmpty()) {
+        m_maskArchiveReader.close();
+        m_activityIndexer.cancel();
+        m_activityStrip->clear();
         m_currentFilePath = fileName;
         m_isFileLoaded = false;
         m_isPlaying = false;
-        m_videoProcessor->loadVideo(m_currentFilePath);
+        // Before loadVideo(): with a cached probe, videoInfoReady() arrives during the call.
         m_statusLabel->setText("Loading: " + QFileInfo(m_currentFilePath).fileName());
+        m_videoProcessor->loadVideo(m_currentFilePath);
     }
 }
 
+void MainWindow::onExportMotionStats()
+{
+    if (m_statsWriter.isOpen()) {
+        m_videoProcessor->setMotionStatsEnabled(false);
+        const QString path = m_statsWriter.path();
+        const bool ok = m_statsWriter.close();
+        updateAnalysisSinks();
+        m_exportStatsAction->setText("&Export Motion Stats...");
+        if (!ok) {
+            QMessageBox::warning(this, "Export Motion Stats",
+                                 "Writing " + path + " failed; the file is incomplete.");
+            return;
+        }
+        statusBar()->showMessage("Motion stats saved to " + QFileInfo(path).fileName(), 3000);
+        return;
+    }
+
+    const QString suggested = m_currentFilePath.isEmpty() ? QDir::homePath() : m_currentFilePath + ".motion.csv";
+    const QString fileName = QFileDialog::getSaveFileName(this,
+                                                          "Export Motion Stats",
+                                                          suggested,
+                                                          "CSV (*.csv);;JSON Lines (*.jsonl)");
+    if (fileName.isEmpty()) return;
+
+    if (!m_statsWriter.open(fileName, MotionStatsWriter::formatForPath(fileName))) {
+        QMessageBox::warning(this, "Export Motion Stats", "Could not open " + fileName + " for writing.");
+        return;
+    }
+    m_videoProcessor->setMotionStatsEnabled(true);
+    updateAnalysisSinks();
+    m_exportStatsAction->setText("Stop Motion Stats &Export");
+    statusBar()->showMessage("Exporting motion stats to " + QFileInfo(fileName).fileName(), 3000);
+}
+
+void MainWindow::onExportVideo(VideoExporter* exporter)
+{
+    const bool mask = exporter->content() == VideoExporter::Content::Mask;
+    QAction* action = mask ? m_exportMaskVideoAction : m_exportOverlayVideoAction;
+    const QString title = mask ? "Export Mask Video" : "Export Overlay Video";
+
+    if (exporter->isOpen()) {
+        const QString path = exporter->path();
+        exporter->close();
+        updateAnalysisSinks();
+        action->setText(mask ? "Export &Mask Video..." : "Export &Overlay Video...");
+        statusBar()->showMessage(QString("%1 frames saved to %2 (%3 dropped while the encoder was behind)")
+                                 .arg(exporter->framesWritten())
+                                 .arg(QFileInfo(path).fileName())
+                                 .arg(exporter->framesDropped()), 3000);
+        return;
+    }
+
+    const QString suffix = mask ? ".mask.mp4" : ".overlay.mp4";
+    const QString suggested = m_currentFilePath.isEmpty() ? QDir::homePath() : m_currentFilePath + suffix;
+    const QString fileName = QFileDialog::getSaveFileName(this, title, suggested,
+                                                          "MP4 Video (*.mp4);;AVI Video, MJPEG (*.avi)");
+    if (fileName.isEmpty()) return;
+
+    if (!exporter->open(fileName, m_videoFps)) {
+        QMessageBox::warning(this, title, "Could not start exporting to " + fileName + ".");
+        return;
+    }
+    updateAnalysisSinks();
+    action->setText(mask ? "Stop &Mask Video Export" : "Stop &Overlay Video Export");
+    statusBar()->showMessage("Exporting to " + QFileInfo(fileName).fileName(), 3000);
+}
+
+void MainWindow::onRecordMaskArchive()
+{
+    if (m_maskArchiveWriter.isOpen()) {
+        const QString path = m_maskArchiveWriter.path();
+        const quint64 frames = m_maskArchiveWriter.framesWritten();
+        const bool ok = m_maskArchiveWriter.close();
+        updateAnalysisSinks();
+        m_recordMaskArchiveAction->setText("Record Mask &Archive...");
+        if (!ok) {
+            QMessageBox::warning(this, "Record Mask Archive",
+                                 "Writing " + path + " failed; the archive is incomplete.");
+            return;
+        }
+        statusBar()->showMessage(QString("%1 masks saved to %2").arg(frames).arg(QFileInfo(path).fileName()), 3000);
+        return;
+    }
+
+    const QString suggested = m_currentFilePath.isEmpty() ? QDir::homePath() : m_currentFilePath + ".motmask";
+    const QString fileName = QFileDialog::getSaveFileName(this, "Record Mask Archive", suggested,
+                                                          "Mask Archive (*.motmask)");
+    if (fileName.isEmpty()) return;
+
+    if (!m_maskArchiveWriter.open(fileName)) {
+        QMessageBox::warning(this, "Record Mask Archive", "Could not open " + fileName + " for writing.");
+        return;
+    }
+    updateAnalysisSinks();
+    m_recordMaskArchiveAction->setText("Stop Mask &Archive Recording");
+    statusBar()->showMessage("Recording masks to " + QFileInfo(fileName).fileName(), 3000);
+}
+
+void MainWindow::onRecordMotionEvents()
+{
+    if (m_eventRecorder.isRunning()) {
+        m_eventRecorder.stop();
+        updateAnalysisSinks();
+        m_recordEventsAction->setText("Record Motion &Events...");
+        statusBar()->showMessage(QString("%1 event clips saved").arg(m_eventRecorder.clipsWritten()), 3000);
+        return;
+    }
+
+    const QString suggested = m_currentFilePath.isEmpty() ? QDir::homePath() : QFileInfo(m_currentFilePath).path();
+    const QString directory = QFileDialog::getExistingDirectory(this, "Record Motion Events", suggested);
+    if (directory.isEmpty()) return;
+
+    EventRecorderSettings settings;
+    bool ok = false;
+    const double percent = QInputDialog::getDouble(this, "Record Motion Events",
+                                                   "Start a clip when this share of the frame (%) keeps moving:",
+                                                   settings.triggerRatio * 100.0, 0.01, 100.0, 2, &ok);
+    if (!ok) return;
+    settings.outputDir = directory;
+    settings.triggerRatio = percent / 100.0;
+    if (!m_currentFilePath.isEmpty()) settings.baseName = QFileInfo(m_currentFilePath).completeBaseName();
+
+    if (!m_eventRecorder.start(settings, m_videoFps)) {
+        QMessageBox::warning(this, "Record Motion Events", "Could not write clips to " + directory + ".");
+        return;
+    }
+    updateAnalysisSinks();
+    m_recordEventsAction->setText("Stop Motion &Event Recording");
+    statusBar()->showMessage("Recording motion events to " + directory, 3000);
+}
+
+void MainWindow::onOpenMosaic()
+{
+    const QStringList fileNames = QFileDialog::getOpenFileNames(
+        this, "Open Mosaic", m_currentFilePath.isEmpty() ? QDir::homePath() : QFileInfo(m_currentFilePath).path(),
+        "Video Files (*.mp4 *.avi *.mov *.mkv *.wmv);;All Files (*)");
+    if (fileNames.isEmpty()) return;
+
+    // Streams run on the window's own pool, independent of the player; they follow the
+    // delta and threshold controls.
+    // The window shows at once; it reports files that can't be opened itself.
+    auto* mosaic = new MosaicWindow(fileNames, m_deltaSpinBox->value(), m_thresholdSlider->value(), this);
+    connect(m_deltaSpinBox, qOverload<int>(&QSpinBox::valueChanged), mosaic, &MosaicWindow::setFrameDelta);
+    connect(m_thresholdSlider, &QSlider::valueChanged, mosaic, &MosaicWindow::setMotionThreshold);
+    mosaic->show();
+}
+
+void MainWindow::onOpenMaskArchive()
+{
+    const QString fileName = QFileDialog::getOpenFileName(this, "Open Mask Archive",
+                                                          m_currentFilePath.isEmpty() ? QDir::homePath() : QFileInfo(m_currentFilePath).path(),
+                                                          "Mask Archive (*.motmask);;All Files (*)");
+    if (fileName.isEmpty()) return;
+
+    if (!m_maskArchiveReader.open(fileName)) {
+        QMessageBox::warning(this, "Open Mask Archive", fileName + " is not a readable mask archive.");
+        return;
+    }
+    // Archives are browsed on their own: the video is closed and the timeline spans the
+    // archive's frames.
+    if (m_isPlaying) m_videoProcessor->stop();
+    m_activityIndexer.cancel();
+    m_activityStrip->clear();
+    m_isPlaying = false;
+    m_isFileLoaded = false;
+    m_currentFilePath.clear();
+    if (m_originalDisplayWidget) m_originalDisplayWidget->clear();
+    m_frameCount = m_maskArchiveReader.lastFrameIndex() + 1;
+    m_timelineSlider->setRange(0, static_cast<int>(std::max<qint64>(0, m_frameCount - 1)));
+    m_statusLabel->setText("Mask archive: " + QFileInfo(fileName).fileName());
+    statusBar()->showMessage(QString("Mask archive: %1 frames").arg(m_maskArchiveReader.recordCount()), 3000);
+    updateTimeline(m_timelineSlider->value());
+    showArchivedMask(m_timelineSlider->value());
+    updateUIState();
+}
+
+void MainWindow::onActivityFrameRequested(qint64 frameIndex)
+{
+    if (m_isFileLoaded) m_videoProcessor->seekToFrame(frameIndex);
+    updateTimeline(frameIndex);
+    showArchivedMask(frameIndex);
+}
+
+void MainWindow::restartActivityIndex()
+{
+    if (!m_isFileLoaded || m_currentFilePath.isEmpty()) return;
+    // A cached index for these settings shows up at once; otherwise it fills in as the
+    // background scan proceeds.
+    m_activityIndexer.start(m_currentFilePath, m_deltaSpinBox->value(), m_thresholdSlider->value());
+}
+
+void MainWindow::handleActivityIndexUpdated(qint64 framesIndexed, bool complete)
+{
+    std::shared_ptr<const ActivityIndex> index = m_activityIndexer.snapshot();
+    if (!index) return;
+    m_activityStrip->setIndex(index, m_frameCount);
+    m_activityStrip->setToolTip(complete
+        ? QString("Motion activity (click to seek)")
+        : QString("Motion activity: %1 of %2 frames indexed (click to seek)").arg(framesIndexed).arg(m_frameCount));
+}
+
+void MainWindow::updateAnalysisSinks()
+{
+    // Adaptive quality would otherwise skip masks, and these record every frame.
+    const bool recording = m_statsWriter.isOpen() || m_maskExporter.isOpen() || m_overlayExporter.isOpen()
+        || m_maskArchiveWriter.isOpen() || m_eventRecorder.isRunning();
+    m_videoProcessor->setAnalyseEveryFrame(recording);
+}
+
+void MainWindow::showArchivedMask(qint64 frameIndex)
+{
+    if (!m_maskArchiveReader.isOpen() || !m_maskDisplayWidget) return;
+    cv::Mat mask;
+    if (m_maskArchiveReader.readFrame(frameIndex, mask)) m_maskDisplayWidget->setFrame(mask);
+    else m_maskDisplayWidget->clear();
+}
+
+void MainWindow::onShowProfileToggled(bool checked)
+{
+    if (checked) {
+        Profiler::reset();
+        Profiler::setEnabled(true);
+        updateProfileLabel();
+        m_profileTimer->start();
+    } else {
+        Profiler::setEnabled(false); // Stays on while a trace is recording
+        m_profileTimer->stop();
+    }
+    m_profileLabel->setVisible(checked);
+}
+
+void MainWindow::onRecordTrace()
+{
+    if (Profiler::isTracing()) {
+        Profiler::stopTrace();
+        Profiler::setEnabled(m_showProfileAction->isChecked());
+        m_recordTraceAction->setText("Record &Trace...");
+        statusBar()->showMessage("Pipeline trace saved", 3000);
+        return;
+    }
+
+    const QString fileName = QFileDialog::getSaveFileName(this,
+                                                          "Record Pipeline Trace",
+                                                          QDir::homePath() + "/pipeline-trace.json",
+                                                          "Chrome Trace (*.json)");
+    if (fileName.isEmpty()) return;
+
+    Profiler::startTrace(fileName);
+    m_recordTraceAction->setText("Stop &Trace Recording");
+    statusBar()->showMessage("Recording pipeline trace to " + QFileInfo(fileName).fileName(), 3000);
+}
+
+void MainWindow::updateProfileLabel()
+{
+    // Compact "stage p50/p99" list; the tooltip has the full numbers.
+    const auto stages = Profiler::summary();
+    QStringList parts;
+    for (size_t stage = 0; stage < stages.size(); ++stage) {
+        const StageSummary& s = stages[stage];
+        if (s.count == 0) continue;
+        parts << QString("%1 %2/%3")
+                     .arg(profileStageName(static_cast<ProfileStage>(stage)))
+                     .arg(QString::number(s.p50Ms, 'f', 1))
+                     .arg(QString::number(s.p99Ms, 'f', 1));
+    }
+    m_profileLabel->setText(parts.isEmpty() ? QString("Profile: no samples")
+                                            : "p50/p99 ms: " + parts.join("  "));
+    m_profileLabel->setToolTip(Profiler::summaryText().trimmed());
+}
+
 void MainWindow::onPlayPause()
 {
     if (!m_isFileLoaded) return;
@@ -198,23 +721,181 @@ void MainWindow::onPlayPause()
 void MainWindow::onDeltaChanged(int value)
 {
     m_videoProcessor->setFrameDelta(value);
+    if (m_isFileLoaded) m_activityRestartTimer->start();
+}
+
+void MainWindow::onDeltaSetEdited()
+{
+    std::vector<int> deltas;
+    if (!VideoProcessor::parseFrameDeltaSet(m_deltaSetEdit->text(), deltas)) {
+        statusBar()->showMessage(QString("Delta set: up to %1 deltas between 1 and %2")
+                                     .arg(kMaxFusedDeltas)
+                                     .arg(VideoProcessor::kMaxFrameDelta),
+                                 5000);
+        return;
+    }
+    QStringList normalized;
+    for (int delta : deltas) normalized << QString::number(delta);
+    m_deltaSetEdit->setText(normalized.join(","));
+    m_videoProcessor->setFrameDeltaSet(deltas);
+    m_deltaSetActive = !deltas.empty();
+    updateUIState();
 }
 
 void MainWindow::onThresholdChanged(int value)
 {
     m_thresholdValueLabel->setText(QString::number(value));
     m_videoProcessor->setMotionThreshold(value);
+    if (m_isFileLoaded) m_activityRestartTimer->start();
+}
+
+void MainWindow::onAlgorithmChanged(int index)
+{
+    m_videoProcessor->setMotionAlgorithm(static_cast<MotionAlgorithm>(m_algorithmComboBox->itemData(index).toInt()));
+}
+
+void MainWindow::onAnalysisThreadsChanged(int value)
+{
+    m_videoProcessor->setAnalysisThreads(value);
+}
+
+void MainWindow::onSpeedChanged(int index)
+{
+    m_videoProcessor->setPlaybackSpeed(m_speedComboBox->itemData(index).toDouble());
+}
+
+void MainWindow::onAnalysisScaleChanged(int index)
+{
+    m_videoProcessor->setAnalysisScale(m_scaleComboBox->itemData(index).toInt());
+}
+
+void MainWindow::onHeatmapToggled(bool enabled)
+{
+    m_videoProcessor->setHeatmapWindow(m_heatmapWindowSpinBox->value());
+    m_videoProcessor->setHeatmapEnabled(enabled);
+    m_heatmapDisplayWidget->clear();
+    m_heatmapDisplayWidget->setVisible(enabled);
+    m_exportHeatmapAction->setEnabled(enabled);
+}
+
+void MainWindow::onExportHeatmap()
+{
+    cv::Mat heatmap;
+    if (!m_videoProcessor->heatmapImage(heatmap)) {
+        QMessageBox::information(this, "Export Heatmap Image", "The heatmap is empty; play the video first.");
+        return;
+    }
+    const QString suggested = m_currentFilePath.isEmpty() ? QDir::homePath() : m_currentFilePath + ".heatmap.png";
+    const QString fileName = QFileDialog::getSaveFileName(this, "Export Heatmap Image", suggested,
+                                                          "PNG Image (*.png);;JPEG Image (*.jpg)");
+    if (fileName.isEmpty()) return;
+
+    bool saved = false;
+    try {
+        saved = cv::imwrite(fileName.toStdString(), heatmap);
+    } catch (const cv::Exception& e) {
+        qWarning() << "Heatmap export failed:" << e.what();
+    }
+    if (!saved) {
+        QMessageBox::warning(this, "Export Heatmap Image", "Could not write " + fileName + ".");
+        return;
+    }
+    statusBar()->showMessage("Heatmap saved to " + QFileInfo(fileName).fileName(), 3000);
+}
+
+void MainWindow::onTimelineActionTriggered(int action)
+{
+    Q_UNUSED(action);
+    // sliderPosition() already holds the value the action is about to apply.
+    const qint64 frameIndex = m_timelineSlider->sliderPosition();
+    if (m_isFileLoaded) m_videoProcessor->seekToFrame(frameIndex);
+    updateTimeline(frameIndex);
+    showArchivedMask(frameIndex);
+}
+
+void MainWindow::updateTimeline(qint64 frameIndex)
+{
+    if (!m_timelineSlider->isSliderDown()) {
+        QSignalBlocker blocker(m_timelineSlider);
+        m_timelineSlider->setValue(static_cast<int>(frameIndex));
+    }
+    m_activityStrip->setCurrentFrame(frameIndex);
+    const double fps = m_videoFps > 0 ? m_videoFps : 30.0;
+    auto formatTime = [](double seconds) {
+        const int total = static_cast<int>(seconds);
+        return QString("%1:%2").arg(total / 60).arg(total % 60, 2, 10, QChar('0'));
+    };
+    m_timeLabel->setText(QString("%1 / %2")
+                         .arg(formatTime(frameIndex / fps))
+                         .arg(formatTime(m_frameCount / fps)));
+}
+
+void MainWindow::onDisplaySizeChanged(const QSize& size)
+{
+    m_videoProcessor->setDisplaySize(size.width(), size.height());
 }
 
-void MainWindow::updateFrames(const cv::Mat& original, const cv::Mat& mask)
+void MainWindow::presentLatestFrames()
 {
-    if(m_originalDisplayWidget) m_originalDisplayWidget->setFrame(original);
-    if(m_maskDisplayWidget) m_maskDisplayWidget->setFrame(mask);
+    // Present at most once per screen refresh; a wake-up that arrives early is deferred
+    // to the next refresh and then shows whatever frames are newest at that point.
+    const qreal refreshRate = screen() ? screen()->refreshRate() : 60.0;
+    const qint64 refreshIntervalMs = static_cast<qint64>(1000.0 / (refreshRate > 0 ? refreshRate : 60.0));
+    if (m_lastPresentTimer.isValid() && m_lastPresentTimer.elapsed() < refreshIntervalMs) {
+        if (!m_presentScheduled) {
+            m_presentScheduled = true;
+            QTimer::singleShot(refreshIntervalMs - m_lastPresentTimer.elapsed(), this, [this]() {
+                m_presentScheduled = false;
+                presentLatestFrames();
+            });
+        }
+        return;
+    }
+
+    ProfileScope scope(ProfileStage::Present);
+    DisplayFrames frames;
+    if (!m_videoProcessor->takeLatestFrames(frames)) return;
+    m_lastPresentTimer.start();
+
+    if(m_originalDisplayWidget) m_originalDisplayWidget->setFrame(frames.original);
+    if(m_maskDisplayWidget) m_maskDisplayWidget->setFrame(frames.mask);
+    if (m_heatmapDisplayWidget->isVisible() && !frames.heatmap.empty()) m_heatmapDisplayWidget->setFrame(frames.heatmap);
+    if (frames.frameIndex >= 0) updateTimeline(frames.frameIndex);
+
+    const quint64 dropped = m_videoProcessor->droppedDisplayFrames();
+    m_droppedFramesLabel->setText(dropped > 0 ? QString("Dropped: %1").arg(dropped) : QString());
+}
+
+void MainWindow::handlePlaybackRateUpdated(double measuredFps, double targetFps)
+{
+    m_playbackRateLabel->setText(QString("%1 / %2 fps")
+                                 .arg(QString::number(measuredFps, 'f', 1))
+                                 .arg(QString::number(targetFps, 'f', 1)));
+}
+
+void MainWindow::handleQualityLevelChanged(int level, const QString& description)
+{
+    m_qualityLabel->setText("Quality: " + description);
+    m_qualityLabel->setToolTip(level == QosController::Full
+                                   ? QString("Playback keeps up at the configured quality")
+                                   : QString("Reduced so playback keeps up with the clock; restored when there is headroom"));
+}
+
+void MainWindow::onAdaptiveQualityToggled(bool enabled)
+{
+    m_videoProcessor->setAdaptiveQuality(enabled);
+    if (!enabled) {
+        m_qualityLabel->clear();
+    } else if (m_isPlaying) {
+        handleQualityLevelChanged(QosController::Full, QosController::levelName(QosController::Full));
+    }
 }
 
 void MainWindow::handleProcessingFinished()
 {
     m_isPlaying = false;
+    m_playbackRateLabel->clear();
+    m_qualityLabel->clear();
     m_statusLabel->setText("Finished: " + QFileInfo(m_currentFilePath).fileName());
     updateUIState();
     // clear displays?
@@ -232,30 +913,54 @@ void MainWindow::handleVideoLoadError(const QString& message)
     m_videoInfoLabel->setText("Load Error.");
      if(m_originalDisplayWidget) m_originalDisplayWidget->clear();
      if(m_maskDisplayWidget) m_maskDisplayWidget->clear();
+     m_heatmapDisplayWidget->clear();
     updateUIState();
 }
 
-void MainWindow::handleVideoInfoReady(double fps, int width, int height)
+void MainWindow::handleVideoInfoReady(double fps, int width, int height, qint64 frameCount)
 {
      m_isFileLoaded = true;
      m_isPlaying = false;
+     m_videoFps = fps;
+     m_frameCount = frameCount;
+     m_timelineSlider->setRange(0, static_cast<int>(std::max<qint64>(0, frameCount - 1)));
+     m_timelineSlider->setPageStep(std::max(1, static_cast<int>(fps * 10)));
+     updateTimeline(0);
      m_videoInfoLabel->setText(QString("Loaded: %1x%2 @ %3 FPS")
                               .arg(width)
                               .arg(height)
                               .arg(QString::number(fps, 'f', 2)));
      m_statusLabel->setText("Ready: " + QFileInfo(m_currentFilePath).fileName());
+     m_activityStrip->clear();
+     restartActivityIndex();
      if(m_originalDisplayWidget) m_originalDisplayWidget->clear();
      if(m_maskDisplayWidget) m_maskDisplayWidget->clear();
+     m_heatmapDisplayWidget->clear();
      updateUIState();
 }
 
+void MainWindow::handleKeyframeIndexReady(int keyframeCount, bool exact)
+{
+    statusBar()->showMessage(exact ? QString("Keyframe index: %1 keyframes").arg(keyframeCount)
+                                   : QString("Keyframe index unavailable, seeking by position"),
+                             3000);
+}
 
 void MainWindow::updateUIState()
 {
     m_playPauseButton->setEnabled(m_isFileLoaded);
     m_playPauseAction->setEnabled(m_isFileLoaded);
-    m_deltaSpinBox->setEnabled(true);
+    // A delta set overrides the single delta and the algorithm (it is always frame difference).
+    const bool singleDelta = !m_deltaSetActive;
+    m_deltaSpinBox->setEnabled(singleDelta);
+    m_deltaSetEdit->setEnabled(true);
+    m_deltaGridCheckBox->setEnabled(!singleDelta);
     m_thresholdSlider->setEnabled(true);
+    m_algorithmComboBox->setEnabled(singleDelta);
+    m_threadsSpinBox->setEnabled(true);
+    m_speedComboBox->setEnabled(true);
+    m_scaleComboBox->setEnabled(true);
+    m_timelineSlider->setEnabled(m_isFileLoaded || m_maskArchiveReader.isOpen());
 
     if (m_isPlaying) {
         m_playPauseButton->setText("Pause");
@@ -3,16 +3,28 @@
 
 #include <QMainWindow>
 #include <QString>
+#include <QElapsedTimer>
 #include <memory>
 #include <opencv2/opencv.hpp>
 
+#include "MotionStatsWriter.h"
+#include "VideoExporter.h"
+#include "MaskArchive.h"
+#include "ActivityIndex.h"
+#include "EventRecorder.h"
+
 class VideoProcessor;
 class VideoDisplayWidget;
+class ActivityStripWidget;
 class QPushButton;
 class QLabel;
 class QSlider;
 class QAction;
 class QSpinBox; // SpinBox for better control over Delta..?
+class QComboBox;
+class QLineEdit;
+class QCheckBox;
+class QTimer;
 
 class MainWindow : public QMainWindow
 {
@@ -25,15 +37,40 @@ public:
 private slots:
     // UI
     void onOpenFile();
+    void onExportMotionStats();
+    void onExportVideo(VideoExporter* exporter);
+    void onRecordMaskArchive();
+    void onRecordMotionEvents();
+    void onOpenMaskArchive();
+    void onOpenMosaic();
+    void onActivityFrameRequested(qint64 frameIndex);
+    void restartActivityIndex();
+    void handleActivityIndexUpdated(qint64 framesIndexed, bool complete);
     void onPlayPause();
     void onDeltaChanged(int value);
+    void onDeltaSetEdited();
     void onThresholdChanged(int value);
+    void onAlgorithmChanged(int index);
+    void onAnalysisThreadsChanged(int value);
+    void onDisplaySizeChanged(const QSize& size);
+    void onSpeedChanged(int index);
+    void onAnalysisScaleChanged(int index);
+    void onHeatmapToggled(bool enabled);
+    void onExportHeatmap();
+    void onTimelineActionTriggered(int action);
+    void onShowProfileToggled(bool checked);
+    void onRecordTrace();
+    void updateProfileLabel();
 
     // VideoProcessor
-    void updateFrames(const cv::Mat& original, const cv::Mat& mask);
+    void presentLatestFrames();
     void handleProcessingFinished();
     void handleVideoLoadError(const QString& message);
-    void handleVideoInfoReady(double fps, int width, int height);
+    void handleVideoInfoReady(double fps, int width, int height, qint64 frameCount);
+    void handleKeyframeIndexReady(int keyframeCount, bool exact);
+    void handlePlaybackRateUpdated(double measuredFps, double targetFps);
+    void handleQualityLevelChanged(int level, const QString& description);
+    void onAdaptiveQualityToggled(bool enabled);
 
     // Internal UI Update
     void updateUIState();
@@ -46,33 +83,79 @@ private:
     void createToolBar();
     void createStatusBar();
     void connectSignalsSlots();
+    void updateTimeline(qint64 frameIndex);
+    void showArchivedMask(qint64 frameIndex);
+    // Every frame gets a real mask while anything records per-frame results.
+    void updateAnalysisSinks();
 
 
     // UI
     QWidget* m_centralWidget = nullptr;
     VideoDisplayWidget* m_originalDisplayWidget = nullptr;
     VideoDisplayWidget* m_maskDisplayWidget = nullptr;
+    VideoDisplayWidget* m_heatmapDisplayWidget = nullptr; // Hidden unless the heatmap is on
     QPushButton* m_playPauseButton = nullptr;
     QPushButton* m_openButton = nullptr;
+    QSlider* m_timelineSlider = nullptr;
+    ActivityStripWidget* m_activityStrip = nullptr;
+    QTimer* m_activityRestartTimer = nullptr; // Debounces delta/threshold edits
+    QLabel* m_timeLabel = nullptr;
     QSlider* m_thresholdSlider = nullptr;
     QLabel* m_thresholdValueLabel = nullptr;
     QSpinBox* m_deltaSpinBox = nullptr;
     QLabel* m_deltaValueLabel = nullptr;
+    QLineEdit* m_deltaSetEdit = nullptr;
+    QCheckBox* m_deltaGridCheckBox = nullptr;
+    QCheckBox* m_heatmapCheckBox = nullptr;
+    QSpinBox* m_heatmapWindowSpinBox = nullptr;
+    QSpinBox* m_threadsSpinBox = nullptr;
+    QComboBox* m_speedComboBox = nullptr;
+    QComboBox* m_scaleComboBox = nullptr;
+    QComboBox* m_algorithmComboBox = nullptr;
     QLabel* m_statusLabel = nullptr;
+    QLabel* m_droppedFramesLabel = nullptr;
+    QLabel* m_playbackRateLabel = nullptr;
+    QLabel* m_qualityLabel = nullptr;
     QLabel* m_videoInfoLabel = nullptr;
+    QLabel* m_profileLabel = nullptr;
+    QTimer* m_profileTimer = nullptr;
 
     // Actions
     QAction* m_openAction = nullptr;
     QAction* m_playPauseAction = nullptr;
+    QAction* m_exportStatsAction = nullptr;
+    QAction* m_exportMaskVideoAction = nullptr;
+    QAction* m_exportOverlayVideoAction = nullptr;
+    QAction* m_recordMaskArchiveAction = nullptr;
+    QAction* m_recordEventsAction = nullptr;
+    QAction* m_openMaskArchiveAction = nullptr;
+    QAction* m_openMosaicAction = nullptr;
+    QAction* m_exportHeatmapAction = nullptr;
+    QAction* m_lumaDecodeAction = nullptr;
+    QAction* m_adaptiveQualityAction = nullptr;
+    QAction* m_showProfileAction = nullptr;
+    QAction* m_recordTraceAction = nullptr;
     QAction* m_exitAction = nullptr;
 
-    // Backend
+    // Backend. The writers are declared first so they outlive the processor feeding them.
+    MotionStatsWriter m_statsWriter;
+    VideoExporter m_maskExporter{VideoExporter::Content::Mask};
+    VideoExporter m_overlayExporter{VideoExporter::Content::Overlay};
+    MaskArchiveWriter m_maskArchiveWriter;
+    EventRecorder m_eventRecorder;
+    MaskArchiveReader m_maskArchiveReader; // GUI thread only
+    ActivityIndexer m_activityIndexer;
     std::unique_ptr<VideoProcessor> m_videoProcessor;
 
     // State
     QString m_currentFilePath;
     bool m_isFileLoaded = false;
     bool m_isPlaying = false;
+    bool m_deltaSetActive = false; // A delta set replaces the single frame delta
+    double m_videoFps = 0.0;
+    qint64 m_frameCount = 0;
+    QElapsedTimer m_lastPresentTimer; // Limits display updates to one per screen refresh
+    bool m_presentScheduled = false;
 };
 
 #endif // MAINWINDOW_H
\ No newline at end of file
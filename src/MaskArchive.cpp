@@ -0,0 +1,529 @@
+#include "MaskArchive.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <QDebug>
+#include <QtEndian>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+constexpr char kFileMagic[8] = {'M', 'O', 'T', 'M', 'A', 'S', 'K', '\0'};
+constexpr quint32 kFileVersion = 1;
+constexpr size_t kFileHeaderBytes = 16;
+constexpr char kRecordTag[4] = {'M', 'F', 'R', 'M'};
+constexpr size_t kRecordHeaderBytes = 24;
+constexpr char kIndexTag[4] = {'M', 'I', 'D', 'X'};
+constexpr size_t kIndexEntryBytes = 24;
+constexpr size_t kFooterBytes = 16;
+
+enum BlockEncoding : quint32
+{
+    kBlockZero = 0,
+    kBlockRaw = 1,
+    kBlockPackBits = 2,
+    kBlockOnes = 3
+};
+
+template <typename T>
+void appendLittleEndian(std::string& out, T value)
+{
+    const T le = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char*>(&le), sizeof(le));
+}
+
+template <typename T>
+void storeLittleEndian(std::string& out, size_t position, T value)
+{
+    const T le = qToLittleEndian(value);
+    std::memcpy(&out[position], &le, sizeof(le));
+}
+
+template <typename T>
+T loadLittleEndian(const uchar* data)
+{
+    return qFromLittleEndian<T>(data);
+}
+
+// Byte -> the 8 mask pixels it encodes.
+const std::array<std::array<uchar, 8>, 256>& expansionTable()
+{
+    static const auto table = [] {
+        std::array<std::array<uchar, 8>, 256> result{};
+        for (int byte = 0; byte < 256; ++byte) {
+            for (int bit = 0; bit < 8; ++bit) result[byte][bit] = (byte >> bit) & 1 ? 255 : 0;
+        }
+        return result;
+    }();
+    return table;
+}
+
+// PackBits: a control byte n in [0, 127] is followed by n + 1 literal bytes, n in
+// [-127, -1] by one byte repeated 1 - n times.
+void packBitsEncode(const uchar* data, size_t size, std::vector<uchar>& out)
+{
+    out.clear();
+    size_t i = 0;
+    while (i < size) {
+        size_t run = 1;
+        while (i + run < size && run < 128 && data[i + run] == data[i]) ++run;
+        if (run >= 2) {
+            out.push_back(static_cast<uchar>(257 - run));
+            out.push_back(data[i]);
+            i += run;
+            continue;
+        }
+        // Literals until a run of three starts (a run of two is no cheaper than literals).
+        const size_t start = i;
+        while (i < size && i - start < 128) {
+            if (i + 2 < size && data[i] == data[i + 1] && data[i] == data[i + 2]) break;
+            ++i;
+        }
+        out.push_back(static_cast<uchar>(i - start - 1));
+        out.insert(out.end(), data + start, data + i);
+    }
+}
+
+bool packBitsDecode(const uchar* data, size_t size, uchar* out, size_t outSize)
+{
+    size_t in = 0;
+    size_t written = 0;
+    while (in < size) {
+        const int control = static_cast<signed char>(data[in++]);
+        if (control >= 0) {
+            const size_t count = static_cast<size_t>(control) + 1;
+            if (in + count > size || written + count > outSize) return false;
+            std::memcpy(out + written, data + in, count);
+            in += count;
+            written += count;
+        } else if (control != -128) {
+            const size_t count = static_cast<size_t>(1 - control);
+            if (in >= size || written + count > outSize) return false;
+            std::memset(out + written, data[in++], count);
+            written += count;
+        }
+    }
+    return written == outSize;
+}
+
+} // namespace
+
+void packMaskRow(const uchar* mask, int width, uchar* bits)
+{
+    int x = 0;
+#if CV_SIMD128
+    // Non-zero lanes become 0xFF; their sign bits are the 16 packed pixels, lane 0 lowest.
+    const cv::v_uint8x16 zero = cv::v_setzero_u8();
+    for (; x <= width - 16; x += 16) {
+        const int packed = cv::v_signmask(cv::v_load(mask + x) != zero);
+        bits[x / 8] = static_cast<uchar>(packed);
+        bits[x / 8 + 1] = static_cast<uchar>(packed >> 8);
+    }
+#endif
+    for (; x < width; x += 8) {
+        const int count = std::min(8, width - x);
+        uchar byte = 0;
+        for (int i = 0; i < count; ++i) byte |= static_cast<uchar>((mask[x + i] != 0) << i);
+        bits[x / 8] = byte;
+    }
+}
+
+void unpackMaskRow(const uchar* bits, int width, uchar* mask)
+{
+    const auto& table = expansionTable();
+    const int fullBytes = width / 8;
+    for (int i = 0; i < fullBytes; ++i) std::memcpy(mask + 8 * i, table[bits[i]].data(), 8);
+    const int tail = width - 8 * fullBytes;
+    if (tail > 0) std::memcpy(mask + 8 * fullBytes, table[bits[fullBytes]].data(), static_cast<size_t>(tail));
+}
+
+void encodeMaskBlocks(const cv::Mat& mask, std::string& out)
+{
+    CV_Assert(mask.type() == CV_8UC1);
+    const int stride = (mask.cols + 7) / 8;
+    const int blocks = (mask.rows + kMaskRowsPerBlock - 1) / kMaskRowsPerBlock;
+    // Padding bits of a row's last byte are always clear.
+    const uchar lastByteFull = static_cast<uchar>(mask.cols % 8 == 0 ? 0xFF : (1 << (mask.cols % 8)) - 1);
+
+    thread_local std::vector<uchar> packed;
+    thread_local std::vector<uchar> runLength;
+    packed.resize(static_cast<size_t>(stride) * kMaskRowsPerBlock);
+
+    size_t descriptor = out.size();
+    out.append(static_cast<size_t>(blocks) * sizeof(quint32), '\0');
+
+    for (int block = 0; block < blocks; ++block) {
+        const int firstRow = block * kMaskRowsPerBlock;
+        const int rows = std::min(kMaskRowsPerBlock, mask.rows - firstRow);
+        const size_t bytes = static_cast<size_t>(rows) * stride;
+
+        bool allClear = true;
+        bool allSet = true;
+        for (int row = 0; row < rows; ++row) {
+            uchar* rowBits = packed.data() + static_cast<size_t>(row) * stride;
+            packMaskRow(mask.ptr<uchar>(firstRow + row), mask.cols, rowBits);
+            uchar any = 0;
+            uchar every = 0xFF;
+            for (int i = 0; i < stride - 1; ++i) {
+                any |= rowBits[i];
+                every &= rowBits[i];
+            }
+            any |= rowBits[stride - 1];
+            allClear = allClear && any == 0;
+            allSet = allSet && every == 0xFF && rowBits[stride - 1] == lastByteFull;
+        }
+
+        quint32 encoding = kBlockRaw;
+        const uchar* payload = packed.data();
+        size_t payloadBytes = bytes;
+        if (allClear) {
+            encoding = kBlockZero;
+            payloadBytes = 0;
+        } else if (allSet) {
+            encoding = kBlockOnes;
+            payloadBytes = 0;
+        } else {
+            packBitsEncode(packed.data(), bytes, runLength);
+            if (runLength.size() < bytes) {
+                encoding = kBlockPackBits;
+                payload = runLength.data();
+                payloadBytes = runLength.size();
+            }
+        }
+
+        storeLittleEndian(out, descriptor, static_cast<quint32>(payloadBytes << 2) | encoding);
+        descriptor += sizeof(quint32);
+        out.append(reinterpret_cast<const char*>(payload), payloadBytes);
+    }
+}
+
+bool decodeMaskBlocks(const uchar* data, size_t size, const cv::Size& maskSize, cv::Mat& mask)
+{
+    const int stride = (maskSize.width + 7) / 8;
+    const int blocks = (maskSize.height + kMaskRowsPerBlock - 1) / kMaskRowsPerBlock;
+    const size_t descriptorBytes = static_cast<size_t>(blocks) * sizeof(quint32);
+    if (maskSize.width <= 0 || maskSize.height <= 0 || size < descriptorBytes) return false;
+
+    thread_local std::vector<uchar> packed;
+    packed.resize(static_cast<size_t>(stride) * kMaskRowsPerBlock);
+    mask.create(maskSize, CV_8UC1);
+
+    const uchar* payload = data + descriptorBytes;
+    const uchar* end = data + size;
+    for (int block = 0; block < blocks; ++block) {
+        const quint32 descriptor = loadLittleEndian<quint32>(data + block * sizeof(quint32));
+        const quint32 encoding = descriptor & 3;
+        const size_t payloadBytes = descriptor >> 2;
+        if (payloadBytes > static_cast<size_t>(end - payload)) return false;
+
+        const int firstRow = block * kMaskRowsPerBlock;
+        const int rows = std::min(kMaskRowsPerBlock, maskSize.height - firstRow);
+        const size_t bytes = static_cast<size_t>(rows) * stride;
+        cv::Mat blockRows = mask.rowRange(firstRow, firstRow + rows);
+
+        const uchar* bits = payload;
+        switch (encoding) {
+        case kBlockZero:
+            blockRows.setTo(0);
+            break;
+        case kBlockOnes:
+            blockRows.setTo(255);
+            break;
+        case kBlockPackBits:
+            if (!packBitsDecode(payload, payloadBytes, packed.data(), bytes)) return false;
+            bits = packed.data();
+            [[fallthrough]];
+        case kBlockRaw:
+            if (encoding == kBlockRaw && payloadBytes != bytes) return false;
+            for (int row = 0; row < rows; ++row) {
+                unpackMaskRow(bits + static_cast<size_t>(row) * stride, maskSize.width, blockRows.ptr<uchar>(row));
+            }
+            break;
+        }
+        payload += payloadBytes;
+    }
+    return true;
+}
+
+// --- MaskArchiveWriter ---
+
+MaskArchiveWriter::~MaskArchiveWriter()
+{
+    close();
+}
+
+bool MaskArchiveWriter::open(const QString& path)
+{
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to open mask archive:" << path;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.assign(kFileMagic, sizeof(kFileMagic));
+    appendLittleEndian<quint32>(m_pending, kFileVersion);
+    appendLittleEndian<quint32>(m_pending, kMaskRowsPerBlock);
+    m_fileSize = m_pending.size();
+    m_index.clear();
+    m_failed = false;
+    m_open = true;
+    m_closing = false;
+    m_thread = std::thread([this] { writerLoop(); });
+    return true;
+}
+
+bool MaskArchiveWriter::isOpen() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_open;
+}
+
+quint64 MaskArchiveWriter::framesWritten() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_index.size();
+}
+
+quint64 MaskArchiveWriter::bytesWritten() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_fileSize;
+}
+
+size_t MaskArchiveWriter::beginRecord(qint64 frameIndex, const cv::Size& maskSize)
+{
+    const size_t start = m_pending.size();
+    m_pending.append(kRecordTag, sizeof(kRecordTag));
+    appendLittleEndian<quint32>(m_pending, 0); // Record size, patched by endRecord()
+    appendLittleEndian<qint64>(m_pending, frameIndex);
+    appendLittleEndian<quint32>(m_pending, static_cast<quint32>(maskSize.width));
+    appendLittleEndian<quint32>(m_pending, static_cast<quint32>(maskSize.height));
+    return start;
+}
+
+bool MaskArchiveWriter::endRecord(size_t start, qint64 frameIndex)
+{
+    const quint32 size = static_cast<quint32>(m_pending.size() - start);
+    storeLittleEndian(m_pending, start + sizeof(kRecordTag), size);
+    m_index.push_back({frameIndex, m_fileSize, size});
+    m_fileSize += size;
+    return m_pending.size() >= kFlushBytes;
+}
+
+void MaskArchiveWriter::append(qint64 frameIndex, const cv::Mat& mask)
+{
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_open || m_failed.load(std::memory_order_relaxed)) return;
+        const size_t start = beginRecord(frameIndex, mask.empty() ? cv::Size() : mask.size());
+        if (!mask.empty()) encodeMaskBlocks(mask, m_pending);
+        wake = endRecord(start, frameIndex);
+    }
+    if (wake) m_wake.notify_one();
+}
+
+void MaskArchiveWriter::appendEncoded(qint64 frameIndex, const cv::Size& maskSize, const std::string& blocks)
+{
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_open || m_failed.load(std::memory_order_relaxed)) return;
+        const size_t start = beginRecord(frameIndex, maskSize);
+        m_pending.append(blocks);
+        wake = endRecord(start, frameIndex);
+    }
+    if (wake) m_wake.notify_one();
+}
+
+bool MaskArchiveWriter::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_open) return !m_failed.load();
+
+        const quint64 indexOffset = m_fileSize;
+        for (const IndexEntry& entry : m_index) {
+            appendLittleEndian<qint64>(m_pending, entry.frameIndex);
+            appendLittleEndian<quint64>(m_pending, entry.offset);
+            appendLittleEndian<quint32>(m_pending, entry.size);
+            appendLittleEndian<quint32>(m_pending, 0);
+        }
+        appendLittleEndian<quint64>(m_pending, indexOffset);
+        appendLittleEndian<quint32>(m_pending, static_cast<quint32>(m_index.size()));
+        m_pending.append(kIndexTag, sizeof(kIndexTag));
+        m_fileSize += m_index.size() * kIndexEntryBytes + kFooterBytes;
+
+        m_open = false;
+        m_closing = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    m_file.close();
+    if (!m_failed.load() && m_file.error() != QFileDevice::NoError) {
+        qWarning() << "Mask archive close failed:" << m_file.errorString();
+        m_failed = true;
+    }
+    if (m_failed.load()) {
+        qWarning() << "Mask archive" << m_file.fileName() << "is incomplete: writing failed.";
+        return false;
+    }
+    return true;
+}
+
+void MaskArchiveWriter::writerLoop()
+{
+    std::string writing;
+    bool closing = false;
+    while (!closing) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(kFlushIntervalMs),
+                            [this] { return m_closing || m_pending.size() >= kFlushBytes; });
+            closing = m_closing;
+            writing.swap(m_pending);
+        }
+        if (!writing.empty() && !m_failed.load(std::memory_order_relaxed)) {
+            // A short write leaves a gap that the index would point past, so the rest is dropped.
+            const qint64 size = static_cast<qint64>(writing.size());
+            if (m_file.write(writing.data(), size) != size) {
+                qWarning() << "Mask archive write failed:" << m_file.errorString();
+                m_failed = true;
+            } else if (!m_file.flush()) {
+                qWarning() << "Mask archive flush failed:" << m_file.errorString();
+                m_failed = true;
+            }
+        }
+        writing.clear();
+    }
+}
+
+// --- MaskArchiveReader ---
+
+MaskArchiveReader::~MaskArchiveReader()
+{
+    close();
+}
+
+bool MaskArchiveReader::open(const QString& path)
+{
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open mask archive:" << path;
+        return false;
+    }
+    m_size = static_cast<quint64>(m_file.size());
+    if (m_size >= kFileHeaderBytes) m_data = m_file.map(0, static_cast<qint64>(m_size));
+    if (!m_data || std::memcmp(m_data, kFileMagic, sizeof(kFileMagic)) != 0
+        || loadLittleEndian<quint32>(m_data + 8) != kFileVersion
+        || loadLittleEndian<quint32>(m_data + 12) != static_cast<quint32>(kMaskRowsPerBlock)) {
+        qWarning() << "Not a mask archive:" << path;
+        close();
+        return false;
+    }
+
+    if (!loadIndex()) {
+        qWarning() << "Mask archive has no index (recording interrupted?), scanning records:" << path;
+        scanRecords();
+    }
+
+    m_byFrame.reserve(m_records.size());
+    for (size_t i = 0; i < m_records.size(); ++i) m_byFrame.emplace_back(m_records[i].frameIndex, i);
+    std::sort(m_byFrame.begin(), m_byFrame.end());
+    qInfo() << "Opened mask archive" << path << "with" << m_records.size() << "frames";
+    return true;
+}
+
+void MaskArchiveReader::close()
+{
+    if (m_data) m_file.unmap(const_cast<uchar*>(m_data));
+    m_data = nullptr;
+    m_size = 0;
+    m_file.close();
+    m_records.clear();
+    m_byFrame.clear();
+}
+
+bool MaskArchiveReader::loadIndex()
+{
+    if (m_size < kFileHeaderBytes + kFooterBytes) return false;
+    const uchar* footer = m_data + m_size - kFooterBytes;
+    if (std::memcmp(footer + 12, kIndexTag, sizeof(kIndexTag)) != 0) return false;
+
+    const quint64 indexOffset = loadLittleEndian<quint64>(footer);
+    const quint64 count = loadLittleEndian<quint32>(footer + 8);
+    if (indexOffset < kFileHeaderBytes || indexOffset + count * kIndexEntryBytes != m_size - kFooterBytes) return false;
+
+    m_records.reserve(count);
+    for (quint64 i = 0; i < count; ++i) {
+        const uchar* entry = m_data + indexOffset + i * kIndexEntryBytes;
+        Record record;
+        record.frameIndex = loadLittleEndian<qint64>(entry);
+        record.offset = loadLittleEndian<quint64>(entry + 8);
+        record.size = loadLittleEndian<quint32>(entry + 16);
+        if (record.offset < kFileHeaderBytes || record.size < kRecordHeaderBytes
+            || record.offset + record.size > indexOffset) {
+            m_records.clear();
+            return false;
+        }
+        m_records.push_back(record);
+    }
+    return true;
+}
+
+bool MaskArchiveReader::scanRecords()
+{
+    m_records.clear();
+    quint64 offset = kFileHeaderBytes;
+    while (offset + kRecordHeaderBytes <= m_size) {
+        const uchar* header = m_data + offset;
+        if (std::memcmp(header, kRecordTag, sizeof(kRecordTag)) != 0) break;
+        const quint32 size = loadLittleEndian<quint32>(header + 4);
+        if (size < kRecordHeaderBytes || offset + size > m_size) break; // Truncated last record
+        m_records.push_back({loadLittleEndian<qint64>(header + 8), offset, size});
+        offset += size;
+    }
+    return !m_records.empty();
+}
+
+qint64 MaskArchiveReader::lastFrameIndex() const
+{
+    return m_byFrame.empty() ? -1 : m_byFrame.back().first;
+}
+
+bool MaskArchiveReader::readFrame(qint64 frameIndex, cv::Mat& mask) const
+{
+    // Last entry for frameIndex: records of one frame are sorted by record number.
+    auto it = std::upper_bound(m_byFrame.begin(), m_byFrame.end(),
+                               std::make_pair(frameIndex, std::numeric_limits<size_t>::max()));
+    if (it == m_byFrame.begin() || (--it)->first != frameIndex) return false;
+    return readRecord(it->second, mask);
+}
+
+bool MaskArchiveReader::readRecord(size_t record, cv::Mat& mask) const
+{
+    if (!m_data || record >= m_records.size()) return false;
+    const Record& entry = m_records[record];
+    const uchar* data = m_data + entry.offset;
+    if (std::memcmp(data, kRecordTag, sizeof(kRecordTag)) != 0) return false;
+
+    const cv::Size size(static_cast<int>(loadLittleEndian<quint32>(data + 16)),
+                        static_cast<int>(loadLittleEndian<quint32>(data + 20)));
+    if (size.area() == 0) {
+        mask.release();
+        return true;
+    }
+    if (!decodeMaskBlocks(data + kRecordHeaderBytes, entry.size - kRecordHeaderBytes, size, mask)) {
+        qWarning() << "Corrupt mask record for frame" << entry.frameIndex;
+        mask.release();
+        return false;
+    }
+    return true;
+}
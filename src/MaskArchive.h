@@ -0,0 +1,150 @@
+#ifndef MASKARCHIVE_H
+#define MASKARCHIVE_H
+
+#include <QFile>
+#include <QString>
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Compact storage for long runs of binary motion masks (.motmask).
+//
+// Masks are stored at 1 bit per pixel: each row is packed into (width + 7) / 8 bytes,
+// least significant bit first, so bit i of byte k is pixel 8 * k + i. Rows are grouped
+// into blocks of kMaskRowsPerBlock, and each block is stored as whichever of these is
+// smallest: nothing (all clear), nothing (all set), PackBits run-length code, or raw
+// bits. Still scenes therefore cost a few bytes per frame.
+//
+// File layout (little-endian):
+//   header   "MOTMASK\0", u32 version, u32 rows per block
+//   records  u32 "MFRM", u32 record bytes, i64 frame index, u32 width, u32 height,
+//            u32 block descriptor per block ((payload bytes << 2) | encoding), payloads
+//   index    per record: i64 frame index, u64 file offset, u32 record bytes, u32 0
+//   footer   u64 index offset, u32 record count, u32 "MIDX"
+// A 0x0 record is a frame without a mask (no history yet). A file whose footer is
+// missing (recording was killed) is recovered by scanning the records.
+
+constexpr int kMaskRowsPerBlock = 16;
+
+// Bit-packs one row of a CV_8UC1 mask (any non-zero pixel counts as set) and back
+// (to 0/255). Packing is vectorised; unpacking expands a byte per table lookup.
+void packMaskRow(const uchar* mask, int width, uchar* bits);
+void unpackMaskRow(const uchar* bits, int width, uchar* mask);
+
+// Appends the block descriptors and payloads of mask to out.
+void encodeMaskBlocks(const cv::Mat& mask, std::string& out);
+// Decodes what encodeMaskBlocks() wrote for a mask of the given size into mask
+// (CV_8UC1, 0/255). Returns false if the data is inconsistent.
+bool decodeMaskBlocks(const uchar* data, size_t size, const cv::Size& maskSize, cv::Mat& mask);
+
+// Appends masks to a .motmask file. append() encodes on the calling thread (the
+// encoding is a small fraction of the analysis cost) and a writer thread writes the
+// bytes, as MotionStatsWriter does. append() and close() are thread-safe.
+//
+// Once a write or flush fails, later frames are discarded and close() returns false:
+// the file is then incomplete and must not be taken for a full recording.
+class MaskArchiveWriter
+{
+public:
+    MaskArchiveWriter() = default;
+    ~MaskArchiveWriter();
+
+    MaskArchiveWriter(const MaskArchiveWriter&) = delete;
+    MaskArchiveWriter& operator=(const MaskArchiveWriter&) = delete;
+
+    bool open(const QString& path);
+    // An empty mask is stored as a frame without mask.
+    void append(qint64 frameIndex, const cv::Mat& mask);
+    // As append(), for a mask already encoded with encodeMaskBlocks() (e.g. on another
+    // thread). An empty maskSize stores a frame without mask.
+    void appendEncoded(qint64 frameIndex, const cv::Size& maskSize, const std::string& blocks);
+    // Writes the index and footer and stops the writer thread. Returns false if any
+    // write failed (also when called again after that).
+    bool close();
+
+    bool isOpen() const;
+    bool hasFailed() const { return m_failed.load(std::memory_order_relaxed); }
+    QString path() const { return m_file.fileName(); }
+    quint64 framesWritten() const;
+    quint64 bytesWritten() const;
+
+private:
+    struct IndexEntry
+    {
+        qint64 frameIndex;
+        quint64 offset;
+        quint32 size;
+    };
+
+    static constexpr size_t kFlushBytes = 256 * 1024;
+    static constexpr int kFlushIntervalMs = 500;
+
+    void writerLoop();
+    // Under m_mutex: starts a record in m_pending, returning its offset there, and
+    // finishes it once the payload is appended (true if a flush is due).
+    size_t beginRecord(qint64 frameIndex, const cv::Size& maskSize);
+    bool endRecord(size_t start, qint64 frameIndex);
+
+    QFile m_file; // Writer thread only while open
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::string m_pending;          // Guarded by m_mutex
+    std::vector<IndexEntry> m_index; // Guarded by m_mutex
+    quint64 m_fileSize = 0;         // Bytes appended so far, including m_pending
+    bool m_open = false;
+    bool m_closing = false;
+    std::thread m_thread;
+    std::atomic<bool> m_failed{false};
+};
+
+// Random access to the masks of a .motmask file. The file is memory-mapped and only
+// the requested frame is decoded, so archives far larger than RAM can be browsed.
+// Not thread-safe.
+class MaskArchiveReader
+{
+public:
+    MaskArchiveReader() = default;
+    ~MaskArchiveReader();
+
+    MaskArchiveReader(const MaskArchiveReader&) = delete;
+    MaskArchiveReader& operator=(const MaskArchiveReader&) = delete;
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+
+    // Records in file order.
+    size_t recordCount() const { return m_records.size(); }
+    qint64 frameIndexAt(size_t record) const { return m_records[record].frameIndex; }
+    qint64 lastFrameIndex() const;
+
+    // Decodes the mask stored for frameIndex (the latest record if it was stored more
+    // than once). Returns false if the frame is not in the archive; mask is left empty
+    // for frames stored without a mask.
+    bool readFrame(qint64 frameIndex, cv::Mat& mask) const;
+    bool readRecord(size_t record, cv::Mat& mask) const;
+
+private:
+    struct Record
+    {
+        qint64 frameIndex;
+        quint64 offset;
+        quint32 size;
+    };
+
+    bool loadIndex();
+    bool scanRecords();
+
+    QFile m_file;
+    const uchar* m_data = nullptr;
+    quint64 m_size = 0;
+    std::vector<Record> m_records;
+    std::vector<std::pair<qint64, size_t>> m_byFrame; // Sorted (frame index, record)
+};
+
+#endif // MASKARCHIVE_H
@@ -0,0 +1,310 @@
+#include "MosaicController.h"
+#include "MotionDetector.h"
+#include "PlaybackClock.h"
+#include "Profiler.h"
+#include "VideoProcessor.h"
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+// As in VideoProcessor::waitForPresentation(): beyond this lag a stream re-anchors its
+// clock instead of skipping frames to catch up.
+constexpr auto kMaxCatchUp = std::chrono::milliseconds(500);
+// Share of the tint colour in moving pixels, as in the overlay export.
+constexpr double kTintWeight = 0.5;
+
+} // namespace
+
+struct MosaicController::Stream
+{
+    int id = -1;
+    QString path;
+    cv::VideoCapture capture;
+    std::unique_ptr<MotionDetector> detector;
+    PlaybackClock clock;
+    qint64 nextFrame = 0;
+    quint64 epoch = 0;
+
+    // Reused per frame; only the step task in flight touches them.
+    cv::Mat frame;
+    cv::Mat analysis;
+    cv::Mat mask;
+    cv::Mat tileColor;
+    cv::Mat tileMask;
+    cv::Mat tileTint;
+    cv::Mat tile; // The tile published before last, unless the display still holds it
+};
+
+MosaicController::MosaicController(QObject *parent)
+    : QObject(parent)
+{
+}
+
+MosaicController::~MosaicController()
+{
+    stop();
+}
+
+int MosaicController::start(const QStringList& paths, int poolThreads)
+{
+    stop();
+
+    for (const QString& path : paths) {
+        if (static_cast<int>(m_streams.size()) == kMaxStreams) {
+            qWarning() << "Mosaic: at most" << kMaxStreams << "streams; ignoring the rest.";
+            break;
+        }
+        auto stream = std::make_unique<Stream>();
+        stream->id = static_cast<int>(m_streams.size());
+        stream->path = path;
+        m_streams.push_back(std::move(stream));
+    }
+    if (m_streams.empty()) return 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_tileMutex);
+        m_tiles.assign(m_streams.size(), MosaicTile());
+        m_tileChanged.assign(m_streams.size(), 0);
+    }
+    m_streamsOpened = 0;
+    m_streamsFailed = 0;
+    m_framesAnalyzed = 0;
+    m_framesLate = 0;
+    m_tilesPublished = 0;
+    m_paused = false;
+    m_pool = std::make_unique<TaskPool>(poolThreads);
+    {
+        std::lock_guard<std::mutex> lock(m_pacerMutex);
+        m_stopping = false;
+    }
+    m_pacer = std::thread([this] { pacerLoop(); });
+    // Each stream enters the pacer's queue once its open task has succeeded.
+    for (const auto& stream : m_streams) {
+        Stream* opening = stream.get();
+        m_pool->submit([this, opening] { open(*opening); });
+    }
+
+    qInfo() << "Mosaic: opening" << m_streams.size() << "streams on" << m_pool->threadCount() << "pool threads";
+    return static_cast<int>(m_streams.size());
+}
+
+void MosaicController::stop()
+{
+    if (m_pacer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_pacerMutex);
+            m_stopping = true;
+            m_due = {};
+        }
+        m_pacerWake.notify_one();
+        m_pacer.join();
+
+        // Waits for the steps in flight; they find the pacer stopped and do not reschedule.
+        const MosaicStats totals = stats();
+        m_pool.reset();
+        qInfo() << "Mosaic: analysed" << totals.framesAnalyzed << "frames of" << totals.streams << "streams,"
+                << totals.framesLate << "late," << totals.steals << "steals";
+    }
+    m_streams.clear();
+}
+
+void MosaicController::setPaused(bool paused)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_pacerMutex);
+        if (paused == m_paused.load()) return;
+        m_paused = paused;
+        if (!paused) {
+            // Every waiting stream continues right away from where it stopped.
+            m_epoch.fetch_add(1);
+            std::vector<int> waiting;
+            for (; !m_due.empty(); m_due.pop()) waiting.push_back(m_due.top().stream);
+            const Clock::time_point now = Clock::now();
+            for (int stream : waiting) m_due.push({now, stream});
+        }
+    }
+    m_pacerWake.notify_one();
+}
+
+void MosaicController::setFrameDelta(int delta)
+{
+    m_frameDelta = std::clamp(delta, 1, VideoProcessor::kMaxFrameDelta);
+}
+
+void MosaicController::setMotionThreshold(int threshold)
+{
+    m_motionThreshold = std::clamp(threshold, 0, 255);
+}
+
+void MosaicController::setTileSize(int width, int height)
+{
+    m_tileWidth = std::max(1, width);
+    m_tileHeight = std::max(1, height);
+}
+
+QString MosaicController::streamPath(int stream) const
+{
+    return m_streams.at(static_cast<size_t>(stream))->path;
+}
+
+void MosaicController::takeChangedTiles(std::vector<MosaicTile>& tiles)
+{
+    // Clear the flag before taking so a tile published after this point wakes us again.
+    m_wakePending.store(false);
+    std::lock_guard<std::mutex> lock(m_tileMutex);
+    for (size_t i = 0; i < m_tiles.size(); ++i) {
+        if (!m_tileChanged[i]) continue;
+        tiles.push_back(m_tiles[i]);
+        m_tileChanged[i] = 0;
+    }
+}
+
+MosaicStats MosaicController::stats() const
+{
+    MosaicStats stats;
+    stats.streams = m_streamsOpened.load(std::memory_order_relaxed);
+    stats.streamsFailed = m_streamsFailed.load(std::memory_order_relaxed);
+    stats.poolThreads = m_pool ? m_pool->threadCount() : 0;
+    stats.framesAnalyzed = m_framesAnalyzed.load(std::memory_order_relaxed);
+    stats.framesLate = m_framesLate.load(std::memory_order_relaxed);
+    stats.tilesPublished = m_tilesPublished.load(std::memory_order_relaxed);
+    stats.steals = m_pool ? m_pool->steals() : 0;
+    return stats;
+}
+
+void MosaicController::schedule(int stream, Clock::time_point deadline)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_pacerMutex);
+        if (m_stopping) return;
+        m_due.push({deadline, stream});
+    }
+    m_pacerWake.notify_one();
+}
+
+void MosaicController::pacerLoop()
+{
+    Profiler::setThreadName("mosaic-pacer");
+    std::unique_lock<std::mutex> lock(m_pacerMutex);
+    while (!m_stopping) {
+        if (m_due.empty() || m_paused.load()) {
+            m_pacerWake.wait(lock);
+            continue;
+        }
+        const Due next = m_due.top();
+        if (Clock::now() < next.deadline) {
+            m_pacerWake.wait_until(lock, next.deadline);
+            continue;
+        }
+        m_due.pop();
+        Stream* stream = m_streams[static_cast<size_t>(next.stream)].get();
+        m_pool->submit([this, stream] { step(*stream); });
+    }
+}
+
+void MosaicController::open(Stream& stream)
+{
+    std::vector<int> captureParams;
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 7)
+    // One decoder thread per stream: the pool, not FFmpeg, spreads streams over cores.
+    captureParams = {cv::CAP_PROP_N_THREADS, 1};
+#endif
+    if (!stream.capture.open(stream.path.toStdString(), cv::CAP_ANY, captureParams)) {
+        qWarning() << "Mosaic: failed to open" << stream.path;
+        m_streamsFailed.fetch_add(1, std::memory_order_relaxed);
+        emit streamOpened(stream.id, false);
+        return;
+    }
+    double fps = stream.capture.get(cv::CAP_PROP_FPS);
+    if (fps <= 0) fps = 30.0;
+    stream.detector = createMotionDetector(MotionAlgorithm::FrameDifference, VideoProcessor::kMaxFrameDelta);
+    stream.clock.start(fps, 1.0, 0);
+    stream.epoch = m_epoch.load();
+    m_streamsOpened.fetch_add(1, std::memory_order_relaxed);
+    emit streamOpened(stream.id, true);
+    schedule(stream.id, Clock::now());
+}
+
+void MosaicController::step(Stream& stream)
+{
+    const quint64 epoch = m_epoch.load();
+    if (epoch != stream.epoch) {
+        stream.clock.rebase(stream.nextFrame); // Resumed after a pause
+        stream.epoch = epoch;
+    }
+
+    {
+        ProfileScope scope(ProfileStage::Decode);
+        if (!stream.capture.read(stream.frame) || stream.frame.empty()) {
+            // End of the recording: loop with fresh history.
+            stream.capture.set(cv::CAP_PROP_POS_FRAMES, 0);
+            stream.detector->reset();
+            stream.nextFrame = 0;
+            stream.clock.rebase(0);
+            if (!stream.capture.read(stream.frame) || stream.frame.empty()) {
+                qWarning() << "Mosaic: stream stopped, no frames readable:" << stream.path;
+                return; // Not rescheduled
+            }
+        }
+    }
+    const qint64 frameIndex = stream.nextFrame++;
+
+    double motionRatio = 0.0;
+    {
+        ProfileScope scope(ProfileStage::Motion);
+        const int width = std::min(kAnalysisWidth, stream.frame.cols);
+        const cv::Size analysisSize(width, std::max(1, stream.frame.rows * width / stream.frame.cols));
+        cv::resize(stream.frame, stream.analysis, analysisSize, 0, 0, cv::INTER_AREA);
+        MotionParams params;
+        params.frameDelta = m_frameDelta.load();
+        params.threshold = m_motionThreshold.load();
+        stream.detector->detect(stream.analysis, params, stream.mask);
+        if (!stream.mask.empty()) motionRatio = static_cast<double>(cv::countNonZero(stream.mask)) / stream.mask.total();
+    }
+    m_framesAnalyzed.fetch_add(1, std::memory_order_relaxed);
+
+    // Late frames are analysed (the history must stay intact) but not shown.
+    const Clock::time_point deadline = stream.clock.deadline(frameIndex);
+    const Clock::time_point now = Clock::now();
+    if (now > deadline + stream.clock.framePeriod()) {
+        m_framesLate.fetch_add(1, std::memory_order_relaxed);
+        if (now - deadline >= kMaxCatchUp) stream.clock.rebase(stream.nextFrame);
+    } else {
+        publish(stream, frameIndex, motionRatio);
+    }
+    schedule(stream.id, stream.clock.deadline(stream.nextFrame));
+}
+
+void MosaicController::publish(Stream& stream, qint64 frameIndex, double motionRatio)
+{
+    ProfileScope scope(ProfileStage::DisplayPrepare);
+    const cv::Size tileSize(m_tileWidth.load(), m_tileHeight.load());
+    cv::resize(stream.frame, stream.tileColor, tileSize, 0, 0, cv::INTER_AREA);
+    if (stream.tileColor.channels() == 1) {
+        cv::cvtColor(stream.tileColor, stream.tileTint, cv::COLOR_GRAY2BGR);
+        std::swap(stream.tileColor, stream.tileTint);
+    }
+    if (!stream.mask.empty()) {
+        cv::resize(stream.mask, stream.tileMask, tileSize, 0, 0, cv::INTER_NEAREST);
+        stream.tileTint = stream.tileColor * (1.0 - kTintWeight) + cv::Scalar(0, 0, 255 * kTintWeight);
+        stream.tileTint.copyTo(stream.tileColor, stream.tileMask);
+    }
+
+    // Double-buffered with m_tiles: stream.tile is the buffer published before last.
+    // If the display still holds it, detach so a fresh one is allocated.
+    if (stream.tile.u && stream.tile.u->refcount > 1) stream.tile.release();
+    cv::cvtColor(stream.tileColor, stream.tile, cv::COLOR_BGR2BGRA);
+
+    {
+        std::lock_guard<std::mutex> lock(m_tileMutex);
+        MosaicTile& tile = m_tiles[static_cast<size_t>(stream.id)];
+        std::swap(tile.image, stream.tile);
+        tile.stream = stream.id;
+        tile.frameIndex = frameIndex;
+        tile.motionRatio = motionRatio;
+        m_tileChanged[static_cast<size_t>(stream.id)] = 1;
+    }
+    m_tilesPublished.fetch_add(1, std::memory_order_relaxed);
+    if (!m_wakePending.exchange(true)) emit tilesAvailable();
+}
@@ -0,0 +1,148 @@
+#ifndef MOSAICCONTROLLER_H
+#define MOSAICCONTROLLER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "TaskPool.h"
+
+// Latest picture of one stream of the mosaic.
+struct MosaicTile
+{
+    int stream = -1;
+    cv::Mat image;          // CV_8UC4 BGRA at the tile size, moving pixels tinted red
+    qint64 frameIndex = -1;
+    double motionRatio = 0.0;
+};
+
+// Snapshot of the mosaic counters.
+struct MosaicStats
+{
+    int streams = 0;            // Opened and playing
+    int streamsFailed = 0;      // Could not be opened
+    int poolThreads = 0;
+    quint64 framesAnalyzed = 0;
+    quint64 framesLate = 0;     // Analysed but not shown because the stream was behind
+    quint64 tilesPublished = 0;
+    quint64 steals = 0;         // Pool tasks run by a worker other than the one queued on
+};
+
+// Plays many recordings at once for a monitoring wall, without a thread per stream.
+//
+// Each stream is a chain of small tasks on one shared, fixed-size TaskPool: a task
+// decodes one frame, runs frame differencing on it and, if the stream is on time,
+// publishes a tile; then the stream is handed back to a single pacer thread, which
+// resubmits it when its next frame is due on the stream's own PlaybackClock. The pacer
+// dispatches earliest deadline first, so no stream can starve the others, and a stream
+// is never in the pool twice. Motion is computed at kAnalysisWidth and tiles are made
+// at the tile size, so the per-stream cost does not depend on the source resolution
+// (beyond decoding) or on how many streams share the pool. Captures decode with a
+// single thread each; the pool provides the parallelism. Recordings loop at their end.
+// Opening a capture is a pool task too, so start() never waits on a slow file and each
+// stream begins playing as soon as its own capture is ready.
+class MosaicController : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int kMaxStreams = 64;
+    // Width that frames are downscaled to for motion analysis.
+    static constexpr int kAnalysisWidth = 320;
+
+    explicit MosaicController(QObject *parent = nullptr);
+    ~MosaicController() override;
+
+    MosaicController(const MosaicController&) = delete;
+    MosaicController& operator=(const MosaicController&) = delete;
+
+    // Queues the files for opening on a pool of poolThreads (0 = one per core) and returns
+    // the number of streams (at most kMaxStreams) without waiting. Each stream reports
+    // streamOpened() and, if it opened, starts playing; unreadable files are skipped with
+    // a warning.
+    int start(const QStringList& paths, int poolThreads = 0);
+    void stop();
+
+    void setPaused(bool paused);
+    bool isPaused() const { return m_paused.load(); }
+
+    // Thread-safe; read by every stream step.
+    void setFrameDelta(int delta);
+    void setMotionThreshold(int threshold);
+    // Size of one tile in device pixels; tiles are made at exactly this size.
+    void setTileSize(int width, int height);
+
+    int streamCount() const { return static_cast<int>(m_streams.size()); }
+    QString streamPath(int stream) const;
+
+    // Display consumer (GUI thread) only: appends the tiles that changed since the last
+    // call, one per stream at most. Call it in response to tilesAvailable().
+    void takeChangedTiles(std::vector<MosaicTile>& tiles);
+
+    MosaicStats stats() const;
+
+signals:
+    // Emitted from a pool thread when tiles changed and no wake-up is pending.
+    void tilesAvailable();
+    // Emitted from a pool thread once a stream's capture was opened (or failed to open);
+    // its first tile is published after this.
+    void streamOpened(int stream, bool opened);
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Stream;
+
+    struct Due
+    {
+        Clock::time_point deadline;
+        int stream;
+        bool operator>(const Due& other) const { return deadline > other.deadline; }
+    };
+
+    void open(Stream& stream);
+    void step(Stream& stream);
+    void schedule(int stream, Clock::time_point deadline);
+    void pacerLoop();
+    void publish(Stream& stream, qint64 frameIndex, double motionRatio);
+
+    std::vector<std::unique_ptr<Stream>> m_streams; // Fixed between start() and stop()
+    std::unique_ptr<TaskPool> m_pool;
+
+    // Pacer: streams waiting for their next frame's deadline
+    std::thread m_pacer;
+    std::mutex m_pacerMutex;
+    std::condition_variable m_pacerWake;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> m_due; // Guarded by m_pacerMutex
+    bool m_stopping = false; // Guarded by m_pacerMutex
+
+    std::atomic<bool> m_paused{false};
+    // Bumped on resume; a stream that sees a new epoch re-anchors its clock.
+    std::atomic<quint64> m_epoch{0};
+    std::atomic<int> m_frameDelta{3};
+    std::atomic<int> m_motionThreshold{30};
+    std::atomic<int> m_tileWidth{320};
+    std::atomic<int> m_tileHeight{180};
+
+    // Stream steps -> display
+    std::mutex m_tileMutex;
+    std::vector<MosaicTile> m_tiles;  // Guarded by m_tileMutex, one per stream
+    std::vector<char> m_tileChanged;  // Guarded by m_tileMutex
+    std::atomic<bool> m_wakePending{false};
+
+    std::atomic<int> m_streamsOpened{0};
+    std::atomic<int> m_streamsFailed{0};
+    std::atomic<quint64> m_framesAnalyzed{0};
+    std::atomic<quint64> m_framesLate{0};
+    std::atomic<quint64> m_tilesPublished{0};
+};
+
+#endif // MOSAICCONTROLLER_H
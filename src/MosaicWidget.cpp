@@ -0,0 +1,103 @@
+#include "MosaicWidget.h"
+#include "Profiler.h"
+#include <QPaintEvent>
+#include <QPainter>
+#include <QResizeEvent>
+#include <algorithm>
+#include <cmath>
+
+MosaicWidget::MosaicWidget(QWidget *parent) : QWidget(parent)
+{
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    setMinimumSize(320, 240);
+    // Every pixel is painted by the cells and the background fill, so Qt need not erase first.
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void MosaicWidget::addStream(int stream, const QString& name)
+{
+    if (stream < 0) return;
+    if (stream >= static_cast<int>(m_cellOfStream.size())) m_cellOfStream.resize(static_cast<size_t>(stream) + 1, -1);
+    if (m_cellOfStream[static_cast<size_t>(stream)] >= 0) return;
+    m_cellOfStream[static_cast<size_t>(stream)] = static_cast<int>(m_cells.size());
+    Cell cell;
+    cell.stream = stream;
+    cell.name = name;
+    m_cells.push_back(std::move(cell));
+    // The layout may have changed, so every cell is repainted and tiles are remade.
+    emit tileSizeChanged(tileSize());
+    update();
+}
+
+int MosaicWidget::columns() const
+{
+    return std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(m_cells.size())))));
+}
+
+int MosaicWidget::rows() const
+{
+    return std::max(1, (static_cast<int>(m_cells.size()) + columns() - 1) / columns());
+}
+
+QRect MosaicWidget::cellRect(int index) const
+{
+    const int cellWidth = std::max(1, (width() - (columns() - 1) * kSpacing) / columns());
+    const int cellHeight = std::max(1, (height() - (rows() - 1) * kSpacing) / rows());
+    return QRect((index % columns()) * (cellWidth + kSpacing), (index / columns()) * (cellHeight + kSpacing),
+                 cellWidth, cellHeight);
+}
+
+QSize MosaicWidget::tileSize() const
+{
+    return cellRect(0).size() * devicePixelRatioF();
+}
+
+void MosaicWidget::updateTiles(const std::vector<MosaicTile>& tiles)
+{
+    for (const MosaicTile& tile : tiles) {
+        if (tile.stream < 0 || tile.stream >= static_cast<int>(m_cellOfStream.size()) || tile.image.empty()) continue;
+        const int index = m_cellOfStream[static_cast<size_t>(tile.stream)];
+        if (index < 0) continue;
+        Cell& cell = m_cells[static_cast<size_t>(index)];
+        // BGRA in memory is QImage::Format_RGB32 on little-endian, as in VideoDisplayWidget.
+        cell.image = tile.image;
+        cell.picture = QImage(cell.image.data, cell.image.cols, cell.image.rows, static_cast<int>(cell.image.step),
+                              QImage::Format_RGB32);
+        cell.picture.setDevicePixelRatio(devicePixelRatioF());
+        cell.motionRatio = tile.motionRatio;
+        update(cellRect(index));
+    }
+}
+
+void MosaicWidget::resizeEvent(QResizeEvent* event)
+{
+    QWidget::resizeEvent(event);
+    emit tileSizeChanged(tileSize());
+}
+
+void MosaicWidget::paintEvent(QPaintEvent* event)
+{
+    ProfileScope scope(ProfileStage::Paint);
+    QPainter painter(this);
+    painter.fillRect(event->rect(), Qt::black);
+
+    for (int i = 0; i < static_cast<int>(m_cells.size()); ++i) {
+        const QRect rect = cellRect(i);
+        if (!event->rect().intersects(rect)) continue;
+        const Cell& cell = m_cells[static_cast<size_t>(i)];
+        if (cell.picture.isNull()) {
+            painter.fillRect(rect, QColor(30, 30, 30));
+        } else {
+            // Tiles made at tileSize() cover the cell exactly and are blitted unscaled; a
+            // tile from before a resize is stretched until the next one arrives.
+            painter.drawImage(QRectF(rect), cell.picture);
+        }
+
+        const QString label = QString("%1  %2%").arg(cell.name).arg(cell.motionRatio * 100.0, 0, 'f', 1);
+        const QRect labelRect(rect.left(), rect.top(), rect.width(), painter.fontMetrics().height() + 4);
+        painter.fillRect(labelRect, QColor(0, 0, 0, 150));
+        painter.setPen(Qt::white);
+        painter.drawText(labelRect.adjusted(4, 0, -4, 0), Qt::AlignLeft | Qt::AlignVCenter,
+                         painter.fontMetrics().elidedText(label, Qt::ElideMiddle, labelRect.width() - 8));
+    }
+}
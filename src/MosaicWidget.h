@@ -0,0 +1,60 @@
+#ifndef MOSAICWIDGET_H
+#define MOSAICWIDGET_H
+
+#include <QWidget>
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+#include "MosaicController.h"
+
+// Grid of stream tiles (as square as possible). Tiles arrive as BGRA images at
+// tileSize() and are wrapped without copying; each update repaints only the tiles that
+// changed, so a wall of streams costs per changed tile rather than per window.
+class MosaicWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MosaicWidget(QWidget *parent = nullptr);
+
+    // Appends a cell for a stream that is ready to play (streams arrive in any order);
+    // the name labels its tile. The grid grows to fit.
+    void addStream(int stream, const QString& name);
+    // Size in device pixels at which tiles are drawn without scaling.
+    QSize tileSize() const;
+
+public slots:
+    void updateTiles(const std::vector<MosaicTile>& tiles);
+
+signals:
+    void tileSizeChanged(const QSize& size);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+
+private:
+    struct Cell
+    {
+        int stream = -1;
+        QString name;
+        cv::Mat image; // Keeps the pixels that picture points into alive
+        QImage picture;
+        double motionRatio = 0.0;
+    };
+
+    static constexpr int kSpacing = 2;
+
+    int columns() const;
+    int rows() const;
+    QRect cellRect(int index) const;
+
+    std::vector<Cell> m_cells;
+    std::vector<int> m_cellOfStream; // Cell index per stream id, -1 until added
+};
+
+#endif // MOSAICWIDGET_H
@@ -0,0 +1,109 @@
+#include "MosaicWindow.h"
+#include "MosaicWidget.h"
+
+#include <QAction>
+#include <QFileInfo>
+#include <QLabel>
+#include <QMessageBox>
+#include <QStatusBar>
+#include <QStyle>
+#include <QTimer>
+#include <QToolBar>
+#include <algorithm>
+
+MosaicWindow::MosaicWindow(const QStringList& paths, int frameDelta, int threshold, QWidget *parent)
+    : QMainWindow(parent)
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle("Motplayer Mosaic");
+    resize(1280, 760);
+
+    m_mosaicWidget = new MosaicWidget(this);
+    setCentralWidget(m_mosaicWidget);
+
+    m_pauseAction = new QAction(style()->standardIcon(QStyle::SP_MediaPause), "&Pause", this);
+    m_pauseAction->setCheckable(true);
+    m_pauseAction->setShortcut(Qt::Key_Space);
+    QToolBar* toolBar = addToolBar("Mosaic");
+    toolBar->addAction(m_pauseAction);
+
+    m_statusLabel = new QLabel(this);
+    statusBar()->addWidget(m_statusLabel, 1);
+    m_statusTimer = new QTimer(this);
+    m_statusTimer->setInterval(1000);
+
+    // Pool threads publish; the tiles are taken on this thread.
+    connect(&m_controller, &MosaicController::tilesAvailable, this, &MosaicWindow::presentTiles, Qt::QueuedConnection);
+    connect(&m_controller, &MosaicController::streamOpened, this, &MosaicWindow::onStreamOpened, Qt::QueuedConnection);
+    connect(m_mosaicWidget, &MosaicWidget::tileSizeChanged, this,
+            [this](const QSize& size) { m_controller.setTileSize(size.width(), size.height()); });
+    connect(m_pauseAction, &QAction::toggled, this, &MosaicWindow::onPauseToggled);
+    connect(m_statusTimer, &QTimer::timeout, this, &MosaicWindow::updateStatus);
+
+    m_controller.setFrameDelta(frameDelta);
+    m_controller.setMotionThreshold(threshold);
+    const QSize tileSize = m_mosaicWidget->tileSize();
+    m_controller.setTileSize(tileSize.width(), tileSize.height());
+    // Returns at once: the captures are opened on the pool and tiles appear as they do.
+    m_controller.start(paths);
+
+    m_statusElapsed.start();
+    m_statusTimer->start();
+    updateStatus();
+}
+
+MosaicWindow::~MosaicWindow()
+{
+    m_controller.stop();
+}
+
+void MosaicWindow::setFrameDelta(int delta)
+{
+    m_controller.setFrameDelta(delta);
+}
+
+void MosaicWindow::setMotionThreshold(int threshold)
+{
+    m_controller.setMotionThreshold(threshold);
+}
+
+void MosaicWindow::presentTiles()
+{
+    m_tiles.clear();
+    m_controller.takeChangedTiles(m_tiles);
+    m_mosaicWidget->updateTiles(m_tiles);
+}
+
+void MosaicWindow::onStreamOpened(int stream, bool opened)
+{
+    if (opened) m_mosaicWidget->addStream(stream, QFileInfo(m_controller.streamPath(stream)).fileName());
+
+    const MosaicStats stats = m_controller.stats();
+    if (stats.streams == 0 && stats.streamsFailed == m_controller.streamCount()) {
+        QMessageBox::warning(this, "Open Mosaic", "None of the selected files could be opened.");
+        close();
+    }
+}
+
+void MosaicWindow::onPauseToggled(bool paused)
+{
+    m_controller.setPaused(paused);
+    m_pauseAction->setText(paused ? "&Resume" : "&Pause");
+    m_pauseAction->setIcon(style()->standardIcon(paused ? QStyle::SP_MediaPlay : QStyle::SP_MediaPause));
+}
+
+void MosaicWindow::updateStatus()
+{
+    const MosaicStats stats = m_controller.stats();
+    const double seconds = std::max<qint64>(1, m_statusElapsed.restart()) / 1000.0;
+    const double tilesPerSecond = (stats.tilesPublished - m_lastStats.tilesPublished) / seconds;
+    const double latePerSecond = (stats.framesLate - m_lastStats.framesLate) / seconds;
+    m_lastStats = stats;
+
+    m_statusLabel->setText(QString("%1 streams on %2 pool threads | %3 tiles/s | %4 late frames/s | %5 steals")
+                               .arg(stats.streams)
+                               .arg(stats.poolThreads)
+                               .arg(tilesPerSecond, 0, 'f', 0)
+                               .arg(latePerSecond, 0, 'f', 0)
+                               .arg(stats.steals));
+}
@@ -0,0 +1,48 @@
+#ifndef MOSAICWINDOW_H
+#define MOSAICWINDOW_H
+
+#include <QMainWindow>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <vector>
+
+#include "MosaicController.h"
+
+class MosaicWidget;
+class QAction;
+class QLabel;
+class QTimer;
+
+// Top-level window playing many recordings side by side (see MosaicController).
+// Deletes itself when closed.
+class MosaicWindow : public QMainWindow
+{
+    Q_OBJECT
+
+public:
+    MosaicWindow(const QStringList& paths, int frameDelta, int threshold, QWidget *parent = nullptr);
+    ~MosaicWindow() override;
+
+
+public slots:
+    void setFrameDelta(int delta);
+    void setMotionThreshold(int threshold);
+
+private slots:
+    void presentTiles();
+    void onStreamOpened(int stream, bool opened);
+    void onPauseToggled(bool paused);
+    void updateStatus();
+
+private:
+    MosaicController m_controller;
+    MosaicWidget* m_mosaicWidget = nullptr;
+    QAction* m_pauseAction = nullptr;
+    QLabel* m_statusLabel = nullptr;
+    QTimer* m_statusTimer = nullptr;
+    std::vector<MosaicTile> m_tiles; // Reused per presentation
+    MosaicStats m_lastStats;
+    QElapsedTimer m_statusElapsed;
+};
+
+#endif // MOSAICWINDOW_H
@@ -0,0 +1,240 @@
+#include "MotionDetector.h"
+#include "GrayFrameRing.h"
+#include "MotionKernel.h"
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+// Frame N against frame N - delta: the original algorithm.
+class FrameDifferenceDetector : public MotionDetector
+{
+public:
+    explicit FrameDifferenceDetector(int maxFrameDelta) : m_ring(maxFrameDelta + 1) {}
+
+    MotionAlgorithm algorithm() const override { return MotionAlgorithm::FrameDifference; }
+    void reset() override { m_ring.reset(); }
+
+    bool detect(const cv::Mat& frame, const MotionParams& params, cv::Mat& mask) override
+    {
+        // Each frame is converted to gray once, straight into a reused ring slot, in the
+        // same pass that diffs and thresholds it against frame N - delta.
+        const int delta = std::clamp(params.frameDelta, 1, m_ring.capacity() - 1);
+        cv::Mat& gray = m_ring.nextSlot(frame.size());
+        bool converted;
+        if (m_ring.size() >= delta) {
+            // The ring has not advanced yet, so frame N - delta is delta - 1 back from the latest.
+            converted = fusedGrayDiffThreshold(frame, m_ring.ago(delta - 1), params.threshold, gray, mask);
+        } else {
+            mask.release();
+            converted = convertToGray(frame, gray);
+        }
+        if (converted) m_ring.commit();
+        return converted;
+    }
+
+    bool learn(const cv::Mat& frame, const MotionParams&) override
+    {
+        m_ring.push(frame);
+        return true;
+    }
+
+private:
+    GrayFrameRing m_ring;
+};
+
+// Frames N, N - delta and N - 2 * delta; the history ring holds up to 2 * max delta frames.
+class ThreeFrameDifferenceDetector : public MotionDetector
+{
+public:
+    explicit ThreeFrameDifferenceDetector(int maxFrameDelta) : m_ring(2 * maxFrameDelta + 1) {}
+
+    MotionAlgorithm algorithm() const override { return MotionAlgorithm::ThreeFrameDifference; }
+    void reset() override { m_ring.reset(); }
+
+    bool detect(const cv::Mat& frame, const MotionParams& params, cv::Mat& mask) override
+    {
+        const int delta = std::clamp(params.frameDelta, 1, (m_ring.capacity() - 1) / 2);
+        cv::Mat& gray = m_ring.nextSlot(frame.size());
+        bool converted;
+        if (m_ring.size() >= 2 * delta) {
+            converted = fusedGrayThreeFrameDiff(frame, m_ring.ago(delta - 1), m_ring.ago(2 * delta - 1),
+                                                params.threshold, gray, mask);
+        } else {
+            mask.release();
+            converted = convertToGray(frame, gray);
+        }
+        if (converted) m_ring.commit();
+        return converted;
+    }
+
+    bool learn(const cv::Mat& frame, const MotionParams&) override
+    {
+        m_ring.push(frame);
+        return true;
+    }
+
+private:
+    GrayFrameRing m_ring;
+};
+
+// Exponential running-average background (alpha = 1/32) kept in 16-bit fixed point.
+// Adapts to slow lighting changes; the frame delta is not used.
+class RunningAverageDetector : public MotionDetector
+{
+public:
+    MotionAlgorithm algorithm() const override { return MotionAlgorithm::RunningAverage; }
+    void reset() override { m_background.release(); }
+
+    bool detect(const cv::Mat& frame, const MotionParams& params, cv::Mat& mask) override
+    {
+        if (m_background.size() != frame.size()) {
+            // First frame (or a new size): it becomes the background; no mask yet.
+            mask.release();
+            if (!convertToGray(frame, m_gray)) return false;
+            m_gray.convertTo(m_background, CV_16UC1, 1 << kBackgroundFractionBits);
+            return true;
+        }
+        return fusedRunningAverage(frame, m_background, kLearningShift, params.threshold, m_gray, mask);
+    }
+
+private:
+    static constexpr int kLearningShift = 5;
+
+    cv::Mat m_background; // CV_16UC1, kBackgroundFractionBits fractional bits
+    cv::Mat m_gray;       // Scratch
+};
+
+// OpenCV's Gaussian-mixture (MOG2) and k-nearest-neighbour background subtractors, run
+// on the gray frame. Shadow detection is off so masks stay binary. Far slower than the
+// fused detectors, but robust to repetitive background motion.
+class SubtractorDetector : public MotionDetector
+{
+public:
+    explicit SubtractorDetector(MotionAlgorithm algorithm) : m_algorithm(algorithm) { reset(); }
+
+    MotionAlgorithm algorithm() const override { return m_algorithm; }
+
+    void reset() override
+    {
+        if (m_algorithm == MotionAlgorithm::Mog2) {
+            m_subtractor = cv::createBackgroundSubtractorMOG2(500, 16.0, false);
+        } else {
+            m_subtractor = cv::createBackgroundSubtractorKNN(500, 400.0, false);
+        }
+        m_appliedThreshold = -1;
+        m_framesSeen = 0;
+    }
+
+    bool detect(const cv::Mat& frame, const MotionParams& params, cv::Mat& mask) override
+    {
+        if (!convertToGray(frame, m_gray)) return false;
+        if (params.threshold != m_appliedThreshold) {
+            // threshold is a gray-level distance; both subtractors compare squared distances.
+            const double squared = std::max(1.0, static_cast<double>(params.threshold) * params.threshold);
+            if (auto mog2 = m_subtractor.dynamicCast<cv::BackgroundSubtractorMOG2>()) {
+                // MOG2 measures distance in standard deviations; its 4-sigma default is 16.
+                mog2->setVarThreshold(squared / 16.0);
+            } else if (auto knn = m_subtractor.dynamicCast<cv::BackgroundSubtractorKNN>()) {
+                knn->setDist2Threshold(squared);
+            }
+            m_appliedThreshold = params.threshold;
+        }
+        m_subtractor->apply(m_gray, mask);
+        // The model starts from the first frame, so its first mask is meaningless.
+        if (++m_framesSeen < 2) mask.release();
+        return true;
+    }
+
+private:
+    MotionAlgorithm m_algorithm;
+    cv::Ptr<cv::BackgroundSubtractor> m_subtractor;
+    cv::Mat m_gray;
+    int m_appliedThreshold = -1;
+    int m_framesSeen = 0;
+};
+
+} // namespace
+
+bool MotionDetector::learn(const cv::Mat& frame, const MotionParams& params)
+{
+    return detect(frame, params, m_discardedMask);
+}
+
+MultiDeltaDetector::MultiDeltaDetector(int maxFrameDelta)
+    : m_ring(maxFrameDelta + 1)
+{
+}
+
+bool MultiDeltaDetector::detect(const cv::Mat& frame, const std::vector<int>& deltas, int threshold,
+                                std::vector<cv::Mat>& masks)
+{
+    masks.assign(deltas.size(), cv::Mat());
+    cv::Mat& gray = m_ring.nextSlot(frame.size());
+
+    m_history.clear();
+    m_historyMask.clear();
+    for (size_t i = 0; i < deltas.size(); ++i) {
+        const int delta = std::clamp(deltas[i], 1, m_ring.capacity() - 1);
+        if (m_ring.size() < delta) continue;
+        // As in FrameDifferenceDetector, the ring has not advanced yet.
+        m_history.push_back(&m_ring.ago(delta - 1));
+        m_historyMask.push_back(i);
+    }
+
+    bool converted;
+    if (m_history.empty()) {
+        converted = convertToGray(frame, gray);
+    } else {
+        // Fresh masks per frame: callers share them with other threads.
+        std::vector<cv::Mat> fused;
+        converted = fusedGrayMultiDiff(frame, m_history, threshold, gray, fused);
+        if (converted) {
+            for (size_t i = 0; i < fused.size(); ++i) masks[m_historyMask[i]] = fused[i];
+        }
+    }
+    if (converted) m_ring.commit();
+    return converted;
+}
+
+std::unique_ptr<MotionDetector> createMotionDetector(MotionAlgorithm algorithm, int maxFrameDelta)
+{
+    switch (algorithm) {
+    case MotionAlgorithm::FrameDifference:
+        return std::make_unique<FrameDifferenceDetector>(maxFrameDelta);
+    case MotionAlgorithm::RunningAverage:
+        return std::make_unique<RunningAverageDetector>();
+    case MotionAlgorithm::ThreeFrameDifference:
+        return std::make_unique<ThreeFrameDifferenceDetector>(maxFrameDelta);
+    case MotionAlgorithm::Mog2:
+    case MotionAlgorithm::Knn:
+        return std::make_unique<SubtractorDetector>(algorithm);
+    }
+    qWarning() << "Unknown motion algorithm" << static_cast<int>(algorithm) << ", using frame difference.";
+    return std::make_unique<FrameDifferenceDetector>(maxFrameDelta);
+}
+
+const char* motionAlgorithmName(MotionAlgorithm algorithm)
+{
+    switch (algorithm) {
+    case MotionAlgorithm::FrameDifference: return "diff";
+    case MotionAlgorithm::RunningAverage: return "average";
+    case MotionAlgorithm::ThreeFrameDifference: return "three-frame";
+    case MotionAlgorithm::Mog2: return "mog2";
+    case MotionAlgorithm::Knn: return "knn";
+    }
+    return "unknown";
+}
+
+bool parseMotionAlgorithm(const std::string& name, MotionAlgorithm& algorithm)
+{
+    for (MotionAlgorithm candidate : {MotionAlgorithm::FrameDifference, MotionAlgorithm::RunningAverage,
+                                      MotionAlgorithm::ThreeFrameDifference, MotionAlgorithm::Mog2,
+                                      MotionAlgorithm::Knn}) {
+        if (name == motionAlgorithmName(candidate)) {
+            algorithm = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,84 @@
+#ifndef MOTIONDETECTOR_H
+#define MOTIONDETECTOR_H
+
+#include <opencv2/opencv.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GrayFrameRing.h"
+
+enum class MotionAlgorithm
+{
+    FrameDifference,      // |N - (N - delta)| > threshold
+    RunningAverage,       // Deviation from an exponential running-average background
+    ThreeFrameDifference, // Moved against both N - delta and N - 2 * delta
+    Mog2,                 // OpenCV BackgroundSubtractorMOG2
+    Knn                   // OpenCV BackgroundSubtractorKNN
+};
+
+// Settings read for every frame, so they can change while processing runs.
+struct MotionParams
+{
+    int frameDelta = 3;
+    int threshold = 30;
+};
+
+// Turns a stream of frames (CV_8UC3 BGR or CV_8UC1) into binary motion masks. One
+// virtual call per frame; the per-pixel work of the built-in detectors is in the
+// templated kernels of MotionKernel.h. Not thread-safe: one detector per stream.
+class MotionDetector
+{
+public:
+    virtual ~MotionDetector() = default;
+
+    virtual MotionAlgorithm algorithm() const = 0;
+
+    // Forget all history (e.g. after a seek).
+    virtual void reset() = 0;
+
+    // Adds frame to the history and computes its mask (0 or 255, CV_8UC1, frame size).
+    // mask is left empty while the detector has too little history. Returns false if the
+    // frame could not be processed.
+    virtual bool detect(const cv::Mat& frame, const MotionParams& params, cv::Mat& mask) = 0;
+
+    // Adds frame to the history without needing its mask, e.g. frames decoded only to
+    // refill history after a seek. The default runs detect() and discards the result.
+    virtual bool learn(const cv::Mat& frame, const MotionParams& params);
+
+private:
+    cv::Mat m_discardedMask;
+};
+
+// Frame differencing against several deltas at once (e.g. 1, 3, 10 and 30), sharing
+// one gray history and one luma conversion per frame: each frame is read once and diffed
+// against every requested history frame in the same pass (see fusedGrayMultiDiff()).
+// Not a MotionDetector, since it produces one mask per delta. Not thread-safe.
+class MultiDeltaDetector
+{
+public:
+    explicit MultiDeltaDetector(int maxFrameDelta);
+
+    void reset() { m_ring.reset(); }
+
+    // Adds frame to the history and computes masks[i] for deltas[i] (clamped to
+    // 1..maxFrameDelta). A mask is left empty while the history is shorter than its delta.
+    // At most kMaxFusedDeltas deltas. Returns false if the frame could not be processed.
+    bool detect(const cv::Mat& frame, const std::vector<int>& deltas, int threshold, std::vector<cv::Mat>& masks);
+    void learn(const cv::Mat& frame) { m_ring.push(frame); }
+
+private:
+    GrayFrameRing m_ring;
+    std::vector<const cv::Mat*> m_history; // Reused per frame
+    std::vector<size_t> m_historyMask;     // Index into masks of each m_history entry
+};
+
+// maxFrameDelta sizes the frame history of the differencing detectors up front.
+std::unique_ptr<MotionDetector> createMotionDetector(MotionAlgorithm algorithm, int maxFrameDelta);
+
+// Short names used on the command line and in exported settings: "diff", "average",
+// "three-frame", "mog2", "knn".
+const char* motionAlgorithmName(MotionAlgorithm algorithm);
+bool parseMotionAlgorithm(const std::string& name, MotionAlgorithm& algorithm);
+
+#endif // MOTIONDETECTOR_H
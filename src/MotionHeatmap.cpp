@@ -0,0 +1,54 @@
+#include "MotionHeatmap.h"
+#include "MotionKernel.h"
+#include <algorithm>
+#include <cmath>
+
+void MotionHeatmap::setWindowFrames(double frames)
+{
+    m_decayPerFrame = 255.0 / std::max(1.0, frames);
+}
+
+void MotionHeatmap::reset()
+{
+    if (!m_heat.empty() && !m_cleared) {
+        m_heat.setTo(0);
+        m_cleared = true;
+    }
+    m_decayCredit = 0.0;
+}
+
+void MotionHeatmap::accumulate(const cv::Mat& mask)
+{
+    // Windows longer than 255 frames decay by less than one step per frame; the
+    // remainder is carried over instead of being rounded away.
+    m_decayCredit += m_decayPerFrame;
+    const double steps = std::floor(m_decayCredit);
+    m_decayCredit -= steps;
+    const int decay = static_cast<int>(std::min(255.0, steps));
+
+    if (m_cleared && mask.empty()) return; // Nothing to fade yet
+
+    const cv::Mat* input = &mask;
+    // A cleared map takes the size of its next mask (decayAndAccumulate() reallocates
+    // only if that differs); one with history resamples the mask instead.
+    if (!mask.empty() && !m_heat.empty() && !m_cleared && mask.size() != m_heat.size()) {
+        cv::resize(mask, m_resizedMask, m_heat.size(), 0, 0, cv::INTER_NEAREST);
+        input = &m_resizedMask;
+    }
+    decayAndAccumulate(*input, decay, kIncrement, m_heat);
+    if (!mask.empty()) m_cleared = false;
+}
+
+void MotionHeatmap::render(const cv::Size& size, cv::Mat& scratch, cv::Mat& bgr) const
+{
+    if (isEmpty()) {
+        bgr.release();
+        return;
+    }
+    const cv::Mat* heat = &m_heat;
+    if (!size.empty() && size != m_heat.size()) {
+        cv::resize(m_heat, scratch, size, 0, 0, cv::INTER_LINEAR);
+        heat = &scratch;
+    }
+    cv::applyColorMap(*heat, bgr, cv::COLORMAP_INFERNO);
+}
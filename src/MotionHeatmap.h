@@ -0,0 +1,44 @@
+#ifndef MOTIONHEATMAP_H
+#define MOTIONHEATMAP_H
+
+#include <opencv2/opencv.hpp>
+
+// Decaying heatmap of where motion happened recently. Each mask adds kIncrement to the
+// pixels that moved (saturating at 255) and the whole map fades linearly, so a pixel
+// that moved once is gone after the window and one that keeps moving stays hot. One
+// O(pixels) pass per frame into a buffer allocated once (decayAndAccumulate()); past
+// frames are never revisited.
+//
+// The map keeps the size of the first mask after a reset. Masks of another size (the
+// analysis scale changed) are resampled to it, so the history survives the change.
+// Not thread-safe.
+class MotionHeatmap
+{
+public:
+    // Heat added per frame in which a pixel moved: eight moving frames saturate it.
+    static constexpr int kIncrement = 32;
+
+    // Frames over which full heat fades to zero.
+    void setWindowFrames(double frames);
+    // Clears the heat but keeps the buffer, so the next frame (e.g. after a seek) does not
+    // allocate; it is only reallocated if the next mask has another size.
+    void reset();
+    // An empty mask (no history yet, or a frame whose mask was not computed) only decays.
+    void accumulate(const cv::Mat& mask);
+
+    // True until the first mask after construction or reset().
+    bool isEmpty() const { return m_heat.empty() || m_cleared; }
+    const cv::Mat& heat() const { return m_heat; }
+    // Colour-mapped heat, BGR, scaled to size (the heatmap's own size if empty).
+    // scratch holds the resized heat between calls.
+    void render(const cv::Size& size, cv::Mat& scratch, cv::Mat& bgr) const;
+
+private:
+    cv::Mat m_heat;
+    cv::Mat m_resizedMask;
+    double m_decayPerFrame = 255.0 / 300.0;
+    double m_decayCredit = 0.0; // Fraction of a heat step owed from earlier frames
+    bool m_cleared = false;     // m_heat is all zeros since reset(); the next mask sets its size
+};
+
+#endif // MOTIONHEATMAP_H
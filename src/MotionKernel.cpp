@@ -0,0 +1,440 @@
+#include "MotionKernel.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+namespace {
+
+// Fixed-point luma weights of OpenCV 4's 8-bit RGB2Gray (imgproc/src/color_rgb.simd.hpp).
+// These are 15-bit; the 14-bit YUV weights round differently, e.g. BGR (180, 0, 224).
+constexpr int kGrayShift = 15;
+constexpr int kB2Y = 3735;
+constexpr int kG2Y = 19235;
+constexpr int kR2Y = 9798;
+constexpr int kRound = 1 << (kGrayShift - 1);
+
+template <int Channels>
+struct Luma;
+
+template <>
+struct Luma<1>
+{
+    static uchar pixel(const uchar* src) { return src[0]; }
+#if CV_SIMD
+    static cv::v_uint8 load(const uchar* src) { return cv::vx_load(src); }
+#endif
+};
+
+template <>
+struct Luma<3>
+{
+    static uchar pixel(const uchar* src)
+    {
+        return static_cast<uchar>((src[0] * kB2Y + src[1] * kG2Y + src[2] * kR2Y + kRound) >> kGrayShift);
+    }
+
+#if CV_SIMD
+    static cv::v_uint16 weigh(const cv::v_uint16& b, const cv::v_uint16& g, const cv::v_uint16& r)
+    {
+        const cv::v_uint32 cb = cv::vx_setall_u32(kB2Y);
+        const cv::v_uint32 cg = cv::vx_setall_u32(kG2Y);
+        const cv::v_uint32 cr = cv::vx_setall_u32(kR2Y);
+        const cv::v_uint32 round = cv::vx_setall_u32(kRound);
+
+        cv::v_uint32 b0, b1, g0, g1, r0, r1;
+        cv::v_expand(b, b0, b1);
+        cv::v_expand(g, g0, g1);
+        cv::v_expand(r, r0, r1);
+        const cv::v_uint32 y0 = cv::v_shr<kGrayShift>(b0 * cb + g0 * cg + r0 * cr + round);
+        const cv::v_uint32 y1 = cv::v_shr<kGrayShift>(b1 * cb + g1 * cg + r1 * cr + round);
+        return cv::v_pack(y0, y1);
+    }
+
+    static cv::v_uint8 load(const uchar* src)
+    {
+        cv::v_uint8 b, g, r;
+        cv::v_load_deinterleave(src, b, g, r);
+        cv::v_uint16 b0, b1, g0, g1, r0, r1;
+        cv::v_expand(b, b0, b1);
+        cv::v_expand(g, g0, g1);
+        cv::v_expand(r, r0, r1);
+        return cv::v_pack(weigh(b0, g0, r0), weigh(b1, g1, r1));
+    }
+#endif
+};
+
+inline uchar absDiff(uchar a, uchar b)
+{
+    return a > b ? a - b : b - a;
+}
+
+// Per-pixel operations fused behind the luma conversion. Each op is a template argument
+// of processRow(), so the detector-specific work is inlined into the row loop; there is
+// no per-pixel dispatch. beginRow() points the op at its rows, vector() handles one
+// register of luma values and scalar() a single pixel of the tail.
+
+struct GrayOnlyOp
+{
+    static constexpr int kBytesPerPixel = 1; // Gray output
+    void beginRow(int) {}
+#if CV_SIMD
+    void vector(int, const cv::v_uint8&) {}
+#endif
+    void scalar(int, uchar) {}
+};
+
+// mask = |gray - previous| > threshold
+struct FrameDiffOp
+{
+    static constexpr int kBytesPerPixel = 3; // Gray, previous, mask
+
+    const cv::Mat* previousImage;
+    cv::Mat* maskImage;
+    uchar threshold;
+    const uchar* previous = nullptr;
+    uchar* mask = nullptr;
+
+    void beginRow(int row)
+    {
+        previous = previousImage->ptr<uchar>(row);
+        mask = maskImage->ptr<uchar>(row);
+    }
+#if CV_SIMD
+    void vector(int x, const cv::v_uint8& y)
+    {
+        // Unsigned compare yields 0xFF per true lane, i.e. exactly THRESH_BINARY's 255.
+        cv::v_store(mask + x, cv::v_absdiff(y, cv::vx_load(previous + x)) > cv::vx_setall_u8(threshold));
+    }
+#endif
+    void scalar(int x, uchar y) { mask[x] = absDiff(y, previous[x]) > threshold ? 255 : 0; }
+};
+
+// masks[i] = |gray - previous[i]| > threshold for up to kMaxFusedDeltas history frames
+struct MultiDiffOp
+{
+    // Gray plus a history row and a mask row per delta; sized for four deltas, the
+    // typical sweep, which only affects how rows are grouped into stripes.
+    static constexpr int kBytesPerPixel = 1 + 2 * 4;
+
+    int count = 0;
+    std::array<const cv::Mat*, kMaxFusedDeltas> previousImages{};
+    std::array<cv::Mat*, kMaxFusedDeltas> maskImages{};
+    uchar threshold = 0;
+    std::array<const uchar*, kMaxFusedDeltas> previous{};
+    std::array<uchar*, kMaxFusedDeltas> mask{};
+
+    void beginRow(int row)
+    {
+        for (int i = 0; i < count; ++i) {
+            previous[i] = previousImages[i]->ptr<uchar>(row);
+            mask[i] = maskImages[i]->ptr<uchar>(row);
+        }
+    }
+#if CV_SIMD
+    void vector(int x, const cv::v_uint8& y)
+    {
+        const cv::v_uint8 vthreshold = cv::vx_setall_u8(threshold);
+        for (int i = 0; i < count; ++i) {
+            cv::v_store(mask[i] + x, cv::v_absdiff(y, cv::vx_load(previous[i] + x)) > vthreshold);
+        }
+    }
+#endif
+    void scalar(int x, uchar y)
+    {
+        for (int i = 0; i < count; ++i) mask[i][x] = absDiff(y, previous[i][x]) > threshold ? 255 : 0;
+    }
+};
+
+// mask = |gray - previous| > threshold && |previous - older| > threshold
+struct ThreeFrameDiffOp
+{
+    static constexpr int kBytesPerPixel = 4; // Gray, previous, older, mask
+
+    const cv::Mat* previousImage;
+    const cv::Mat* olderImage;
+    cv::Mat* maskImage;
+    uchar threshold;
+    const uchar* previous = nullptr;
+    const uchar* older = nullptr;
+    uchar* mask = nullptr;
+
+    void beginRow(int row)
+    {
+        previous = previousImage->ptr<uchar>(row);
+        older = olderImage->ptr<uchar>(row);
+        mask = maskImage->ptr<uchar>(row);
+    }
+#if CV_SIMD
+    void vector(int x, const cv::v_uint8& y)
+    {
+        const cv::v_uint8 vthreshold = cv::vx_setall_u8(threshold);
+        const cv::v_uint8 p = cv::vx_load(previous + x);
+        cv::v_store(mask + x, (cv::v_absdiff(y, p) > vthreshold) & (cv::v_absdiff(p, cv::vx_load(older + x)) > vthreshold));
+    }
+#endif
+    void scalar(int x, uchar y)
+    {
+        mask[x] = (absDiff(y, previous[x]) > threshold && absDiff(previous[x], older[x]) > threshold) ? 255 : 0;
+    }
+};
+
+// Exponential running average in fixed point: with g = gray << kBackgroundFractionBits,
+// mask = |g - background| > threshold << kBackgroundFractionBits, then
+// background += (g - background) >> learningShift. Everything fits in int16.
+struct RunningAverageOp
+{
+    static constexpr int kBytesPerPixel = 4; // Gray, background (2), mask
+
+    cv::Mat* backgroundImage;
+    cv::Mat* maskImage;
+    int threshold; // Already in background units
+    int learningShift;
+    ushort* background = nullptr;
+    uchar* mask = nullptr;
+
+    void beginRow(int row)
+    {
+        background = backgroundImage->ptr<ushort>(row);
+        mask = maskImage->ptr<uchar>(row);
+    }
+#if CV_SIMD
+    cv::v_uint16 update(const cv::v_uint16& y, ushort* bg) const
+    {
+        const cv::v_int16 b = cv::v_reinterpret_as_s16(cv::vx_load(bg));
+        const cv::v_int16 d = cv::v_reinterpret_as_s16(cv::v_shl<kBackgroundFractionBits>(y)) - b;
+        cv::v_store(bg, cv::v_reinterpret_as_u16(b + (d >> learningShift)));
+        return cv::v_abs(d) > cv::vx_setall_u16(static_cast<ushort>(threshold));
+    }
+
+    void vector(int x, const cv::v_uint8& y)
+    {
+        cv::v_uint16 y0, y1;
+        cv::v_expand(y, y0, y1);
+        const cv::v_uint16 m0 = update(y0, background + x);
+        const cv::v_uint16 m1 = update(y1, background + x + cv::v_uint16::nlanes);
+        cv::v_store(mask + x, cv::v_pack(m0, m1)); // 0xFFFF saturates to 255
+    }
+#endif
+    void scalar(int x, uchar y)
+    {
+        const int d = (y << kBackgroundFractionBits) - background[x];
+        mask[x] = std::abs(d) > threshold ? 255 : 0;
+        background[x] = static_cast<ushort>(background[x] + (d >> learningShift));
+    }
+};
+
+// One row: luma into gray, then op on the same values while they are still in registers.
+template <int Channels, class Op>
+void processRow(const uchar* src, uchar* gray, int width, bool vectorize, Op& op)
+{
+    int x = 0;
+#if CV_SIMD
+    if (vectorize) {
+        const int lanes = cv::v_uint8::nlanes;
+        for (; x <= width - lanes; x += lanes) {
+            const cv::v_uint8 y = Luma<Channels>::load(src + x * Channels);
+            cv::v_store(gray + x, y);
+            op.vector(x, y);
+        }
+    }
+#else
+    (void)vectorize;
+#endif
+    for (; x < width; ++x) {
+        const uchar y = Luma<Channels>::pixel(src + x * Channels);
+        gray[x] = y;
+        op.scalar(x, y);
+    }
+}
+
+// Rows are processed in horizontal stripes sized so that a stripe's input and output
+// rows fit in a core's L2 cache; stripes run on OpenCV's thread pool.
+constexpr size_t kStripeBytes = 256 * 1024;
+
+// setMotionKernelThreads() of the calling thread, 0 = no limit.
+thread_local int t_kernelThreads = 0;
+
+// Runs processStripe over rows in stripes of rowsPerStripe rows, at most as many at once
+// as the calling thread allows. With a limit the rows are split into that many stripes
+// instead, which caps the concurrency without touching OpenCV's global thread count.
+template <class Body>
+void runStripes(int rows, int rowsPerStripe, const Body& processStripe)
+{
+    int stripes = (rows + rowsPerStripe - 1) / rowsPerStripe;
+    if (t_kernelThreads > 0) stripes = std::min(stripes, t_kernelThreads);
+    if (stripes <= 1 || cv::getNumThreads() <= 1) {
+        processStripe(cv::Range(0, rows));
+    } else {
+        cv::parallel_for_(cv::Range(0, rows), processStripe, stripes);
+    }
+}
+
+template <int Channels, class Op>
+void processRows(const cv::Mat& src, cv::Mat& gray, const Op& prototype)
+{
+    const bool vectorize = cv::useOptimized();
+    auto processStripe = [&](const cv::Range& rows) {
+        Op op = prototype; // Row pointers are per stripe
+        for (int row = rows.start; row < rows.end; ++row) {
+            op.beginRow(row);
+            processRow<Channels>(src.ptr<uchar>(row), gray.ptr<uchar>(row), src.cols, vectorize, op);
+        }
+#if CV_SIMD
+        cv::vx_cleanup();
+#endif
+    };
+
+    // Bytes touched per row: the input plus whatever the op reads and writes.
+    const size_t rowBytes = static_cast<size_t>(src.cols) * (Channels + Op::kBytesPerPixel);
+    const int rowsPerStripe = static_cast<int>(std::max<size_t>(1, kStripeBytes / std::max<size_t>(1, rowBytes)));
+    runStripes(src.rows, rowsPerStripe, processStripe);
+}
+
+template <class Op>
+void processFrame(const cv::Mat& src, cv::Mat& gray, const Op& op)
+{
+    gray.create(src.size(), CV_8UC1);
+    if (src.type() == CV_8UC3) {
+        processRows<3>(src, gray, op);
+    } else {
+        processRows<1>(src, gray, op);
+    }
+}
+
+bool matchesInput(const cv::Mat& image, int type, const cv::Mat& src, const char* caller)
+{
+    if (image.type() == type && image.size() == src.size()) return true;
+    qWarning() << caller << ": history image does not match the input size.";
+    return false;
+}
+
+bool isSupportedInput(const cv::Mat& src, const char* caller)
+{
+    if (src.type() == CV_8UC3 || src.type() == CV_8UC1) return true;
+    qWarning() << caller << ": Unsupported cv::Mat type:" << src.type();
+    return false;
+}
+
+} // namespace
+
+void setMotionKernelThreads(int threads)
+{
+    t_kernelThreads = std::max(0, threads);
+}
+
+bool convertToGray(const cv::Mat& src, cv::Mat& gray)
+{
+    if (!isSupportedInput(src, "convertToGray")) return false;
+    processFrame(src, gray, GrayOnlyOp());
+    return true;
+}
+
+bool fusedGrayDiffThreshold(const cv::Mat& src, const cv::Mat& previousGray, int threshold,
+                            cv::Mat& gray, cv::Mat& mask)
+{
+    if (!isSupportedInput(src, "fusedGrayDiffThreshold")) return false;
+    if (!matchesInput(previousGray, CV_8UC1, src, "fusedGrayDiffThreshold")) return false;
+
+    mask.create(src.size(), CV_8UC1);
+    processFrame(src, gray, FrameDiffOp{&previousGray, &mask, cv::saturate_cast<uchar>(threshold)});
+    return true;
+}
+
+bool fusedGrayMultiDiff(const cv::Mat& src, const std::vector<const cv::Mat*>& previousGrays, int threshold,
+                        cv::Mat& gray, std::vector<cv::Mat>& masks)
+{
+    if (!isSupportedInput(src, "fusedGrayMultiDiff")) return false;
+    if (previousGrays.empty() || previousGrays.size() > static_cast<size_t>(kMaxFusedDeltas)) {
+        qWarning() << "fusedGrayMultiDiff: between 1 and" << kMaxFusedDeltas << "history frames are supported.";
+        return false;
+    }
+
+    masks.resize(previousGrays.size());
+    MultiDiffOp op;
+    op.count = static_cast<int>(previousGrays.size());
+    op.threshold = cv::saturate_cast<uchar>(threshold);
+    for (int i = 0; i < op.count; ++i) {
+        if (!matchesInput(*previousGrays[i], CV_8UC1, src, "fusedGrayMultiDiff")) return false;
+        masks[i].create(src.size(), CV_8UC1);
+        op.previousImages[i] = previousGrays[i];
+        op.maskImages[i] = &masks[i];
+    }
+    processFrame(src, gray, op);
+    return true;
+}
+
+bool fusedGrayThreeFrameDiff(const cv::Mat& src, const cv::Mat& previousGray, const cv::Mat& olderGray,
+                             int threshold, cv::Mat& gray, cv::Mat& mask)
+{
+    if (!isSupportedInput(src, "fusedGrayThreeFrameDiff")) return false;
+    if (!matchesInput(previousGray, CV_8UC1, src, "fusedGrayThreeFrameDiff")
+        || !matchesInput(olderGray, CV_8UC1, src, "fusedGrayThreeFrameDiff")) return false;
+
+    mask.create(src.size(), CV_8UC1);
+    processFrame(src, gray, ThreeFrameDiffOp{&previousGray, &olderGray, &mask, cv::saturate_cast<uchar>(threshold)});
+    return true;
+}
+
+bool fusedRunningAverage(const cv::Mat& src, cv::Mat& background, int learningShift, int threshold,
+                         cv::Mat& gray, cv::Mat& mask)
+{
+    if (!isSupportedInput(src, "fusedRunningAverage")) return false;
+    if (!matchesInput(background, CV_16UC1, src, "fusedRunningAverage")) return false;
+
+    mask.create(src.size(), CV_8UC1);
+    const int scaledThreshold = std::clamp(threshold, 0, 255) << kBackgroundFractionBits;
+    processFrame(src, gray, RunningAverageOp{&background, &mask, scaledThreshold, std::clamp(learningShift, 0, 15)});
+    return true;
+}
+
+bool decayAndAccumulate(const cv::Mat& mask, int decay, int increment, cv::Mat& heat)
+{
+    if (!mask.empty() && mask.type() != CV_8UC1) {
+        qWarning() << "decayAndAccumulate: Unsupported cv::Mat type:" << mask.type();
+        return false;
+    }
+    if (!mask.empty() && (heat.type() != CV_8UC1 || heat.size() != mask.size())) {
+        heat = cv::Mat::zeros(mask.size(), CV_8UC1);
+    }
+    if (heat.empty()) return true;
+
+    const uchar d = cv::saturate_cast<uchar>(decay);
+    const uchar a = mask.empty() ? 0 : cv::saturate_cast<uchar>(increment);
+    if (d == 0 && a == 0) return true;
+    auto processStripe = [&](const cv::Range& rows) {
+        for (int row = rows.start; row < rows.end; ++row) {
+            uchar* h = heat.ptr<uchar>(row);
+            const uchar* m = a ? mask.ptr<uchar>(row) : nullptr;
+            int x = 0;
+#if CV_SIMD
+            if (cv::useOptimized()) {
+                // 8-bit lane arithmetic saturates.
+                const cv::v_uint8 vd = cv::vx_setall_u8(d);
+                const cv::v_uint8 va = cv::vx_setall_u8(a);
+                const int lanes = cv::v_uint8::nlanes;
+                if (m) {
+                    for (; x <= heat.cols - lanes; x += lanes) {
+                        cv::v_store(h + x, (cv::vx_load(h + x) - vd) + (cv::vx_load(m + x) & va));
+                    }
+                } else {
+                    for (; x <= heat.cols - lanes; x += lanes) cv::v_store(h + x, cv::vx_load(h + x) - vd);
+                }
+            }
+#endif
+            for (; x < heat.cols; ++x) {
+                const int decayed = std::max(0, h[x] - d);
+                h[x] = cv::saturate_cast<uchar>(decayed + (m ? (m[x] & a) : 0));
+            }
+        }
+#if CV_SIMD
+        cv::vx_cleanup();
+#endif
+    };
+
+    // Reads and writes heat, reads the mask.
+    const int rowsPerStripe = static_cast<int>(std::max<size_t>(1, kStripeBytes / (2 * static_cast<size_t>(heat.cols))));
+    runStripes(heat.rows, rowsPerStripe, processStripe);
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef MOTIONKERNEL_H
+#define MOTIONKERNEL_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Single-pass motion kernels. Gray conversion uses the same 15-bit fixed-point
+// BT.601 weights as cv::cvtColor(COLOR_BGR2GRAY) on 8-bit input, so results are
+// bit-exact with the cvtColor -> absdiff -> threshold(THRESH_BINARY) chain
+// (bench/motion_checks.cpp verifies this).
+//
+// Supported inputs are CV_8UC3 (BGR) and CV_8UC1. Every kernel is one templated row
+// loop specialised per channel count and per fused operation, so nothing is dispatched
+// per pixel. The vectorised path (OpenCV universal intrinsics) is used when
+// OpenCV was built with SIMD support and cv::useOptimized() is true; otherwise the
+// scalar path runs. Large frames are split into cache-sized row stripes that run on
+// OpenCV's thread pool; setMotionKernelThreads() limits how many run at once.
+
+// Caps the stripes the kernels called from this thread run in parallel (0 = no limit
+// beyond OpenCV's pool). Per calling thread: unlike cv::setNumThreads() it does not
+// change any other OpenCV call in the process.
+void setMotionKernelThreads(int threads);
+
+// gray = luma(src)
+bool convertToGray(const cv::Mat& src, cv::Mat& gray);
+
+// gray = luma(src) and mask = |gray - previousGray| > threshold ? 255 : 0, reading
+// src once and writing no intermediate diff image. gray and mask are (re)allocated
+// only if their size or type does not match.
+bool fusedGrayDiffThreshold(const cv::Mat& src, const cv::Mat& previousGray, int threshold,
+                            cv::Mat& gray, cv::Mat& mask);
+
+// Three-frame differencing: a pixel moves only if it differs both from previousGray and
+// previousGray from olderGray, which suppresses the "ghost" left where an object was.
+bool fusedGrayThreeFrameDiff(const cv::Mat& src, const cv::Mat& previousGray, const cv::Mat& olderGray,
+                             int threshold, cv::Mat& gray, cv::Mat& mask);
+
+// Most history frames fusedGrayMultiDiff() compares against in one pass.
+constexpr int kMaxFusedDeltas = 8;
+
+// Several frame differences at once: masks[i] = |luma(src) - *previousGrays[i]| > threshold.
+// The frame is read and converted to gray once; each row is diffed against every
+// history frame while its luma is still in registers. At most kMaxFusedDeltas history
+// frames; masks is resized to match.
+bool fusedGrayMultiDiff(const cv::Mat& src, const std::vector<const cv::Mat*>& previousGrays, int threshold,
+                        cv::Mat& gray, std::vector<cv::Mat>& masks);
+
+// Fractional bits of the CV_16UC1 running-average background (gray << 7 fits in int16).
+constexpr int kBackgroundFractionBits = 7;
+
+// Running-average background: mask = |luma(src) - background| > threshold, then the
+// background moves 1 / 2^learningShift of the way towards the frame, in place.
+bool fusedRunningAverage(const cv::Mat& src, cv::Mat& background, int learningShift, int threshold,
+                         cv::Mat& gray, cv::Mat& mask);
+
+// Motion heatmap update, in place: heat = sat(sat(heat - decay) + (mask & increment)).
+// mask is a binary CV_8UC1 mask of heat's size; an empty mask only decays. heat is
+// (re)allocated as zeros if its size or type does not match. One pass, no temporaries.
+bool decayAndAccumulate(const cv::Mat& mask, int decay, int increment, cv::Mat& heat);
+
+#endif // MOTIONKERNEL_H
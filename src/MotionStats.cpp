@@ -0,0 +1,133 @@
+#include "MotionStats.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// Index of the first non-zero byte in [x, width), or width. Empty stretches are skipped
+// eight bytes at a time.
+int nextSet(const uchar* row, int x, int width)
+{
+    for (; x + 8 <= width; x += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, row + x, sizeof(word));
+        if (word != 0) break;
+    }
+    while (x < width && row[x] == 0) ++x;
+    return x;
+}
+
+int nextClear(const uchar* row, int x, int width)
+{
+    while (x < width && row[x] != 0) ++x;
+    return x;
+}
+
+} // namespace
+
+int BlobExtractor::find(int run)
+{
+    while (m_parent[run] != run) {
+        m_parent[run] = m_parent[m_parent[run]];
+        run = m_parent[run];
+    }
+    return run;
+}
+
+void BlobExtractor::unite(int a, int b)
+{
+    a = find(a);
+    b = find(b);
+    if (a == b) return;
+    // The lower index becomes the root so roots follow scan order.
+    if (a < b) m_parent[b] = a;
+    else m_parent[a] = b;
+}
+
+void BlobExtractor::extract(const cv::Mat& mask, int minArea, int coordinateScale, MotionStats& stats)
+{
+    stats.hasMask = false;
+    stats.changedPixels = 0;
+    stats.motionRatio = 0.0;
+    stats.blobs.clear();
+    if (mask.empty()) return;
+    CV_Assert(mask.type() == CV_8UC1);
+
+    m_runs.clear();
+    m_parent.clear();
+
+    // Runs of the previous row are [previousBegin, previousEnd) in m_runs.
+    size_t previousBegin = 0, previousEnd = 0;
+    for (int y = 0; y < mask.rows; ++y) {
+        const uchar* row = mask.ptr<uchar>(y);
+        const size_t rowBegin = m_runs.size();
+        size_t candidate = previousBegin;
+        int x = nextSet(row, 0, mask.cols);
+        while (x < mask.cols) {
+            const int end = nextClear(row, x, mask.cols);
+            const int index = static_cast<int>(m_runs.size());
+            m_runs.push_back({y, x, end});
+            m_parent.push_back(index);
+
+            // 8-connectivity: runs touch if they overlap after widening by one column.
+            // Runs on both rows are sorted, so the scan over the previous row never rewinds
+            // past runs that end before this one starts.
+            while (candidate < previousEnd && m_runs[candidate].end < x) ++candidate;
+            for (size_t above = candidate; above < previousEnd && m_runs[above].start <= end; ++above) {
+                unite(index, static_cast<int>(above));
+            }
+            x = nextSet(row, end, mask.cols);
+        }
+        previousBegin = rowBegin;
+        previousEnd = m_runs.size();
+    }
+
+    // Accumulate per component.
+    m_accumulatorOfRoot.assign(m_runs.size(), -1);
+    m_accumulators.clear();
+    for (size_t i = 0; i < m_runs.size(); ++i) {
+        const Run& run = m_runs[i];
+        const int root = find(static_cast<int>(i));
+        int& slot = m_accumulatorOfRoot[root];
+        if (slot < 0) {
+            slot = static_cast<int>(m_accumulators.size());
+            m_accumulators.push_back({run.start, run.row, run.end - 1, run.row, 0, 0.0, 0.0});
+        }
+        Accumulator& acc = m_accumulators[slot];
+        const int length = run.end - run.start;
+        acc.minX = std::min(acc.minX, run.start);
+        acc.maxX = std::max(acc.maxX, run.end - 1);
+        acc.minY = std::min(acc.minY, run.row);
+        acc.maxY = std::max(acc.maxY, run.row);
+        acc.area += length;
+        acc.sumX += (run.start + run.end - 1) * 0.5 * length;
+        acc.sumY += static_cast<double>(run.row) * length;
+        stats.changedPixels += length;
+    }
+
+    stats.hasMask = true;
+    stats.motionRatio = mask.total() > 0 ? static_cast<double>(stats.changedPixels) / mask.total() : 0.0;
+
+    const double scale = std::max(1, coordinateScale);
+    for (const Accumulator& acc : m_accumulators) {
+        if (acc.area < minArea) continue;
+        MotionBlob blob;
+        blob.box = cv::Rect(static_cast<int>(acc.minX * scale), static_cast<int>(acc.minY * scale),
+                            static_cast<int>((acc.maxX - acc.minX + 1) * scale),
+                            static_cast<int>((acc.maxY - acc.minY + 1) * scale));
+        // Map the mean pixel centre back to the source frame's pixel grid.
+        blob.centroid = cv::Point2d((acc.sumX / acc.area + 0.5) * scale - 0.5,
+                                    (acc.sumY / acc.area + 0.5) * scale - 0.5);
+        blob.area = acc.area;
+        stats.blobs.push_back(blob);
+    }
+
+    auto largerFirst = [](const MotionBlob& a, const MotionBlob& b) { return a.area > b.area; };
+    if (stats.blobs.size() > kMaxBlobs) {
+        std::partial_sort(stats.blobs.begin(), stats.blobs.begin() + kMaxBlobs, stats.blobs.end(), largerFirst);
+        stats.blobs.resize(kMaxBlobs);
+    } else {
+        std::sort(stats.blobs.begin(), stats.blobs.end(), largerFirst);
+    }
+}
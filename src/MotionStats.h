@@ -0,0 +1,65 @@
+#ifndef MOTIONSTATS_H
+#define MOTIONSTATS_H
+
+#include <QtGlobal>
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// One 8-connected region of changed pixels, in source frame coordinates.
+struct MotionBlob
+{
+    cv::Rect box;
+    cv::Point2d centroid;
+    int area = 0; // Changed pixels at analysis resolution
+};
+
+// Per-frame numbers derived from the motion mask.
+struct MotionStats
+{
+    qint64 frameIndex = -1;
+    bool hasMask = false;  // False until the delta history is full; the rest is then zero
+    int changedPixels = 0; // At analysis resolution
+    double motionRatio = 0.0;
+    std::vector<MotionBlob> blobs; // Largest first, at most BlobExtractor::kMaxBlobs
+};
+
+// Run-based connected-component labelling for binary masks. Each row is scanned for
+// runs of non-zero pixels (skipping empty stretches a word at a time), runs that touch
+// a run on the previous row are merged with union-find, and the statistics are then
+// accumulated per run rather than per pixel. Cost therefore scales with the number of
+// runs, which keeps sparse masks cheap. Buffers are reused between calls.
+class BlobExtractor
+{
+public:
+    static constexpr size_t kMaxBlobs = 256;
+
+    // Fills stats from mask (CV_8UC1, or empty for "no mask yet"). Blobs smaller than
+    // minArea pixels are dropped. Coordinates are multiplied by coordinateScale so that
+    // masks computed at reduced resolution report positions in the source frame.
+    void extract(const cv::Mat& mask, int minArea, int coordinateScale, MotionStats& stats);
+
+private:
+    struct Run
+    {
+        int row;
+        int start; // First set column
+        int end;   // One past the last set column
+    };
+
+    struct Accumulator
+    {
+        int minX, minY, maxX, maxY;
+        int area;
+        double sumX, sumY;
+    };
+
+    int find(int run);
+    void unite(int a, int b);
+
+    std::vector<Run> m_runs;
+    std::vector<int> m_parent;
+    std::vector<int> m_accumulatorOfRoot;
+    std::vector<Accumulator> m_accumulators;
+};
+
+#endif // MOTIONSTATS_H
@@ -0,0 +1,175 @@
+#include "MotionStatsWriter.h"
+#include <QDebug>
+#include <QFileInfo>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+void appendFormatted(std::string& out, const char* format, double value)
+{
+    char buffer[32];
+    const int length = std::snprintf(buffer, sizeof(buffer), format, value);
+    if (length > 0) out.append(buffer, static_cast<size_t>(std::min<int>(length, sizeof(buffer) - 1)));
+}
+
+} // namespace
+
+MotionStatsWriter::~MotionStatsWriter()
+{
+    close();
+}
+
+MotionStatsWriter::Format MotionStatsWriter::formatForPath(const QString& path)
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    return (suffix == "jsonl" || suffix == "ndjson") ? Format::JsonLines : Format::Csv;
+}
+
+bool MotionStatsWriter::open(const QString& path, Format format)
+{
+    close();
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to open motion stats file:" << path;
+        return false;
+    }
+    m_format = format;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.clear();
+    if (m_format == Format::Csv) {
+        m_pending = "frame,changed_pixels,motion_ratio,blob_count,blobs\n";
+    }
+    m_open = true;
+    m_closing = false;
+    m_failed = false;
+    m_thread = std::thread([this] { writerLoop(); });
+    return true;
+}
+
+bool MotionStatsWriter::isOpen() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_open;
+}
+
+void MotionStatsWriter::write(const MotionStats& stats)
+{
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_open || m_failed.load(std::memory_order_relaxed)) return;
+        if (m_format == Format::Csv) appendCsv(stats);
+        else appendJson(stats);
+        wake = m_pending.size() >= kFlushBytes;
+    }
+    if (wake) m_wake.notify_one();
+}
+
+bool MotionStatsWriter::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_open) return !m_failed.load();
+        m_open = false;
+        m_closing = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    m_file.close();
+    if (!m_failed.load() && m_file.error() != QFileDevice::NoError) {
+        qWarning() << "Motion stats close failed:" << m_file.errorString();
+        m_failed = true;
+    }
+    if (m_failed.load()) {
+        qWarning() << "Motion stats file" << m_file.fileName() << "is incomplete: writing failed.";
+        return false;
+    }
+    return true;
+}
+
+void MotionStatsWriter::writerLoop()
+{
+    std::string writing;
+    bool closing = false;
+    while (!closing) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(kFlushIntervalMs),
+                            [this] { return m_closing || m_pending.size() >= kFlushBytes; });
+            closing = m_closing;
+            writing.swap(m_pending); // m_pending keeps the capacity of the previous batch
+        }
+        if (!writing.empty() && !m_failed.load(std::memory_order_relaxed)) {
+            // After a short write the rows would no longer line up, so the rest is dropped.
+            const qint64 size = static_cast<qint64>(writing.size());
+            if (m_file.write(writing.data(), size) != size) {
+                qWarning() << "Motion stats write failed:" << m_file.errorString();
+                m_failed = true;
+            } else if (!m_file.flush()) {
+                qWarning() << "Motion stats flush failed:" << m_file.errorString();
+                m_failed = true;
+            }
+        }
+        writing.clear();
+    }
+}
+
+void MotionStatsWriter::appendCsv(const MotionStats& stats)
+{
+    std::string& out = m_pending;
+    out += std::to_string(stats.frameIndex);
+    if (!stats.hasMask) {
+        // No mask until the delta history is full: leave the result columns empty.
+        out += ",,,,\n";
+        return;
+    }
+    out += ',';
+    out += std::to_string(stats.changedPixels);
+    out += ',';
+    appendFormatted(out, "%.6f", stats.motionRatio);
+    out += ',';
+    out += std::to_string(stats.blobs.size());
+    out += ',';
+    // Blobs as x:y:w:h separated by ';' so the column needs no quoting.
+    for (size_t i = 0; i < stats.blobs.size(); ++i) {
+        const cv::Rect& box = stats.blobs[i].box;
+        if (i > 0) out += ';';
+        out += std::to_string(box.x) + ':' + std::to_string(box.y) + ':'
+             + std::to_string(box.width) + ':' + std::to_string(box.height);
+    }
+    out += '\n';
+}
+
+void MotionStatsWriter::appendJson(const MotionStats& stats)
+{
+    std::string& out = m_pending;
+    out += "{\"frame\":";
+    out += std::to_string(stats.frameIndex);
+    if (!stats.hasMask) {
+        out += ",\"changed_pixels\":null,\"motion_ratio\":null,\"blobs\":[]}\n";
+        return;
+    }
+    out += ",\"changed_pixels\":";
+    out += std::to_string(stats.changedPixels);
+    out += ",\"motion_ratio\":";
+    appendFormatted(out, "%.6f", stats.motionRatio);
+    out += ",\"blobs\":[";
+    for (size_t i = 0; i < stats.blobs.size(); ++i) {
+        const MotionBlob& blob = stats.blobs[i];
+        if (i > 0) out += ',';
+        out += "{\"x\":" + std::to_string(blob.box.x)
+             + ",\"y\":" + std::to_string(blob.box.y)
+             + ",\"w\":" + std::to_string(blob.box.width)
+             + ",\"h\":" + std::to_string(blob.box.height)
+             + ",\"cx\":";
+        appendFormatted(out, "%.2f", blob.centroid.x);
+        out += ",\"cy\":";
+        appendFormatted(out, "%.2f", blob.centroid.y);
+        out += ",\"area\":" + std::to_string(blob.area) + '}';
+    }
+    out += "]}\n";
+}
@@ -0,0 +1,72 @@
+#ifndef MOTIONSTATSWRITER_H
+#define MOTIONSTATSWRITER_H
+
+#include "MotionStats.h"
+#include <QFile>
+#include <QString>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Streams MotionStats rows to a CSV or JSON Lines file without blocking the caller on
+// disk I/O. write() formats the row into an in-memory buffer; a writer thread swaps that
+// buffer out and writes it while the next rows accumulate (double buffering). If the
+// disk is slower than the analysis the buffer grows rather than stalling analysis.
+//
+// write() and close() are thread-safe; write() on a closed writer does nothing.
+//
+// Once a write or flush fails, later rows are discarded and close() returns false: the
+// file is then truncated and must not be taken for the complete statistics.
+class MotionStatsWriter
+{
+public:
+    enum class Format
+    {
+        Csv,       // frame,changed_pixels,motion_ratio,blob_count,blobs
+        JsonLines  // One JSON object per frame
+    };
+
+    MotionStatsWriter() = default;
+    ~MotionStatsWriter();
+
+    MotionStatsWriter(const MotionStatsWriter&) = delete;
+    MotionStatsWriter& operator=(const MotionStatsWriter&) = delete;
+
+    // .jsonl / .ndjson select JSON Lines, anything else CSV.
+    static Format formatForPath(const QString& path);
+
+    // Truncates path and writes the CSV header if applicable. Closes any previous file.
+    bool open(const QString& path, Format format);
+    void write(const MotionStats& stats);
+    // Flushes everything written so far and stops the writer thread. Returns false if
+    // any write failed (also when called again after that).
+    bool close();
+
+    bool isOpen() const;
+    bool hasFailed() const { return m_failed.load(std::memory_order_relaxed); }
+    QString path() const { return m_file.fileName(); }
+
+private:
+    // The writer thread wakes once this much is pending, or every kFlushIntervalMs.
+    static constexpr size_t kFlushBytes = 64 * 1024;
+    static constexpr int kFlushIntervalMs = 500;
+
+    void writerLoop();
+    void appendCsv(const MotionStats& stats);
+    void appendJson(const MotionStats& stats);
+
+    QFile m_file; // Writer thread only while open
+    Format m_format = Format::Csv;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::string m_pending; // Guarded by m_mutex
+    bool m_open = false;
+    bool m_closing = false;
+    std::atomic<bool> m_failed{false};
+    std::thread m_thread;
+};
+
+#endif // MOTIONSTATSWRITER_H
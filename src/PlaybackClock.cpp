@@ -0,0 +1,42 @@
+#include "PlaybackClock.h"
+#include <algorithm>
+
+namespace {
+
+PlaybackClock::Clock::duration toClockDuration(double seconds)
+{
+    return std::chrono::duration_cast<PlaybackClock::Clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+} // namespace
+
+void PlaybackClock::start(double fps, double speed, qint64 frameIndex)
+{
+    m_fps = fps > 0.0 ? fps : 30.0;
+    m_speed = std::clamp(speed, kMinSpeed, kMaxSpeed);
+    rebase(frameIndex);
+}
+
+void PlaybackClock::rebase(qint64 frameIndex)
+{
+    m_origin = Clock::now();
+    m_originFrame = frameIndex;
+}
+
+void PlaybackClock::setSpeed(double speed, qint64 frameIndex)
+{
+    const Clock::time_point anchor = deadline(frameIndex);
+    m_speed = std::clamp(speed, kMinSpeed, kMaxSpeed);
+    m_origin = anchor;
+    m_originFrame = frameIndex;
+}
+
+PlaybackClock::Clock::time_point PlaybackClock::deadline(qint64 frameIndex) const
+{
+    return m_origin + toClockDuration(static_cast<double>(frameIndex - m_originFrame) / (m_fps * m_speed));
+}
+
+PlaybackClock::Clock::duration PlaybackClock::framePeriod() const
+{
+    return toClockDuration(1.0 / (m_fps * m_speed));
+}
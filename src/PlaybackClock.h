@@ -0,0 +1,39 @@
+#ifndef PLAYBACKCLOCK_H
+#define PLAYBACKCLOCK_H
+
+#include <QtGlobal>
+#include <chrono>
+
+// Maps frame indices to absolute presentation deadlines on std::chrono::steady_clock.
+// Deadlines are computed from a fixed origin rather than accumulated per frame, so
+// sleep jitter and processing time never build up into drift.
+class PlaybackClock
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr double kMinSpeed = 0.25;
+    static constexpr double kMaxSpeed = 16.0;
+
+    // frameIndex is presented now; later frames follow at fps * speed.
+    void start(double fps, double speed, qint64 frameIndex);
+    // Re-anchors the timeline so frameIndex is presented now (after pause, seek or
+    // when catching up is hopeless). Keeps fps and speed.
+    void rebase(qint64 frameIndex);
+    // Changes speed without jumping: frameIndex keeps its current deadline.
+    void setSpeed(double speed, qint64 frameIndex);
+
+    Clock::time_point deadline(qint64 frameIndex) const;
+    Clock::duration framePeriod() const;
+
+    double speed() const { return m_speed; }
+    double targetFps() const { return m_fps * m_speed; }
+
+private:
+    Clock::time_point m_origin;
+    qint64 m_originFrame = 0;
+    double m_fps = 30.0;
+    double m_speed = 1.0;
+};
+
+#endif // PLAYBACKCLOCK_H
@@ -0,0 +1,369 @@
+#include "Profiler.h"
+#include <QDebug>
+#include <QFile>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+std::atomic<bool> Profiler::s_enabled{false};
+std::atomic<bool> Profiler::s_tracing{false};
+
+namespace {
+
+constexpr size_t kStages = static_cast<size_t>(ProfileStage::Count);
+
+// Log-linear buckets: values below 2 * kSubBuckets ns are exact, above that each power
+// of two is split into kSubBuckets buckets. 640 buckets reach beyond 2^40 ns (18 min).
+constexpr int kSubBucketBits = 4;
+constexpr int kSubBuckets = 1 << kSubBucketBits;
+constexpr int kBuckets = 640;
+
+int bucketFor(qint64 ns)
+{
+    const quint64 value = static_cast<quint64>(std::max<qint64>(ns, 0));
+    const int exponent = value > 0 ? 63 - static_cast<int>(qCountLeadingZeroBits(value)) : 0;
+    const int shift = std::max(0, exponent - kSubBucketBits);
+    return std::min(kBuckets - 1, shift * kSubBuckets + static_cast<int>(value >> shift));
+}
+
+// Upper edge of a bucket, used as its representative value (conservative percentiles).
+double bucketUpperNs(int bucket)
+{
+    if (bucket < 2 * kSubBuckets) return bucket;
+    const int shift = bucket / kSubBuckets - 1;
+    const quint64 mantissa = static_cast<quint64>(bucket - shift * kSubBuckets);
+    return static_cast<double>(((mantissa + 1) << shift) - 1);
+}
+
+struct TraceEvent
+{
+    ProfileStage stage;
+    qint64 startNs;
+    qint64 durationNs;
+};
+
+struct ThreadData
+{
+    int id = 0; // Trace thread id of the current owner
+    // Written by the owning thread only; other threads just read.
+    std::array<std::array<std::atomic<quint64>, kBuckets>, kStages> counts;
+    std::array<std::atomic<qint64>, kStages> maxNs;
+
+    std::mutex mutex; // Guards name and trace; only contended while a trace is written
+    std::string name;
+    std::vector<TraceEvent> trace;
+};
+
+// Trace events of a thread that has exited, kept until the trace is written.
+struct RetiredTrace
+{
+    int id = 0;
+    std::string name;
+    std::vector<TraceEvent> trace;
+};
+
+struct Registry
+{
+    std::mutex mutex; // Taken before any ThreadData::mutex
+    // Slots of exited threads stay here (their samples still count in summary()) and are
+    // handed to the next thread that records, so there are only as many slots as threads
+    // ever recorded at the same time.
+    std::vector<std::unique_ptr<ThreadData>> threads;
+    std::vector<ThreadData*> freeThreads;
+    std::vector<RetiredTrace> retiredTraces;
+    int lastId = 0;
+    QString tracePath;
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+// Set by setThreadName(), which may run long before (or without) the first sample.
+thread_local std::string t_threadName;
+
+void releaseThreadData(ThreadData* data)
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    {
+        std::lock_guard<std::mutex> dataLock(data->mutex);
+        if (!data->trace.empty()) {
+            reg.retiredTraces.push_back({data->id, data->name, std::move(data->trace)});
+            data->trace.clear();
+        }
+        data->name.clear();
+    }
+    reg.freeThreads.push_back(data);
+}
+
+// Owns the calling thread's slot and returns it to the registry when the thread exits.
+// Thread-local objects are destroyed before the static registry.
+struct ThreadSlot
+{
+    ThreadData* data = nullptr;
+    ~ThreadSlot()
+    {
+        if (data) releaseThreadData(data);
+    }
+};
+
+thread_local ThreadSlot t_slot;
+
+// Only called while recording, so threads that never record a sample cost nothing.
+ThreadData& threadData()
+{
+    if (!t_slot.data) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        ThreadData* data = nullptr;
+        if (!reg.freeThreads.empty()) {
+            data = reg.freeThreads.back();
+            reg.freeThreads.pop_back();
+        } else {
+            // Value-initialised, so the histogram atomics start at zero.
+            reg.threads.push_back(std::make_unique<ThreadData>());
+            data = reg.threads.back().get();
+        }
+        data->id = ++reg.lastId;
+        {
+            std::lock_guard<std::mutex> dataLock(data->mutex);
+            data->name = t_threadName;
+        }
+        t_slot.data = data;
+    }
+    return *t_slot.data;
+}
+
+template <typename Function>
+void forEachThread(Function function)
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto& thread : reg.threads) function(*thread);
+}
+
+void appendJsonString(std::string& out, const std::string& text)
+{
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) out += c;
+    }
+    out += '"';
+}
+
+} // namespace
+
+const char* profileStageName(ProfileStage stage)
+{
+    switch (stage) {
+    case ProfileStage::Decode: return "decode";
+    case ProfileStage::Motion: return "motion";
+    case ProfileStage::Stats: return "stats";
+    case ProfileStage::Emit: return "emit";
+    case ProfileStage::Export: return "export";
+    case ProfileStage::DisplayPrepare: return "display-prepare";
+    case ProfileStage::Present: return "present";
+    case ProfileStage::Paint: return "paint";
+    case ProfileStage::Count: break;
+    }
+    return "unknown";
+}
+
+qint64 Profiler::nowNs()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+    nowNs(); // Fix the epoch before the first sample
+    s_enabled.store(enabled || isTracing(), std::memory_order_relaxed);
+}
+
+void Profiler::reset()
+{
+    // Racing with a recording thread can lose a reset bucket or a sample; harmless here.
+    forEachThread([](ThreadData& thread) {
+        for (auto& stage : thread.counts) {
+            for (auto& count : stage) count.store(0, std::memory_order_relaxed);
+        }
+        for (auto& maxNs : thread.maxNs) maxNs.store(0, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(thread.mutex);
+        thread.trace.clear();
+    });
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.retiredTraces.clear();
+}
+
+void Profiler::setThreadName(const char* name)
+{
+    t_threadName = name;
+    if (!t_slot.data) return;
+    std::lock_guard<std::mutex> lock(t_slot.data->mutex);
+    t_slot.data->name = name;
+}
+
+void Profiler::record(ProfileStage stage, qint64 startNs, qint64 endNs)
+{
+    ThreadData& data = threadData();
+    const size_t stageIndex = static_cast<size_t>(stage);
+    const qint64 durationNs = endNs - startNs;
+
+    // Single writer per thread: plain load + store instead of fetch_add.
+    std::atomic<quint64>& count = data.counts[stageIndex][bucketFor(durationNs)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic<qint64>& maxNs = data.maxNs[stageIndex];
+    if (durationNs > maxNs.load(std::memory_order_relaxed)) maxNs.store(durationNs, std::memory_order_relaxed);
+
+    if (isTracing()) {
+        std::lock_guard<std::mutex> lock(data.mutex);
+        if (data.trace.size() < kMaxTraceEventsPerThread) data.trace.push_back({stage, startNs, durationNs});
+    }
+}
+
+std::array<StageSummary, static_cast<size_t>(ProfileStage::Count)> Profiler::summary()
+{
+    std::array<std::array<quint64, kBuckets>, kStages> merged{};
+    std::array<qint64, kStages> maxNs{};
+    forEachThread([&](const ThreadData& thread) {
+        for (size_t stage = 0; stage < kStages; ++stage) {
+            for (int bucket = 0; bucket < kBuckets; ++bucket) {
+                merged[stage][bucket] += thread.counts[stage][bucket].load(std::memory_order_relaxed);
+            }
+            maxNs[stage] = std::max(maxNs[stage], thread.maxNs[stage].load(std::memory_order_relaxed));
+        }
+    });
+
+    std::array<StageSummary, kStages> result;
+    for (size_t stage = 0; stage < kStages; ++stage) {
+        StageSummary& summary = result[stage];
+        for (quint64 count : merged[stage]) summary.count += count;
+        if (summary.count == 0) continue;
+
+        const quint64 p50Rank = (summary.count + 1) / 2;
+        const quint64 p99Rank = std::max<quint64>(1, (summary.count * 99 + 99) / 100);
+        quint64 seen = 0;
+        for (int bucket = 0; bucket < kBuckets; ++bucket) {
+            const quint64 before = seen;
+            seen += merged[stage][bucket];
+            if (before < p50Rank && seen >= p50Rank) summary.p50Ms = bucketUpperNs(bucket) / 1e6;
+            if (before < p99Rank && seen >= p99Rank) {
+                summary.p99Ms = bucketUpperNs(bucket) / 1e6;
+                break;
+            }
+        }
+        summary.maxMs = maxNs[stage] / 1e6;
+        // A bucket's upper edge can exceed the largest sample it holds.
+        summary.p50Ms = std::min(summary.p50Ms, summary.maxMs);
+        summary.p99Ms = std::min(summary.p99Ms, summary.maxMs);
+    }
+    return result;
+}
+
+QString Profiler::summaryText()
+{
+    const auto stages = summary();
+    QString text;
+    for (size_t stage = 0; stage < stages.size(); ++stage) {
+        const StageSummary& s = stages[stage];
+        if (s.count == 0) continue;
+        text += QString("%1: n=%2 p50=%3 ms p99=%4 ms max=%5 ms\n")
+                    .arg(profileStageName(static_cast<ProfileStage>(stage)), -16)
+                    .arg(s.count)
+                    .arg(s.p50Ms, 0, 'f', 3)
+                    .arg(s.p99Ms, 0, 'f', 3)
+                    .arg(s.maxMs, 0, 'f', 3);
+    }
+    return text;
+}
+
+bool Profiler::startTrace(const QString& path)
+{
+    if (path.isEmpty()) return false;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.tracePath = path;
+        reg.retiredTraces.clear();
+    }
+    forEachThread([](ThreadData& thread) {
+        std::lock_guard<std::mutex> lock(thread.mutex);
+        thread.trace.clear();
+    });
+    s_tracing.store(true, std::memory_order_relaxed);
+    setEnabled(true);
+    qInfo() << "Recording pipeline trace to" << path;
+    return true;
+}
+
+bool Profiler::stopTrace()
+{
+    if (!s_tracing.exchange(false)) return false;
+
+    QString path;
+    std::vector<RetiredTrace> retired;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        path = reg.tracePath;
+        retired.swap(reg.retiredTraces);
+    }
+
+    // Chrome trace_event format: complete ("X") events in microseconds, plus thread names.
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    size_t events = 0;
+    auto appendThread = [&](int id, const std::string& threadName, const std::vector<TraceEvent>& trace) {
+        if (trace.empty()) return;
+        const std::string name = threadName.empty() ? "thread " + std::to_string(id) : threadName;
+
+        if (!first) json += ",\n";
+        first = false;
+        json += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" + std::to_string(id)
+              + ",\"args\":{\"name\":";
+        appendJsonString(json, name);
+        json += "}}";
+        for (const TraceEvent& event : trace) {
+            json += ",\n{\"ph\":\"X\",\"cat\":\"pipeline\",\"name\":\"";
+            json += profileStageName(event.stage);
+            json += "\",\"pid\":1,\"tid\":" + std::to_string(id)
+                  + ",\"ts\":" + std::to_string(event.startNs / 1000) + "." + std::to_string(event.startNs % 1000 / 100)
+                  + ",\"dur\":" + std::to_string(event.durationNs / 1000) + "." + std::to_string(event.durationNs % 1000 / 100)
+                  + "}";
+        }
+        events += trace.size();
+    };
+    for (const RetiredTrace& thread : retired) appendThread(thread.id, thread.name, thread.trace);
+    forEachThread([&](ThreadData& thread) {
+        std::vector<TraceEvent> trace;
+        std::string name;
+        int id = 0;
+        {
+            std::lock_guard<std::mutex> lock(thread.mutex);
+            trace.swap(thread.trace);
+            name = thread.name;
+            id = thread.id;
+        }
+        appendThread(id, name, trace);
+    });
+    json += "\n]}\n";
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || file.write(json.data(), static_cast<qint64>(json.size())) != static_cast<qint64>(json.size())) {
+        qWarning() << "Failed to write pipeline trace:" << path;
+        return false;
+    }
+    qInfo() << "Wrote" << events << "trace events to" << path;
+    return true;
+}
@@ -0,0 +1,98 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QString>
+#include <QtGlobal>
+#include <array>
+#include <atomic>
+
+// Pipeline stages that are timed. Gray conversion, differencing and thresholding run
+// as one fused kernel, so they are measured together as Motion.
+enum class ProfileStage
+{
+    Decode,         // Decoder thread: read/grab + GOP cache
+    Motion,         // Gray conversion + motion detector (diff, threshold, ...)
+    Stats,          // Motion statistics and blob extraction
+    Emit,           // newFramesReady() including direct-connection consumers
+    Export,         // frameAnalyzed(): video export queueing (waits when full), mask archive
+    DisplayPrepare, // Scaling + colour conversion for display on the worker thread
+    Present,        // GUI: taking the frames and wrapping them in QImages
+    Paint,          // GUI: VideoDisplayWidget::paintEvent
+    Count
+};
+
+const char* profileStageName(ProfileStage stage);
+
+struct StageSummary
+{
+    quint64 count = 0;
+    double p50Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+};
+
+// Process-wide stage timing. Disabled, a ProfileScope costs one relaxed atomic load.
+// Enabled, each thread records into its own log-linear histograms (16 sub-buckets per
+// power of two, so values are within ~6%); only the recording thread writes them, so
+// no locks or read-modify-write atomics are needed, and summary() merges them on demand.
+// A thread gets its histograms with its first sample, not before, and hands them on to
+// the next thread that records once it exits, so memory is bounded by the number of
+// threads recording at the same time rather than by how many were ever started.
+// While a trace is active every scope is also kept as a Chrome trace_event and written
+// as JSON (loadable in Perfetto / chrome://tracing) by stopTrace().
+class Profiler
+{
+public:
+    static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enabled);
+
+    // Clears all histograms (and any trace events not yet written).
+    static void reset();
+
+    // Names the calling thread in traces. Only stores the name; costs nothing when off.
+    static void setThreadName(const char* name);
+
+    static void record(ProfileStage stage, qint64 startNs, qint64 endNs);
+    static std::array<StageSummary, static_cast<size_t>(ProfileStage::Count)> summary();
+    // One line per stage with samples, for logs and the command line.
+    static QString summaryText();
+
+    // Tracing implies enabled. At most kMaxTraceEventsPerThread events are kept per thread.
+    static bool startTrace(const QString& path);
+    // Writes the trace file; returns false if no trace was active or writing failed.
+    static bool stopTrace();
+    static bool isTracing() { return s_tracing.load(std::memory_order_relaxed); }
+
+    static qint64 nowNs();
+
+    static constexpr size_t kMaxTraceEventsPerThread = 1 << 20;
+
+private:
+    static std::atomic<bool> s_enabled;
+    static std::atomic<bool> s_tracing;
+};
+
+// Times the enclosing scope as one sample of stage.
+class ProfileScope
+{
+public:
+    explicit ProfileScope(ProfileStage stage)
+        : m_stage(stage),
+          m_startNs(Profiler::isEnabled() ? Profiler::nowNs() : -1)
+    {
+    }
+
+    ~ProfileScope()
+    {
+        if (m_startNs >= 0) Profiler::record(m_stage, m_startNs, Profiler::nowNs());
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    ProfileStage m_stage;
+    qint64 m_startNs;
+};
+
+#endif // PROFILER_H
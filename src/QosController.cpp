@@ -0,0 +1,76 @@
+#include "QosController.h"
+#include <algorithm>
+
+const char* QosController::levelName(int level)
+{
+    switch (level) {
+    case Full: return "full quality";
+    case HalfAnalysisResolution: return "1/2 analysis resolution";
+    case QuarterAnalysisResolution: return "1/4 analysis resolution";
+    case AlternateFrameAnalysis: return "1/4 resolution, every 2nd frame analysed";
+    case HalfDisplayRate: return "1/4 resolution, every 2nd frame analysed and shown";
+    default: return "unknown";
+    }
+}
+
+void QosController::reset()
+{
+    m_level = Full;
+    m_restoreWindows = kRestoreWindows;
+    m_windowsSinceRestore = kRestoreWindows;
+    m_calmWindows = 0;
+    restartWindow();
+}
+
+void QosController::restartWindow()
+{
+    m_windowLoad = 0.0;
+    m_windowFrames = 0;
+}
+
+bool QosController::addFrame(double busyFraction)
+{
+    m_windowLoad += busyFraction;
+    if (++m_windowFrames < kWindowFrames) return false;
+
+    const double load = m_windowLoad / m_windowFrames;
+    restartWindow();
+    ++m_windowsSinceRestore;
+
+    if (load > kDegradeLoad) {
+        m_calmWindows = 0;
+        if (m_level == LevelCount - 1) return false;
+        // Lost the level again right after getting it back: hold the next attempt off longer.
+        if (m_windowsSinceRestore <= kRestoreWindows) {
+            m_restoreWindows = std::min(2 * m_restoreWindows, kMaxRestoreWindows);
+        }
+        ++m_level;
+        return true;
+    }
+
+    if (load < kRestoreLoad && m_level > Full) {
+        if (++m_calmWindows < m_restoreWindows) return false;
+        m_calmWindows = 0;
+        m_windowsSinceRestore = 0;
+        --m_level;
+        return true;
+    }
+    m_calmWindows = 0;
+    return false;
+}
+
+int QosController::analysisScale(int configuredScale, int maxScale) const
+{
+    const int factor = m_level >= QuarterAnalysisResolution ? 4 : m_level == HalfAnalysisResolution ? 2 : 1;
+    return std::min(configuredScale * factor, maxScale);
+}
+
+bool QosController::analyseFrame(qint64 frameIndex) const
+{
+    return m_level < AlternateFrameAnalysis || frameIndex % 2 == 0;
+}
+
+bool QosController::presentFrame(qint64 frameIndex) const
+{
+    return m_level < HalfDisplayRate || frameIndex % 2 == 0;
+}
@@ -0,0 +1,74 @@
+#ifndef QOSCONTROLLER_H
+#define QOSCONTROLLER_H
+
+#include <QtGlobal>
+
+// Adaptive quality for realtime playback. The processing thread reports how long each
+// presented frame kept it busy relative to the frame period; when the average over a
+// short window approaches the budget, quality steps down one level, and once there has
+// been plenty of headroom for a while it steps back up. Levels are cumulative:
+//
+//   Full                       everything as configured
+//   HalfAnalysisResolution     motion computed at half the configured resolution
+//   QuarterAnalysisResolution  ... at a quarter
+//   AlternateFrameAnalysis     masks computed for every other frame only; the frames in
+//                              between feed the detector history and show the last mask
+//   HalfDisplayRate            every other frame is not handed to the display
+//
+// Each step roughly halves the remaining per-frame cost, so restoring waits for the load
+// to drop well below half the budget. A level that had to be given up again right after
+// being restored waits twice as long next time, which stops the controller from
+// oscillating around a load that sits between two levels.
+// Not thread-safe: owned by the processing thread.
+class QosController
+{
+public:
+    enum Level
+    {
+        Full,
+        HalfAnalysisResolution,
+        QuarterAnalysisResolution,
+        AlternateFrameAnalysis,
+        HalfDisplayRate,
+        LevelCount
+    };
+
+    // Frames averaged per decision.
+    static constexpr int kWindowFrames = 15;
+    // Average busy fraction of the frame period above which quality steps down...
+    static constexpr double kDegradeLoad = 0.85;
+    // ... and below which, for kRestoreWindows windows in a row, it steps up again.
+    static constexpr double kRestoreLoad = 0.4;
+    static constexpr int kRestoreWindows = 4;
+    static constexpr int kMaxRestoreWindows = 64;
+
+    // Short description for the status bar.
+    static const char* levelName(int level);
+
+    // Back to Full with no history.
+    void reset();
+    // Drops the frames measured so far (after a pause or seek, whose first frames are
+    // not representative); the level stays.
+    void restartWindow();
+    // busyFraction is the frame's processing time divided by the frame period. Returns
+    // true if the level changed.
+    bool addFrame(double busyFraction);
+
+    int level() const { return m_level; }
+    // Analysis downscale divisor for the current level, given the configured one.
+    int analysisScale(int configuredScale, int maxScale) const;
+    // False for the frames whose mask is not computed at the current level.
+    bool analyseFrame(qint64 frameIndex) const;
+    // False for the frames not shown at the current level.
+    bool presentFrame(qint64 frameIndex) const;
+
+private:
+    int m_level = Full;
+    double m_windowLoad = 0.0; // Sum of busy fractions in the current window
+    int m_windowFrames = 0;
+    int m_calmWindows = 0;     // Consecutive windows below kRestoreLoad
+    int m_restoreWindows = kRestoreWindows;
+    int m_windowsSinceRestore = kRestoreWindows; // Windows since the last step up
+};
+
+#endif // QOSCONTROLLER_H
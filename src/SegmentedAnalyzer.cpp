@@ -0,0 +1,245 @@
+#include "SegmentedAnalyzer.h"
+#include "FrameLayout.h"
+#include "MaskArchive.h"
+#include "Profiler.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+struct SegmentedAnalyzer::SegmentResult
+{
+    std::vector<SegmentedFrame> frames; // Written by the worker until done
+    bool done = false;                  // Guarded by the run() mutex
+    bool ok = false;
+};
+
+bool SegmentedAnalyzer::supportsAlgorithm(MotionAlgorithm algorithm)
+{
+    return algorithm == MotionAlgorithm::FrameDifference || algorithm == MotionAlgorithm::ThreeFrameDifference;
+}
+
+int SegmentedAnalyzer::historyFrames(MotionAlgorithm algorithm, int frameDelta)
+{
+    return algorithm == MotionAlgorithm::ThreeFrameDifference ? 2 * frameDelta : frameDelta;
+}
+
+std::vector<SegmentedAnalyzer::Segment> SegmentedAnalyzer::planSegments(const KeyframeIndex& keyframes, qint64 frameCount,
+                                                                        int segmentCount, qint64 minFrames, qint64 maxFrames)
+{
+    std::vector<Segment> segments;
+    qint64 first = 0;
+    if (frameCount > 0 && (segmentCount > 1 || frameCount > maxFrames)) {
+        const qint64 length = std::clamp(frameCount / std::max(1, segmentCount), minFrames, std::max(minFrames, maxFrames));
+        for (qint64 target = length; target < frameCount; target += length) {
+            const qint64 boundary = keyframes.keyframeAtOrBefore(target);
+            if (boundary - first < minFrames) continue; // Also skips boundaries that did not move
+            if (frameCount - boundary < minFrames) break;
+            segments.push_back({first, boundary});
+            first = boundary;
+        }
+    }
+    segments.push_back({first, -1});
+    return segments;
+}
+
+SegmentedAnalyzer::SegmentedAnalyzer(const SegmentedAnalysisOptions& options)
+    : m_options(options)
+{
+}
+
+bool SegmentedAnalyzer::open(const QString& path)
+{
+    m_path = path;
+    cv::VideoCapture capture(path.toStdString());
+    if (!capture.isOpened()) {
+        qWarning() << "SegmentedAnalyzer: Failed to open" << path;
+        return false;
+    }
+    m_fps = capture.get(cv::CAP_PROP_FPS);
+    if (m_fps <= 0) m_fps = 30.0;
+    m_frameCount = static_cast<qint64>(capture.get(cv::CAP_PROP_FRAME_COUNT));
+    capture.release();
+
+    QElapsedTimer timer;
+    timer.start();
+    const std::atomic<bool> cancel(false);
+    m_keyframes = KeyframeIndex::build(path.toStdString(), cancel);
+    m_workers = m_options.workers > 0 ? m_options.workers : std::max(1, QThread::idealThreadCount());
+    qInfo() << "Keyframe index:" << m_keyframes.keyframeCount() << (m_keyframes.isExact() ? "keyframes" : "approximate seek points")
+            << "in" << timer.elapsed() << "ms";
+    return true;
+}
+
+bool SegmentedAnalyzer::analyzeSegment(const Segment& segment, const std::atomic<bool>& cancel,
+                                       const std::atomic<bool>& aborted, SegmentResult& result) const
+{
+    std::vector<int> captureParams;
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 7)
+    // One decoder thread per worker; the workers themselves fill the cores.
+    captureParams = {cv::CAP_PROP_N_THREADS, 1};
+#endif
+    cv::VideoCapture capture;
+    if (!capture.open(m_path.toStdString(), cv::CAP_ANY, captureParams)) {
+        qWarning() << "SegmentedAnalyzer: Failed to open" << m_path;
+        return false;
+    }
+    // Luma is all the analysis needs; see VideoProcessor::setLumaOnlyDecode().
+    capture.set(cv::CAP_PROP_CONVERT_RGB, 0);
+    const int codecPixelFormat = static_cast<int>(capture.get(cv::CAP_PROP_CODEC_PIXEL_FORMAT));
+    const int height = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+
+    // Decode from the keyframe before the history so every frame decodes cleanly; frames
+    // before the history are only grabbed.
+    const qint64 historyStart =
+        std::max<qint64>(0, segment.first - historyFrames(m_options.algorithm, m_options.frameDelta));
+    qint64 frame = m_keyframes.keyframeAtOrBefore(historyStart);
+    if (frame > 0 && !capture.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(frame))) {
+        // Past the end is fine for the last segment (the frame count was an overestimate);
+        // anywhere else the merged output would have a hole.
+        if (segment.end < 0) return true;
+        qWarning() << "SegmentedAnalyzer: Failed to seek to frame" << frame << "in" << m_path;
+        return false;
+    }
+
+    std::unique_ptr<MotionDetector> detector = createMotionDetector(m_options.algorithm, m_options.frameDelta);
+    MotionParams params;
+    params.frameDelta = m_options.frameDelta;
+    params.threshold = m_options.motionThreshold;
+    BlobExtractor extractor;
+    cv::Mat image;
+    cv::Mat scaled;
+    cv::Mat mask;
+
+    for (; segment.end < 0 || frame < segment.end; ++frame) {
+        if (cancel.load() || aborted.load()) return false;
+        if (frame < historyStart) {
+            if (!capture.grab()) return true;
+            continue;
+        }
+        {
+            ProfileScope scope(ProfileStage::Decode);
+            if (!capture.read(image) || image.empty()) return true;
+        }
+        FrameLayout layout;
+        if (!detectFrameLayout(image, height, codecPixelFormat, layout)) {
+            qWarning() << "SegmentedAnalyzer: unsupported frame layout in" << m_path;
+            return false;
+        }
+        cv::Mat input = lumaView(image, layout, height);
+        if (m_options.analysisScale > 1) {
+            // Same downscale as VideoProcessor's analysis input.
+            cv::resize(input, scaled,
+                       cv::Size(std::max(1, input.cols / m_options.analysisScale),
+                                std::max(1, input.rows / m_options.analysisScale)),
+                       0, 0, cv::INTER_AREA);
+            input = scaled;
+        }
+
+        if (frame < segment.first) {
+            ProfileScope scope(ProfileStage::Motion);
+            detector->learn(input, params); // Overlap with the previous segment
+            continue;
+        }
+        {
+            ProfileScope scope(ProfileStage::Motion);
+            detector->detect(input, params, mask);
+        }
+
+        SegmentedFrame& out = result.frames.emplace_back();
+        {
+            ProfileScope scope(ProfileStage::Stats);
+            out.stats.frameIndex = frame;
+            extractor.extract(mask, m_options.minBlobArea, m_options.analysisScale, out.stats);
+        }
+        if (!mask.empty()) {
+            out.maskSize = mask.size();
+            if (m_options.keepMasks) encodeMaskBlocks(mask, out.maskBlocks);
+        }
+    }
+    return true;
+}
+
+bool SegmentedAnalyzer::run(const FrameSink& sink, const std::atomic<bool>& cancel)
+{
+    if (!supportsAlgorithm(m_options.algorithm)) {
+        qWarning() << "SegmentedAnalyzer:" << motionAlgorithmName(m_options.algorithm)
+                   << "keeps unbounded history and cannot be split into segments.";
+        return false;
+    }
+
+    const std::vector<Segment> segments =
+        planSegments(m_keyframes, m_frameCount, m_workers * kSegmentsPerWorker, kMinSegmentFrames, kMaxSegmentFrames);
+    const int workers = std::min<int>(m_workers, static_cast<int>(segments.size()));
+    qInfo() << "Analysing" << m_path << "as" << segments.size() << "segments on" << workers << "workers";
+
+    std::vector<SegmentResult> results(segments.size());
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t nextSegment = 0; // Guarded by mutex
+    size_t merged = 0;      // Guarded by mutex
+    bool failed = false;    // Guarded by mutex
+    std::atomic<bool> aborted(false); // failed, for the workers' frame loops
+    // Workers stay this many segments ahead of the merge at most.
+    const size_t maxAhead = 2 * static_cast<size_t>(workers);
+    // cancel is set from outside without notifying, so waits poll it.
+    constexpr auto kPollInterval = std::chrono::milliseconds(100);
+
+    auto workerLoop = [&](int index) {
+        Profiler::setThreadName(("segment-" + std::to_string(index)).c_str());
+        while (true) {
+            size_t segment;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (!failed && !cancel.load() && nextSegment < segments.size() && nextSegment >= merged + maxAhead) {
+                    changed.wait_for(lock, kPollInterval);
+                }
+                if (failed || cancel.load() || nextSegment >= segments.size()) return;
+                segment = nextSegment++;
+            }
+            const bool ok = analyzeSegment(segments[segment], cancel, aborted, results[segment]);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[segment].done = true;
+                results[segment].ok = ok;
+                if (!ok) failed = true;
+            }
+            if (!ok) aborted = true;
+            changed.notify_all();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < workers; ++i) threads.emplace_back(workerLoop, i);
+
+    // Merge in order on this thread while the workers carry on with later segments.
+    bool ok = true;
+    for (size_t i = 0; i < segments.size() && ok; ++i) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!results[i].done && !failed && !cancel.load()) changed.wait_for(lock, kPollInterval);
+            ok = results[i].done && results[i].ok;
+        }
+        if (!ok) break;
+        for (const SegmentedFrame& frame : results[i].frames) sink(frame);
+        std::vector<SegmentedFrame>().swap(results[i].frames);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            merged = i + 1;
+        }
+        changed.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!ok) failed = true;
+    }
+    if (!ok) aborted = true;
+    changed.notify_all();
+    for (std::thread& thread : threads) thread.join();
+    return ok && !cancel.load();
+}
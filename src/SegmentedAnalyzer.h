@@ -0,0 +1,104 @@
+#ifndef SEGMENTEDANALYZER_H
+#define SEGMENTEDANALYZER_H
+
+#include <QString>
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "KeyframeIndex.h"
+#include "MotionDetector.h"
+#include "MotionStats.h"
+
+struct SegmentedAnalysisOptions
+{
+    int frameDelta = 3;
+    int motionThreshold = 30;
+    MotionAlgorithm algorithm = MotionAlgorithm::FrameDifference;
+    int analysisScale = 1;
+    int minBlobArea = 16;
+    int workers = 0;        // 0 = one per core
+    bool keepMasks = false; // Encode each mask (encodeMaskBlocks) for the sink
+};
+
+// Result of one frame, handed to the sink in frame order.
+struct SegmentedFrame
+{
+    MotionStats stats;
+    cv::Size maskSize;      // Empty while the history is too short (no mask)
+    std::string maskBlocks; // encodeMaskBlocks() output, if keepMasks
+};
+
+// Analyses one long file on all cores instead of strictly in order.
+//
+// The file is cut into segments that start on keyframes, and workers (each with its
+// own cv::VideoCapture decoding on one thread, and its own detector) analyse segments
+// concurrently. A worker starts decoding at the keyframe before its segment and feeds
+// the historyFrames() frames in front of the segment to the detector without emitting
+// them, so every mask is identical to the one a sequential run produces. That only
+// works for detectors whose mask depends on a bounded history, i.e. frame and
+// three-frame difference.
+//
+// Results are merged in frame order on the thread calling run(). There are several
+// segments per worker, handed out in order, and workers stay at most a few segments
+// ahead of the merge. Segments are at most about kMaxSegmentFrames long, so a longer
+// file gets more segments rather than longer ones and the results held at any time are
+// O(workers x kMaxSegmentFrames) frames, however long the file is.
+class SegmentedAnalyzer
+{
+public:
+    struct Segment
+    {
+        qint64 first = 0;
+        qint64 end = -1; // One past the last frame; -1 = to the end of the file
+    };
+
+    using FrameSink = std::function<void(const SegmentedFrame& frame)>;
+
+    // Shorter segments would spend too much of their time on the history overlap.
+    static constexpr qint64 kMinSegmentFrames = 600;
+    // Caps what a segment buffers until it is merged (a minute at 30 fps).
+    static constexpr qint64 kMaxSegmentFrames = 1800;
+
+    static bool supportsAlgorithm(MotionAlgorithm algorithm);
+    // Frames in front of a segment the detector must have seen.
+    static int historyFrames(MotionAlgorithm algorithm, int frameDelta);
+    // Splits [0, frameCount) into about segmentCount keyframe-aligned segments of
+    // minFrames to maxFrames frames (more segments if needed to stay under maxFrames; a
+    // segment only exceeds it by up to one GOP). The last one runs to the end of the file.
+    static std::vector<Segment> planSegments(const KeyframeIndex& keyframes, qint64 frameCount, int segmentCount,
+                                             qint64 minFrames, qint64 maxFrames);
+
+    explicit SegmentedAnalyzer(const SegmentedAnalysisOptions& options);
+
+    // Reads the video properties and builds the keyframe index (I/O bound, blocking).
+    bool open(const QString& path);
+    double fps() const { return m_fps; }
+    qint64 frameCount() const { return m_frameCount; }
+    int workerCount() const { return m_workers; }
+
+    // Blocking: analyses the whole file and calls sink for every frame, in order, on the
+    // calling thread. Returns false if a segment could not be read or cancel was set.
+    bool run(const FrameSink& sink, const std::atomic<bool>& cancel);
+
+private:
+    struct SegmentResult;
+
+    // Segments per worker, so a slow segment does not leave the other cores idle at the end.
+    static constexpr int kSegmentsPerWorker = 4;
+
+    // aborted is set once another segment has failed.
+    bool analyzeSegment(const Segment& segment, const std::atomic<bool>& cancel, const std::atomic<bool>& aborted,
+                        SegmentResult& result) const;
+
+    SegmentedAnalysisOptions m_options;
+    QString m_path;
+    KeyframeIndex m_keyframes;
+    double m_fps = 0.0;
+    qint64 m_frameCount = 0;
+    int m_workers = 1;
+};
+
+#endif // SEGMENTEDANALYZER_H
@@ -0,0 +1,81 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// tryPush() may only be called by the producer, tryPop() only by the consumer;
+// size() is an approximation that is safe to call from anywhere.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        : m_capacity(capacity > 0 ? capacity : 1),
+          m_slots(m_capacity)
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Moves value into the queue. Returns false (leaving value untouched) when full.
+    bool tryPush(T&& value)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_headCache >= m_capacity) {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail - m_headCache >= m_capacity) {
+                return false;
+            }
+        }
+        m_slots[tail % m_capacity] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Moves the oldest element into out. Returns false when empty.
+    bool tryPop(T& out)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tailCache) {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tailCache) {
+                return false;
+            }
+        }
+        T& slot = m_slots[head % m_capacity];
+        out = std::move(slot);
+        slot = T(); // Drop anything the moved-from slot still references
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const
+    {
+        const size_t head = m_head.load(std::memory_order_acquire);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    size_t capacity() const { return m_capacity; }
+
+private:
+    static constexpr size_t kCacheLine = 64;
+
+    const size_t m_capacity;
+    std::vector<T> m_slots;
+
+    // Producer side: write index plus a cached copy of the consumer's read index.
+    alignas(kCacheLine) std::atomic<size_t> m_tail{0};
+    size_t m_headCache = 0;
+
+    // Consumer side: read index plus a cached copy of the producer's write index.
+    alignas(kCacheLine) std::atomic<size_t> m_head{0};
+    size_t m_tailCache = 0;
+};
+
+#endif // SPSCQUEUE_H
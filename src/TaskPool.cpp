@@ -0,0 +1,96 @@
+#include "TaskPool.h"
+#include "Profiler.h"
+#include <QThread>
+#include <algorithm>
+#include <string>
+
+namespace {
+
+// Pool and worker index of the calling thread, so submit() from a task stays local.
+thread_local const TaskPool* t_pool = nullptr;
+thread_local int t_workerIndex = -1;
+
+} // namespace
+
+TaskPool::TaskPool(int threads)
+{
+    const int count = threads > 0 ? threads : std::max(1, QThread::idealThreadCount());
+    for (int i = 0; i < count; ++i) m_workers.push_back(std::make_unique<Worker>());
+    for (int i = 0; i < count; ++i) m_threads.emplace_back([this, i] { workerLoop(i); });
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) thread.join();
+}
+
+void TaskPool::submit(Task task)
+{
+    const int workers = static_cast<int>(m_workers.size());
+    const int index = t_pool == this ? t_workerIndex
+                                     : static_cast<int>(m_nextWorker.fetch_add(1, std::memory_order_relaxed) % workers);
+    {
+        std::lock_guard<std::mutex> lock(m_workers[index]->mutex);
+        m_workers[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_idleMutex);
+        m_queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_wake.notify_one();
+}
+
+bool TaskPool::popLocal(int index, Task& task)
+{
+    Worker& worker = *m_workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) return false;
+    task = std::move(worker.tasks.front());
+    worker.tasks.pop_front();
+    return true;
+}
+
+bool TaskPool::steal(int index, Task& task)
+{
+    const int workers = static_cast<int>(m_workers.size());
+    for (int offset = 1; offset < workers; ++offset) {
+        Worker& victim = *m_workers[(index + offset) % workers];
+        std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || victim.tasks.empty()) continue;
+        task = std::move(victim.tasks.back());
+        victim.tasks.pop_back();
+        m_steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void TaskPool::workerLoop(int index)
+{
+    t_pool = this;
+    t_workerIndex = index;
+    Profiler::setThreadName(("pool-" + std::to_string(index)).c_str());
+
+    Task task;
+    while (true) {
+        if (popLocal(index, task) || steal(index, task)) {
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            task = nullptr;
+            m_tasksRun.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_idleMutex);
+        if (m_stopping) break;
+        // A victim that was busy (try_lock failed) still counts as queued: retry instead.
+        if (m_queued.load(std::memory_order_relaxed) > 0) continue;
+        m_wake.wait(lock, [this] { return m_stopping || m_queued.load(std::memory_order_relaxed) > 0; });
+        if (m_stopping) break;
+    }
+}
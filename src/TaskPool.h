@@ -0,0 +1,72 @@
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size work-stealing thread pool for many small, independent tasks (e.g. one
+// decode + analysis step of one of many streams).
+//
+// Every worker has its own task deque. submit() from a worker appends to that worker's
+// deque, so a task that schedules its follow-up keeps it on the same core; submit()
+// from any other thread spreads tasks round-robin. Workers take their own tasks oldest
+// first, which keeps scheduling fair when tasks resubmit themselves, and an idle worker
+// steals the newest task from the back of another worker's deque before going to sleep.
+// The deques are short and each has its own mutex, so there is no global queue lock
+// for the workers to contend on.
+class TaskPool
+{
+public:
+    using Task = std::function<void()>;
+
+    // threads = 0: one per core.
+    explicit TaskPool(int threads = 0);
+    // Waits for running tasks; tasks still queued are dropped.
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    // Thread-safe, also from inside a task.
+    void submit(Task task);
+
+    int threadCount() const { return static_cast<int>(m_threads.size()); }
+    // Tasks a worker took from another worker's deque.
+    quint64 steals() const { return m_steals.load(std::memory_order_relaxed); }
+    quint64 tasksRun() const { return m_tasksRun.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks; // Guarded by mutex
+    };
+
+    void workerLoop(int index);
+    bool popLocal(int index, Task& task);
+    bool steal(int index, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+
+    // Sleeping: m_queued counts tasks in all deques. A worker only sleeps after seeing it
+    // at zero under m_idleMutex, and submit() bumps it before notifying under the same
+    // mutex, so no wake-up is lost.
+    std::mutex m_idleMutex;
+    std::condition_variable m_wake;
+    std::atomic<int> m_queued{0};
+    bool m_stopping = false; // Guarded by m_idleMutex
+
+    std::atomic<unsigned> m_nextWorker{0};
+    std::atomic<quint64> m_steals{0};
+    std::atomic<quint64> m_tasksRun{0};
+};
+
+#endif // TASKPOOL_H
@@ -1,4 +1,5 @@
 #include "VideoDisplayWidget.h"
+#include "Profiler.h"
 #include <QDebug>
 
 VideoDisplayWidget::VideoDisplayWidget(QWidget *parent) : QWidget(parent)
@@ -7,14 +8,28 @@ VideoDisplayWidget::VideoDisplayWidget(QWidget *parent) : QWidget(parent)
     setMinimumSize(320, 240);
 }
 
+QSize VideoDisplayWidget::targetFrameSize() const
+{
+    return size() * devicePixelRatioF();
+}
+
 void VideoDisplayWidget::setFrame(const cv::Mat& frame)
 {
-    std::lock_guard<std::mutex> lock(m_pixmapMutex);
+    std::lock_guard<std::mutex> lock(m_imageMutex);
 
     if (frame.empty())
     {
-        // Clear the pixmap if the frame is empty
-        m_pixmap = QPixmap();
+        // Clear the image if the frame is empty
+        m_frame.release();
+        m_image = QImage();
+    }
+    else if (frame.type() == CV_8UC4)
+    {
+        // Already in display format: BGRA in memory is QImage::Format_RGB32 on little-endian
+        // (and Qt ignores the alpha byte). Wrap it; m_frame keeps the buffer alive.
+        m_frame = frame;
+        m_image = QImage(m_frame.data, m_frame.cols, m_frame.rows, static_cast<int>(m_frame.step), QImage::Format_RGB32);
+        m_image.setDevicePixelRatio(devicePixelRatioF());
     }
     else
     {
@@ -30,13 +45,14 @@ void VideoDisplayWidget::setFrame(const cv::Mat& frame)
         else
         {
             qWarning() << "VideoDisplayWidget::setFrame: Unsupported cv::Mat type:" << frame.type();
-            m_pixmap = QPixmap(); // unsupported format
+            m_frame.release();
+            m_image = QImage(); // unsupported format
             return;
         }
 
         // cv::Mat might be temporary or change.
-        QImage qimg(frame.data, frame.cols, frame.rows, static_cast<int>(frame.step), format);
-        m_pixmap = QPixmap::fromImage(qimg.copy());
+        m_frame.release();
+        m_image = QImage(frame.data, frame.cols, frame.rows, static_cast<int>(frame.step), format).copy();
     }
 
     // Sched a repaint
@@ -44,17 +60,25 @@ void VideoDisplayWidget::setFrame(const cv::Mat& frame)
 }
 
 void VideoDisplayWidget::clear() {
-    std::lock_guard<std::mutex> lock(m_pixmapMutex);
-    m_pixmap = QPixmap();
+    std::lock_guard<std::mutex> lock(m_imageMutex);
+    m_frame.release();
+    m_image = QImage();
     this->update();
 }
 
+void VideoDisplayWidget::resizeEvent(QResizeEvent* event)
+{
+    QWidget::resizeEvent(event);
+    emit targetFrameSizeChanged(targetFrameSize());
+}
+
 void VideoDisplayWidget::paintEvent(QPaintEvent* event)
 {
-    std::lock_guard<std::mutex> lock(m_pixmapMutex);
+    ProfileScope scope(ProfileStage::Paint);
+    std::lock_guard<std::mutex> lock(m_imageMutex);
     QPainter painter(this);
 
-    if (m_pixmap.isNull())
+    if (m_image.isNull())
     {
         // placeholder
         painter.fillRect(this->rect(), Qt::black);
@@ -63,8 +87,8 @@ void VideoDisplayWidget::paintEvent(QPaintEvent* event)
     }
     else
     {
-        // Draw
-        painter.drawPixmap(this->rect(), m_pixmap, m_pixmap.rect());
+        // Draw. Frames prepared at targetFrameSize() cover rect() exactly and are blitted unscaled.
+        painter.drawImage(QRectF(this->rect()), m_image);
     }
     QWidget::paintEvent(event);
-}
\ No newline at end of file
+}
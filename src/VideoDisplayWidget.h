@@ -2,9 +2,11 @@
 #define VIDEODISPLAYWIDGET_H
 
 #include <QWidget>
-#include <QPixmap>
+#include <QImage>
 #include <QPainter>
 #include <QPaintEvent>
+#include <QResizeEvent>
+#include <QSize>
 #include <opencv2/opencv.hpp>
 #include <mutex>
 
@@ -16,16 +18,26 @@ public:
     explicit VideoDisplayWidget(QWidget *parent = nullptr);
     ~VideoDisplayWidget() override = default;
 
+    // Size in device pixels that a frame must have to be drawn without scaling.
+    QSize targetFrameSize() const;
+
 public slots:
+    // CV_8UC4 (BGRA, e.g. prepared by VideoProcessor at targetFrameSize()) is shown
+    // without copying; CV_8UC3 and CV_8UC1 are converted and copied on this thread.
     void setFrame(const cv::Mat& frame);
     void clear();
 
+signals:
+    void targetFrameSizeChanged(const QSize& size);
+
 protected:
     void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
 
 private:
-    QPixmap m_pixmap;
-    std::mutex m_pixmapMutex;
+    cv::Mat m_frame;  // Keeps the pixels that m_image points into alive
+    QImage m_image;
+    std::mutex m_imageMutex;
 };
 
-#endif // VIDEODISPLAYWIDGET_H
\ No newline at end of file
+#endif // VIDEODISPLAYWIDGET_H
@@ -0,0 +1,197 @@
+#include "VideoExporter.h"
+#include <QDebug>
+#include <QFileInfo>
+
+namespace {
+
+// Share of the tint colour in moving pixels of the overlay.
+constexpr double kTintWeight = 0.5;
+
+} // namespace
+
+bool openVideoWriter(cv::VideoWriter& writer, const QString& path, double fps, const cv::Size& size, bool isColor)
+{
+    const std::string file = path.toStdString();
+    const bool avi = QFileInfo(path).suffix().compare("avi", Qt::CaseInsensitive) == 0;
+    const int primary = avi ? cv::VideoWriter::fourcc('M', 'J', 'P', 'G') : cv::VideoWriter::fourcc('a', 'v', 'c', '1');
+    const int fallback = cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+    return writer.open(file, primary, fps, size, isColor) || (!avi && writer.open(file, fallback, fps, size, isColor));
+}
+
+VideoExporter::VideoExporter(Content content)
+    : m_content(content)
+{
+}
+
+VideoExporter::~VideoExporter()
+{
+    close();
+}
+
+bool VideoExporter::open(const QString& path, double fps, bool waitWhenBehind)
+{
+    close();
+    if (path.isEmpty()) return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_path = path;
+    m_fps = fps > 0 ? fps : 30.0;
+    m_waitWhenBehind = waitWhenBehind;
+    m_queue.clear();
+    m_frameSize = cv::Size();
+    m_pendingBlankFrames = 0;
+    m_framesWritten = 0;
+    m_producerStalls = 0;
+    m_framesDropped = 0;
+    m_failed = false;
+    m_open = true;
+    m_closing = false;
+    m_thread = std::thread([this] { encoderLoop(); });
+    return true;
+}
+
+bool VideoExporter::isOpen() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_open;
+}
+
+QString VideoExporter::path() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_path;
+}
+
+void VideoExporter::submit(const cv::Mat& frame, FrameLayout layout, const cv::Mat& mask)
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_open || m_failed.load(std::memory_order_relaxed)) return;
+        if (m_queue.size() >= kQueueCapacity) {
+            if (!m_waitWhenBehind) {
+                m_framesDropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            m_producerStalls.fetch_add(1, std::memory_order_relaxed);
+            m_itemTaken.wait(lock, [this] { return !m_open || m_queue.size() < kQueueCapacity; });
+            if (!m_open) return;
+        }
+        // Only references: the decoder allocates a new image per frame and the mask is
+        // never written after it is emitted.
+        m_queue.push_back({frame, layout, mask});
+    }
+    m_itemQueued.notify_one();
+}
+
+void VideoExporter::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_open) return;
+        m_open = false;
+        m_closing = true;
+    }
+    m_itemQueued.notify_one();
+    m_itemTaken.notify_all(); // Release a producer blocked on a full queue
+    m_thread.join();
+
+    if (m_failed.load()) {
+        qWarning() << "Video export to" << m_path << "failed after" << framesWritten() << "frames";
+    } else {
+        qInfo() << "Exported" << framesWritten() << "frames to" << m_path
+                << "(" << producerStalls() << "producer stalls," << framesDropped() << "frames dropped )";
+    }
+}
+
+void VideoExporter::encoderLoop()
+{
+    Item item;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_itemQueued.wait(lock, [this] { return m_closing || !m_queue.empty(); });
+            if (m_queue.empty()) break; // Closing and drained
+            item = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        m_itemTaken.notify_one();
+
+        if (!m_failed.load(std::memory_order_relaxed)) encode(item);
+        item = Item(); // Let go of the frame before waiting for the next one
+    }
+
+    m_writer.release();
+    m_colorScratch.release();
+    m_bgr.release();
+    m_mask.release();
+    m_tinted.release();
+}
+
+bool VideoExporter::openWriter(const cv::Size& size, bool isColor)
+{
+    if (!openVideoWriter(m_writer, m_path, m_fps, size, isColor)) {
+        qWarning() << "Failed to create video file:" << m_path;
+        m_failed = true;
+        return false;
+    }
+    m_frameSize = size;
+    return true;
+}
+
+void VideoExporter::encode(const Item& item)
+{
+    if (m_content == Content::Mask) {
+        if (item.mask.empty()) {
+            if (m_writer.isOpened()) {
+                m_mask.create(m_frameSize, CV_8UC1);
+                m_mask.setTo(0);
+                m_writer.write(m_mask);
+                m_framesWritten.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                ++m_pendingBlankFrames; // Written once the first mask gives the size
+            }
+            return;
+        }
+        if (!m_writer.isOpened()) {
+            if (!openWriter(item.mask.size(), false)) return;
+            m_mask = cv::Mat::zeros(m_frameSize, CV_8UC1);
+            for (; m_pendingBlankFrames > 0; --m_pendingBlankFrames) {
+                m_writer.write(m_mask);
+                m_framesWritten.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        // The analysis scale may change mid-run; the file keeps its first size.
+        const cv::Mat* mask = &item.mask;
+        if (item.mask.size() != m_frameSize) {
+            cv::resize(item.mask, m_mask, m_frameSize, 0, 0, cv::INTER_NEAREST);
+            mask = &m_mask;
+        }
+        m_writer.write(*mask);
+        m_framesWritten.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Overlay: the frame in BGR at source size, moving pixels blended towards red.
+    const cv::Mat& image = displayImage(item.frame, item.layout, m_colorScratch);
+    if (image.channels() == 4) cv::cvtColor(image, m_bgr, cv::COLOR_BGRA2BGR);
+    else if (image.channels() == 1) cv::cvtColor(image, m_bgr, cv::COLOR_GRAY2BGR);
+    else image.copyTo(m_bgr);
+
+    if (!m_writer.isOpened() && !openWriter(m_bgr.size(), true)) return;
+    if (m_bgr.size() != m_frameSize) {
+        cv::resize(m_bgr, m_tinted, m_frameSize, 0, 0, cv::INTER_AREA);
+        std::swap(m_bgr, m_tinted);
+    }
+
+    if (!item.mask.empty()) {
+        const cv::Mat* mask = &item.mask;
+        if (item.mask.size() != m_frameSize) {
+            cv::resize(item.mask, m_mask, m_frameSize, 0, 0, cv::INTER_NEAREST);
+            mask = &m_mask;
+        }
+        m_tinted = m_bgr * (1.0 - kTintWeight) + cv::Scalar(0, 0, 255 * kTintWeight);
+        m_tinted.copyTo(m_bgr, *mask);
+    }
+    m_writer.write(m_bgr);
+    m_framesWritten.fetch_add(1, std::memory_order_relaxed);
+}
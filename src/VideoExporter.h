@@ -0,0 +1,110 @@
+#ifndef VIDEOEXPORTER_H
+#define VIDEOEXPORTER_H
+
+#include "FrameLayout.h"
+#include <QString>
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Encodes analysed frames to a video file on a dedicated encoder thread. submit() only
+// queues references to the decoded frame and its mask; colour conversion, mask
+// scaling, tinting and encoding all happen on the encoder thread. The queue is bounded.
+// When the encoder falls behind, submit() drops the frame (counted in framesDropped()),
+// so realtime playback never waits on the encoder. Opened with waitWhenBehind (headless
+// analysis, which has no clock to keep), submit() blocks until a slot frees up instead,
+// so a slow encoder throttles analysis and every frame is written.
+//
+// Frames are written in submission order, one per analysed frame; after a seek the
+// output simply continues with the frames from the new position.
+//
+// open(), submit() and close() may be called from different threads, but submit() is
+// meant for a single producer (the processing thread).
+class VideoExporter
+{
+public:
+    enum class Content
+    {
+        Mask,   // Binary motion mask at analysis resolution, gray
+        Overlay // Original frame with moving pixels tinted red
+    };
+
+    // Frames the encoder may lag behind before submit() drops or blocks.
+    static constexpr size_t kQueueCapacity = 16;
+
+    explicit VideoExporter(Content content);
+    ~VideoExporter();
+
+    VideoExporter(const VideoExporter&) = delete;
+    VideoExporter& operator=(const VideoExporter&) = delete;
+
+    // Starts the encoder thread. The file is created on the first frame, once its size is
+    // known; the codec follows the extension (.avi: MJPG, otherwise H.264 with an MPEG-4
+    // Part 2 fallback). Closes any previous file.
+    bool open(const QString& path, double fps, bool waitWhenBehind = false);
+    // mask may be empty (no history yet); the mask video then gets a black frame.
+    // Drops the frame, or blocks with waitWhenBehind, while the queue is full. Does
+    // nothing when closed.
+    void submit(const cv::Mat& frame, FrameLayout layout, const cv::Mat& mask);
+    // Encodes everything queued so far, finalises the file and stops the thread.
+    void close();
+
+    bool isOpen() const;
+    Content content() const { return m_content; }
+    QString path() const;
+    quint64 framesWritten() const { return m_framesWritten.load(std::memory_order_relaxed); }
+    // Calls to submit() that had to wait for the encoder (waitWhenBehind only).
+    quint64 producerStalls() const { return m_producerStalls.load(std::memory_order_relaxed); }
+    // Frames not written because the encoder was behind (without waitWhenBehind).
+    quint64 framesDropped() const { return m_framesDropped.load(std::memory_order_relaxed); }
+    // False once the encoder failed to create or write the file; later frames are dropped.
+    bool hasFailed() const { return m_failed.load(std::memory_order_relaxed); }
+
+private:
+    struct Item
+    {
+        cv::Mat frame;
+        FrameLayout layout = FrameLayout::Bgr;
+        cv::Mat mask;
+    };
+
+    void encoderLoop();
+    void encode(const Item& item);
+    bool openWriter(const cv::Size& size, bool isColor);
+
+    const Content m_content;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_itemQueued;
+    std::condition_variable m_itemTaken;
+    std::deque<Item> m_queue; // Guarded by m_mutex
+    bool m_open = false;
+    bool m_closing = false;
+    bool m_waitWhenBehind = false;
+    QString m_path;
+    double m_fps = 30.0;
+    std::thread m_thread;
+
+    // Encoder thread only
+    cv::VideoWriter m_writer;
+    cv::Size m_frameSize;
+    qint64 m_pendingBlankFrames = 0; // Empty masks seen before the mask size was known
+    cv::Mat m_colorScratch;
+    cv::Mat m_bgr;
+    cv::Mat m_mask;
+    cv::Mat m_tinted;
+
+    std::atomic<quint64> m_framesWritten{0};
+    std::atomic<quint64> m_producerStalls{0};
+    std::atomic<quint64> m_framesDropped{0};
+    std::atomic<bool> m_failed{false};
+};
+
+// Opens writer with the codec chosen by the extension of path: .avi gets MJPG,
+// everything else H.264 with an MPEG-4 Part 2 fallback.
+bool openVideoWriter(cv::VideoWriter& writer, const QString& path, double fps, const cv::Size& size, bool isColor);
+
+#endif // VIDEOEXPORTER_H
@@ -0,0 +1,46 @@
+#include "VideoProbeCache.h"
+#include <QFileInfo>
+
+VideoProbeCache& VideoProbeCache::shared()
+{
+    static VideoProbeCache cache;
+    return cache;
+}
+
+bool VideoProbeCache::lookup(const QString& path, VideoProbe& probe)
+{
+    // One stat outside the lock; far cheaper than opening the container.
+    const QFileInfo info(path);
+    if (!info.exists()) return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto found = m_entries.find(info.absoluteFilePath());
+    if (found == m_entries.end()) return false;
+    Entry& entry = *found;
+    if (entry.fileSize != info.size() || entry.modified != info.lastModified()) return false;
+    entry.lastUse = ++m_useCounter;
+    probe = entry.probe;
+    return true;
+}
+
+void VideoProbeCache::insert(const QString& path, const VideoProbe& probe)
+{
+    const QFileInfo info(path);
+    if (!info.exists()) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const QString key = info.absoluteFilePath();
+    if (!m_entries.contains(key) && m_entries.size() >= kMaxEntries) {
+        // Full: drop the least recently used entry.
+        auto oldest = m_entries.begin();
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            if (it->lastUse < oldest->lastUse) oldest = it;
+        }
+        m_entries.erase(oldest);
+    }
+    Entry& entry = m_entries[key];
+    entry.fileSize = info.size();
+    entry.modified = info.lastModified();
+    entry.probe = probe;
+    entry.lastUse = ++m_useCounter;
+}
@@ -0,0 +1,48 @@
+#ifndef VIDEOPROBECACHE_H
+#define VIDEOPROBECACHE_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QString>
+#include <QtGlobal>
+#include <mutex>
+
+// Container properties read when a video is opened.
+struct VideoProbe
+{
+    double fps = 0.0; // As reported; 0 if the container does not say
+    int width = 0;
+    int height = 0;
+    qint64 frameCount = 0;
+};
+
+// Process-wide cache of VideoProbe results by file, so reopening a recording shows its
+// size and length before the (possibly slow, e.g. network-mounted) open completes. An
+// entry is only used while the file's size and modification time are unchanged.
+// Thread-safe.
+class VideoProbeCache
+{
+public:
+    static constexpr int kMaxEntries = 256;
+
+    static VideoProbeCache& shared();
+
+    // On a hit, probe is set and the entry becomes most recently used.
+    bool lookup(const QString& path, VideoProbe& probe);
+    void insert(const QString& path, const VideoProbe& probe);
+
+private:
+    struct Entry
+    {
+        qint64 fileSize = 0;
+        QDateTime modified;
+        VideoProbe probe;
+        quint64 lastUse = 0;
+    };
+
+    std::mutex m_mutex;
+    QHash<QString, Entry> m_entries; // By absolute path; guarded by m_mutex
+    quint64 m_useCounter = 0;
+};
+
+#endif // VIDEOPROBECACHE_H
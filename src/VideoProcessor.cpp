@@ -1,15 +1,63 @@
 #include "VideoProcessor.h"
+#include "MotionKernel.h"
+#include "Profiler.h"
+#include "VideoProbeCache.h"
 #include <QDebug>
+#include <QRegularExpression>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <thread>
 
 VideoProcessor::VideoProcessor(QObject *parent)
     : QObject(parent),
+      m_openGeneration(0),
+      m_openPending(false),
+      m_openThreads(0),
+      m_cancelOpen(std::make_shared<std::atomic<bool>>(false)),
+      m_opened(false),
+      m_captureLumaOnly(false),
+      m_capturePosition(0),
       m_stopRequested(false),
       m_pauseRequested(false),
       m_frameDelta(3),
+      m_deltaSetVersion(0),
+      m_deltaGridDisplay(true),
       m_motionThreshold(30),
+      m_motionAlgorithm(MotionAlgorithm::FrameDifference),
+      m_realtimePlayback(true),
+      m_adaptiveQuality(true),
+      m_analyseEveryFrame(false),
+      m_analysisThreads(0),
+      m_analysisScale(1),
+      m_lumaOnlyDecode(false),
+      m_motionStatsEnabled(false),
+      m_minBlobArea(16),
+      m_playbackSpeed(1.0),
+      m_heatmapEnabled(false),
+      m_heatmapSeconds(10.0),
       m_fps(0.0),
       m_videoWidth(0),
       m_videoHeight(0),
+      m_codecPixelFormat(0),
+      m_frameCount(0),
+      m_seekTarget(0),
+      m_seekGeneration(0),
+      m_cancelKeyframeIndex(false),
+      m_frameQueue(kFrameQueueCapacity),
+      m_gopCache(kGopCacheBytes),
+      m_gopCacheBytes(0),
+      m_decoderFinished(false),
+      m_decoderStopRequested(false),
+      m_framesDecoded(0),
+      m_framesAnalyzed(0),
+      m_decoderStalls(0),
+      m_analysisStalls(0),
+      m_framesSkipped(0),
+      m_displayWakePending(false),
+      m_displayWidth(0),
+      m_displayHeight(0),
       m_thread(new QThread(this))
 {
     this->moveToThread(m_thread);
@@ -25,6 +73,45 @@ VideoProcessor::~VideoProcessor()
 {
     qInfo() << "VideoProcessor destructor called";
     stop(); // STOP FOR CLEAN!
+    waitForOpenThreads();
+    stopKeyframeIndexBuild();
+}
+
+PipelineStats VideoProcessor::pipelineStats() const
+{
+    PipelineStats stats;
+    stats.queueDepth = m_frameQueue.size();
+    stats.queueCapacity = m_frameQueue.capacity();
+    stats.framesDecoded = m_framesDecoded.load(std::memory_order_relaxed);
+    stats.framesAnalyzed = m_framesAnalyzed.load(std::memory_order_relaxed);
+    stats.decoderStalls = m_decoderStalls.load(std::memory_order_relaxed);
+    stats.analysisStalls = m_analysisStalls.load(std::memory_order_relaxed);
+    stats.framesSkipped = m_framesSkipped.load(std::memory_order_relaxed);
+    stats.gopCacheBytes = m_gopCacheBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool VideoProcessor::takeLatestFrames(DisplayFrames& frames)
+{
+    // Clear the flag before taking so a frame published after this point wakes us again.
+    m_displayWakePending.store(false);
+    const DisplayFrames* latest = m_displayMailbox.take();
+    if (!latest) return false;
+    frames = *latest;
+    return true;
+}
+
+quint64 VideoProcessor::droppedDisplayFrames() const
+{
+    return m_displayMailbox.dropped();
+}
+
+bool VideoProcessor::heatmapImage(cv::Mat& bgr) const
+{
+    cv::Mat scratch;
+    std::lock_guard<std::mutex> lock(m_heatmapMutex);
+    m_heatmap.render(cv::Size(), scratch, bgr);
+    return !bgr.empty();
 }
 
 void VideoProcessor::loadVideo(const QString& filePath)
@@ -32,6 +119,8 @@ void VideoProcessor::loadVideo(const QString& filePath)
     qInfo() << "Loading video:" << filePath;
     if (m_thread->isRunning()) {
        m_stopRequested = true;
+       notifyFrameQueue();
+       notifyOpenWaiters();
        m_thread->quit();
        m_thread->wait(1000);
        if(m_thread->isRunning()) {
@@ -42,20 +131,210 @@ void VideoProcessor::loadVideo(const QString& filePath)
        m_stopRequested = false;
     }
 
+    // An open still in progress is abandoned, not waited for: it stops after its current
+    // step, and the generation check in openCapture() drops whatever it produces.
+    const auto cancelOpen = std::make_shared<std::atomic<bool>>(false);
+    quint64 generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_openMutex);
+        m_cancelOpen->store(true);
+        m_cancelOpen = cancelOpen;
+        generation = ++m_openGeneration;
+        m_openPending = true;
+        m_openResult.reset();
+        ++m_openThreads;
+    }
+    m_capture.release();
+    m_prefetchedFrames.clear();
+    m_capturePosition = 0;
+    m_opened = false;
+
     m_filePath = filePath;
+    m_seekTarget = 0;
+    m_gopCache.clear();
+    m_gopCacheBytes = 0;
+    stopKeyframeIndexBuild();
 
-    cv::VideoCapture temp_capture;
-    if (!temp_capture.open(m_filePath.toStdString())) {
-        emit errorOccurred(QString("Failed to open video file: %1").arg(m_filePath));
-        m_filePath.clear();
+    VideoProbe probe;
+    const bool probeCached = VideoProbeCache::shared().lookup(m_filePath, probe);
+    if (probeCached) {
+        m_fps = probe.fps;
+        m_videoWidth = probe.width;
+        m_videoHeight = probe.height;
+        m_frameCount = probe.frameCount;
+        emit videoInfoReady(m_fps, m_videoWidth, m_videoHeight, m_frameCount);
+        qInfo() << "Video info (cached) - FPS:" << m_fps << " W:" << m_videoWidth << " H:" << m_videoHeight
+                << " Frames:" << m_frameCount;
+    }
+
+    // Opening can take seconds on network storage, so it never runs on the caller's thread.
+    const bool lumaOnly = m_lumaOnlyDecode.load();
+    const int prefetchFrames = seekHistoryFrames() + 1;
+    QThread* openThread = QThread::create([this, generation, filePath, probeCached, lumaOnly, prefetchFrames, cancelOpen] {
+        openCapture(generation, filePath, probeCached, lumaOnly, prefetchFrames, *cancelOpen);
+    });
+    connect(openThread, &QThread::finished, openThread, &QObject::deleteLater);
+    openThread->start();
+    startKeyframeIndexBuild();
+}
+
+bool VideoProcessor::openPlaybackCapture(const QString& filePath, bool lumaOnly, OpenedCapture& opened)
+{
+    // Let the decoder use every core. Analysis parallelism is set separately per frame.
+    std::vector<int> captureParams;
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 7)
+    captureParams = {cv::CAP_PROP_N_THREADS, QThread::idealThreadCount()};
+#endif
+    cv::VideoCapture& capture = opened.capture;
+    if (!capture.open(filePath.toStdString(), cv::CAP_ANY, captureParams)) return false;
+
+    opened.codecPixelFormat = 0;
+    opened.lumaOnly = lumaOnly;
+    if (lumaOnly) {
+        // Backends that cannot skip the conversion ignore this and keep returning BGR,
+        // which the decoder detects per frame.
+        if (!capture.set(cv::CAP_PROP_CONVERT_RGB, 0)) {
+            qWarning() << "Capture backend does not support luma-only decoding; using BGR.";
+        }
+        opened.codecPixelFormat = static_cast<int>(capture.get(cv::CAP_PROP_CODEC_PIXEL_FORMAT));
+    }
+    opened.fps = capture.get(cv::CAP_PROP_FPS);
+    opened.width = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH));
+    opened.height = static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+    opened.frameCount = static_cast<qint64>(capture.get(cv::CAP_PROP_FRAME_COUNT));
+    return true;
+}
+
+void VideoProcessor::adoptCapture(OpenedCapture& opened)
+{
+    // cv::VideoCapture shares its backend on copy; opened is left without one.
+    m_capture = opened.capture;
+    opened.capture = cv::VideoCapture();
+    m_captureLumaOnly = opened.lumaOnly;
+    m_codecPixelFormat = opened.codecPixelFormat;
+    m_fps = opened.fps;
+    m_videoWidth = opened.width;
+    m_videoHeight = opened.height;
+    m_frameCount = opened.frameCount;
+}
+
+void VideoProcessor::openCapture(quint64 generation, const QString& filePath, bool probeCached, bool lumaOnly,
+                                 int prefetchFrames, const std::atomic<bool>& cancel)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Opened the way run() needs it, so playback reuses this handle.
+    auto opened = std::make_unique<OpenedCapture>();
+    const bool ok = !cancel.load() && openPlaybackCapture(filePath, lumaOnly, *opened);
+    if (ok && !probeCached) {
+        VideoProbe probe;
+        probe.fps = opened->fps;
+        probe.width = opened->width;
+        probe.height = opened->height;
+        probe.frameCount = opened->frameCount;
+        VideoProbeCache::shared().insert(filePath, probe);
+        // Emitted under the lock so that nothing from this open follows a newer loadVideo().
+        std::lock_guard<std::mutex> lock(m_openMutex);
+        if (generation == m_openGeneration) {
+            emit videoInfoReady(probe.fps, probe.width, probe.height, probe.frameCount);
+            qInfo() << "Video info ready - FPS:" << probe.fps << " W:" << probe.width << " H:" << probe.height
+                    << " Frames:" << probe.frameCount;
+        }
+    }
+
+    // The frames the first mask needs, so Play does not start with a wait on the decoder.
+    for (int i = 0; ok && i < prefetchFrames && !cancel.load(); ++i) {
+        cv::Mat image;
+        FrameLayout layout;
+        if (!opened->capture.read(image) || image.empty()) break;
+        ++opened->position;
+        // Left to decodeFrame(), which falls back to BGR.
+        if (!detectFrameLayout(image, opened->height, opened->codecPixelFormat, layout)) break;
+        opened->prefetched.push_back(image);
+    }
+
+    std::lock_guard<std::mutex> lock(m_openMutex);
+    if (generation == m_openGeneration) {
+        if (ok) {
+            qInfo() << "Opened" << filePath << "in" << timer.elapsed() << "ms, prefetched" << opened->prefetched.size()
+                    << "frames";
+            m_openResult = std::move(opened);
+        } else {
+            emit errorOccurred(QString("Failed to open video file: %1").arg(filePath));
+        }
+        m_openPending = false;
     } else {
-        m_fps = temp_capture.get(cv::CAP_PROP_FPS);
-        m_videoWidth = static_cast<int>(temp_capture.get(cv::CAP_PROP_FRAME_WIDTH));
-        m_videoHeight = static_cast<int>(temp_capture.get(cv::CAP_PROP_FRAME_HEIGHT));
-        emit videoInfoReady(m_fps, m_videoWidth, m_videoHeight);
-        qInfo() << "Video info ready - FPS:" << m_fps << " W:" << m_videoWidth << " H:" << m_videoHeight;
+        qInfo() << "Dropped the open of" << filePath << "after" << timer.elapsed() << "ms; a newer file was loaded";
+    }
+    --m_openThreads;
+    m_openDone.notify_all();
+}
+
+bool VideoProcessor::waitForOpen()
+{
+    std::unique_lock<std::mutex> lock(m_openMutex);
+    m_openDone.wait(lock, [this] { return !m_openPending || m_stopRequested.load(); });
+    if (m_openResult) {
+        adoptCapture(*m_openResult);
+        m_prefetchedFrames = std::move(m_openResult->prefetched);
+        m_capturePosition = m_openResult->position;
+        m_openResult.reset();
+        m_opened = true;
+    }
+    return m_opened;
+}
+
+void VideoProcessor::notifyOpenWaiters()
+{
+    // As in notifyFrameQueue().
+    {
+        std::lock_guard<std::mutex> lock(m_openMutex);
+    }
+    m_openDone.notify_all();
+}
+
+void VideoProcessor::waitForOpenThreads()
+{
+    std::unique_lock<std::mutex> lock(m_openMutex);
+    m_cancelOpen->store(true);
+    m_openDone.wait(lock, [this] { return m_openThreads == 0; });
+}
+
+void VideoProcessor::startKeyframeIndexBuild()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_keyframeIndexMutex);
+        m_keyframeIndex.reset();
     }
-    temp_capture.release();
+    m_cancelKeyframeIndex = false;
+
+    const std::string filePath = m_filePath.toStdString();
+    m_keyframeIndexThread.reset(QThread::create([this, filePath] {
+        auto index = std::make_shared<const KeyframeIndex>(KeyframeIndex::build(filePath, m_cancelKeyframeIndex));
+        if (m_cancelKeyframeIndex.load()) return;
+        {
+            std::lock_guard<std::mutex> lock(m_keyframeIndexMutex);
+            m_keyframeIndex = index;
+        }
+        qInfo() << "Keyframe index ready:" << index->keyframeCount() << "keyframes, exact:" << index->isExact();
+        emit keyframeIndexReady(static_cast<int>(index->keyframeCount()), index->isExact());
+    }));
+    m_keyframeIndexThread->start(QThread::LowPriority);
+}
+
+void VideoProcessor::stopKeyframeIndexBuild()
+{
+    if (!m_keyframeIndexThread) return;
+    m_cancelKeyframeIndex = true;
+    m_keyframeIndexThread->wait();
+    m_keyframeIndexThread.reset();
+}
+
+std::shared_ptr<const KeyframeIndex> VideoProcessor::keyframeIndex() const
+{
+    std::lock_guard<std::mutex> lock(m_keyframeIndexMutex);
+    return m_keyframeIndex;
 }
 
 void VideoProcessor::startProcessing()
@@ -92,6 +371,8 @@ void VideoProcessor::stop()
 {
     qInfo() << "Stop requested";
     m_stopRequested = true;
+    notifyFrameQueue();
+    notifyOpenWaiters();
     if (m_thread->isRunning()) {
         m_thread->quit();
         if (!m_thread->wait(2000)) {
@@ -103,17 +384,54 @@ void VideoProcessor::stop()
     } else {
          qInfo() << "Video processing thread was not running.";
     }
-     m_frameBuffer.clear();
 }
 
 void VideoProcessor::setFrameDelta(int delta)
 {
-    if (delta > 0) {
+    if (delta > 0 && delta <= kMaxFrameDelta) {
         qInfo() << "Setting frame delta to" << delta;
         m_frameDelta = delta;
     } else {
-         qWarning() << "Frame delta must be positive.";
+         qWarning() << "Frame delta must be between 1 and" << kMaxFrameDelta;
+    }
+}
+
+bool VideoProcessor::parseFrameDeltaSet(const QString& text, std::vector<int>& deltas)
+{
+    deltas.clear();
+    static const QRegularExpression separators("[,\\s]+");
+    for (const QString& entry : text.split(separators, Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const int delta = entry.toInt(&ok);
+        if (!ok || delta <= 0 || delta > kMaxFrameDelta) return false;
+        if (std::find(deltas.begin(), deltas.end(), delta) == deltas.end()) deltas.push_back(delta);
     }
+    return deltas.size() <= static_cast<size_t>(kMaxFusedDeltas);
+}
+
+void VideoProcessor::setFrameDeltaSet(const std::vector<int>& deltas)
+{
+    if (deltas.size() > static_cast<size_t>(kMaxFusedDeltas)) {
+        qWarning() << "At most" << kMaxFusedDeltas << "frame deltas can be analysed together.";
+        return;
+    }
+    for (int delta : deltas) {
+        if (delta <= 0 || delta > kMaxFrameDelta) {
+            qWarning() << "Frame delta must be between 1 and" << kMaxFrameDelta;
+            return;
+        }
+    }
+    qInfo() << "Setting frame delta set to" << QList<int>(deltas.begin(), deltas.end());
+    {
+        std::lock_guard<std::mutex> lock(m_deltaSetMutex);
+        m_deltaSet = deltas;
+    }
+    m_deltaSetVersion.fetch_add(1, std::memory_order_release);
+}
+
+void VideoProcessor::setDeltaGridDisplay(bool enabled)
+{
+    m_deltaGridDisplay = enabled;
 }
 
 void VideoProcessor::setMotionThreshold(int threshold)
@@ -126,77 +444,727 @@ void VideoProcessor::setMotionThreshold(int threshold)
     }
 }
 
+void VideoProcessor::setMotionAlgorithm(MotionAlgorithm algorithm)
+{
+    qInfo() << "Setting motion algorithm to" << motionAlgorithmName(algorithm);
+    m_motionAlgorithm = algorithm;
+}
+
+void VideoProcessor::setRealtimePlayback(bool enabled)
+{
+    qInfo() << "Setting realtime playback to" << enabled;
+    m_realtimePlayback = enabled;
+}
+
+void VideoProcessor::setHeatmapEnabled(bool enabled)
+{
+    qInfo() << "Setting motion heatmap to" << enabled;
+    m_heatmapEnabled = enabled;
+}
+
+void VideoProcessor::setHeatmapWindow(double seconds)
+{
+    if (seconds > 0) {
+        qInfo() << "Setting heatmap window to" << seconds << "s";
+        m_heatmapSeconds = seconds;
+    } else {
+        qWarning() << "Heatmap window must be positive.";
+    }
+}
+
+void VideoProcessor::setAdaptiveQuality(bool enabled)
+{
+    qInfo() << "Setting adaptive quality to" << enabled;
+    m_adaptiveQuality = enabled;
+}
+
+void VideoProcessor::setAnalyseEveryFrame(bool enabled)
+{
+    qInfo() << "Setting analyse every frame to" << enabled;
+    m_analyseEveryFrame = enabled;
+}
+
+void VideoProcessor::setAnalysisThreads(int threads)
+{
+    if (threads >= 0) {
+        qInfo() << "Setting analysis threads to" << threads;
+        m_analysisThreads = threads;
+    } else {
+        qWarning() << "Analysis thread count must be 0 (auto) or positive.";
+    }
+}
+
+void VideoProcessor::setAnalysisScale(int divisor)
+{
+    // Powers of two only, so every level is an exact box average of the one above it.
+    if (divisor >= 1 && divisor <= kMaxAnalysisScale && (divisor & (divisor - 1)) == 0) {
+        qInfo() << "Setting analysis scale to 1 /" << divisor;
+        m_analysisScale = divisor;
+    } else {
+        qWarning() << "Analysis scale must be 1, 2, 4 or 8.";
+    }
+}
+
+void VideoProcessor::setMotionStatsEnabled(bool enabled)
+{
+    qInfo() << "Setting motion stats to" << enabled;
+    m_motionStatsEnabled = enabled;
+}
+
+void VideoProcessor::setMinBlobArea(int minArea)
+{
+    if (minArea >= 1) {
+        qInfo() << "Setting minimum blob area to" << minArea;
+        m_minBlobArea = minArea;
+    } else {
+        qWarning() << "Minimum blob area must be at least 1 pixel.";
+    }
+}
+
+void VideoProcessor::setPlaybackSpeed(double speed)
+{
+    const double clamped = std::clamp(speed, PlaybackClock::kMinSpeed, PlaybackClock::kMaxSpeed);
+    qInfo() << "Setting playback speed to" << clamped;
+    m_playbackSpeed = clamped;
+}
+
+void VideoProcessor::seekToFrame(qint64 frameIndex)
+{
+    qint64 target = std::max<qint64>(0, frameIndex);
+    if (m_frameCount > 0) target = std::min(target, m_frameCount - 1);
+    qInfo() << "Seek requested to frame" << target;
+    m_seekTarget = target;
+    m_seekGeneration.fetch_add(1, std::memory_order_acq_rel);
+    notifyFrameQueue(); // A decoder waiting to push a stale frame drops it
+}
+
+void VideoProcessor::seekToMsec(qint64 msec)
+{
+    const double fps = m_fps > 0 ? m_fps : 30.0;
+    seekToFrame(static_cast<qint64>(std::llround(msec * fps / 1000.0)));
+}
+
+void VideoProcessor::setLumaOnlyDecode(bool enabled)
+{
+    qInfo() << "Setting luma-only decode to" << enabled;
+    m_lumaOnlyDecode = enabled;
+}
+
+void VideoProcessor::setDisplaySize(int width, int height)
+{
+    m_displayWidth = std::max(0, width);
+    m_displayHeight = std::max(0, height);
+}
+
+namespace {
+
+// Makes buffer safe to overwrite: if the display still references its pixels, detach
+// so a fresh buffer is allocated instead of writing under the GUI's feet.
+void detachIfShared(cv::Mat& buffer)
+{
+    if (buffer.u && buffer.u->refcount > 1) buffer.release();
+}
+
+// Returns the frame the motion kernel should see: frame itself at scale 1, otherwise a
+// downscaled copy in scratch. INTER_AREA with an integer factor averages scale x scale
+// blocks, which anti-aliases like a pyrDown chain but in a single pass.
+const cv::Mat& analysisInput(const cv::Mat& frame, int scale, cv::Mat& scratch)
+{
+    if (scale <= 1) return frame;
+    const cv::Size size(std::max(1, frame.cols / scale), std::max(1, frame.rows / scale));
+    cv::resize(frame, scratch, size, 0, 0, cv::INTER_AREA);
+    return scratch;
+}
+
+// Masks are binary, so enlarging them must not blend: nearest keeps 0/255 and shows
+// the analysis blocks as they are. Shrinking still averages.
+int maskInterpolation(const cv::Size& from, const cv::Size& to)
+{
+    return to.area() > from.area() ? cv::INTER_NEAREST : cv::INTER_AREA;
+}
+
+} // namespace
+
+void VideoProcessor::updateQuality(QosController& qos, PlaybackClock::Clock::duration busy, const PlaybackClock& clock)
+{
+    const double busyFraction = std::chrono::duration<double>(busy).count()
+                                / std::chrono::duration<double>(clock.framePeriod()).count();
+    if (!qos.addFrame(busyFraction)) return;
+    qInfo() << "Adaptive quality:" << QosController::levelName(qos.level());
+    emit qualityLevelChanged(qos.level(), QosController::levelName(qos.level()));
+}
+
+bool VideoProcessor::waitForPresentation(PlaybackClock& clock, qint64 frameIndex)
+{
+    // Beyond this much lag the processing itself is too slow for the requested speed;
+    // skipping cannot catch up, so restart the timeline from the current frame instead.
+    constexpr auto kMaxCatchUp = std::chrono::milliseconds(500);
+    // Sleep in short slices so pause/stop requests are honoured promptly.
+    constexpr auto kSleepSlice = std::chrono::milliseconds(10);
+
+    const PlaybackClock::Clock::time_point deadline = clock.deadline(frameIndex);
+    PlaybackClock::Clock::time_point now = PlaybackClock::Clock::now();
+
+    if (now > deadline + clock.framePeriod()) {
+        if (now - deadline < kMaxCatchUp) {
+            m_framesSkipped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        clock.rebase(frameIndex);
+        return true;
+    }
+
+    while (now < deadline && !m_stopRequested.load() && !m_pauseRequested.load()) {
+        std::this_thread::sleep_until(std::min(deadline, now + kSleepSlice));
+        now = PlaybackClock::Clock::now();
+    }
+    return true;
+}
+
+void VideoProcessor::prepareDisplayFrames(const cv::Mat& decoded, FrameLayout layout, const cv::Mat& mask,
+                                          DisplayFrames& display)
+{
+    // YUV frames are converted to colour here, i.e. only once a frame is really shown.
+    const cv::Mat& original = displayImage(decoded, layout, m_colorScratch);
+    const cv::Size displaySize(m_displayWidth.load(), m_displayHeight.load());
+    if (displaySize.area() <= 0) {
+        if (&original == &m_colorScratch) {
+            // The scratch buffer is rewritten next frame; the display needs its own.
+            detachIfShared(display.original);
+            m_colorScratch.copyTo(display.original);
+        } else {
+            display.original = original;
+        }
+        if (mask.empty() || mask.size() == original.size()) {
+            display.mask = mask;
+        } else {
+            // Reduced analysis resolution: bring the mask back to the frame's size.
+            detachIfShared(display.mask);
+            cv::resize(mask, display.mask, original.size(), 0, 0, cv::INTER_NEAREST);
+        }
+        return;
+    }
+
+    // Downscale into a private scratch buffer, then convert into the mailbox slot's own
+    // buffer, which is reused across frames once the GUI has let go of it.
+    detachIfShared(display.original);
+    if (original.channels() == 4) {
+        cv::resize(original, display.original, displaySize, 0, 0, cv::INTER_AREA);
+    } else {
+        cv::resize(original, m_displayScratch, displaySize, 0, 0, cv::INTER_AREA);
+        cv::cvtColor(m_displayScratch, display.original,
+                     m_displayScratch.channels() == 1 ? cv::COLOR_GRAY2BGRA : cv::COLOR_BGR2BGRA);
+    }
+
+    if (mask.empty()) {
+        display.mask.release();
+    } else {
+        detachIfShared(display.mask);
+        cv::resize(mask, m_displayScratch, displaySize, 0, 0, maskInterpolation(mask.size(), displaySize));
+        cv::cvtColor(m_displayScratch, display.mask, cv::COLOR_GRAY2BGRA);
+    }
+}
+
+const cv::Mat& VideoProcessor::composeDeltaGrid(const cv::Size& maskSize, const std::vector<int>& deltas,
+                                                const std::vector<cv::Mat>& masks)
+{
+    // Square grid of cells at 1/columns size, so the grid keeps the frame's size and
+    // aspect ratio and the display path treats it like any other mask.
+    const int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(masks.size()))));
+    const cv::Size cell(std::max(1, maskSize.width / columns), std::max(1, maskSize.height / columns));
+    detachIfShared(m_deltaGrid);
+    m_deltaGrid.create(cell.height * columns, cell.width * columns, CV_8UC1);
+    m_deltaGrid.setTo(0);
+
+    const double fontScale = std::max(0.3, cell.height / 240.0);
+    const int thickness = std::max(1, cell.height / 160);
+    for (size_t i = 0; i < masks.size(); ++i) {
+        const cv::Rect rect(static_cast<int>(i % columns) * cell.width, static_cast<int>(i / columns) * cell.height,
+                            cell.width, cell.height);
+        cv::Mat target = m_deltaGrid(rect);
+        if (!masks[i].empty()) cv::resize(masks[i], target, cell, 0, 0, cv::INTER_AREA);
+        cv::rectangle(m_deltaGrid, rect, cv::Scalar(96), 1);
+        cv::putText(target, "d=" + std::to_string(deltas[i]), cv::Point(4, 4 + static_cast<int>(20 * fontScale)),
+                    cv::FONT_HERSHEY_SIMPLEX, fontScale, cv::Scalar(160), thickness);
+    }
+    return m_deltaGrid;
+}
+
+qint64 VideoProcessor::gopStartFor(const KeyframeIndex* keyframes, qint64 frameIndex) const
+{
+    if (keyframes && !keyframes->isEmpty()) return keyframes->keyframeAtOrBefore(frameIndex);
+    return frameIndex - frameIndex % kFallbackGopLength;
+}
+
+bool VideoProcessor::decodeFrame(qint64 frameIndex, qint64& captureNext, const KeyframeIndex* keyframes, DecodedFrame& frame)
+{
+    cv::Mat& image = frame.image;
+    if (frameIndex < static_cast<qint64>(m_prefetchedFrames.size())) {
+        image = m_prefetchedFrames[static_cast<size_t>(frameIndex)]; // Decoded by loadVideo()
+        return detectFrameLayout(image, m_videoHeight, m_codecPixelFormat, frame.layout);
+    }
+    const qint64 gopStart = gopStartFor(keyframes, frameIndex);
+    if (m_gopCache.lookup(gopStart, frameIndex, image)) {
+        return detectFrameLayout(image, m_videoHeight, m_codecPixelFormat, frame.layout);
+    }
+
+    if (frameIndex != captureNext) {
+        // Decoding forward inside the current GOP is cheaper than a seek, which would
+        // restart decoding at the keyframe.
+        if (frameIndex > captureNext && gopStartFor(keyframes, frameIndex) <= captureNext) {
+            while (captureNext < frameIndex && m_capture.grab()) ++captureNext;
+        } else {
+            m_capture.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(frameIndex));
+            captureNext = frameIndex;
+        }
+    }
+
+    if (!m_capture.read(image) || image.empty()) return false;
+    ++captureNext;
+    if (!detectFrameLayout(image, m_videoHeight, m_codecPixelFormat, frame.layout)) {
+        // Raw output this pipeline cannot read: go back to BGR and decode the frame again.
+        qWarning() << "Unsupported raw frame layout (type" << image.type() << "rows" << image.rows
+                   << "), decoding to BGR instead.";
+        m_capture.set(cv::CAP_PROP_CONVERT_RGB, 1);
+        m_capture.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(frameIndex));
+        captureNext = frameIndex;
+        m_gopCache.clear();
+        if (!m_capture.read(image) || image.empty()) return false;
+        ++captureNext;
+        frame.layout = FrameLayout::Bgr;
+    }
+    m_framesDecoded.fetch_add(1, std::memory_order_relaxed);
+    m_gopCache.insert(gopStart, frameIndex, image);
+    m_gopCacheBytes.store(m_gopCache.bytes(), std::memory_order_relaxed);
+    return true;
+}
+
+void VideoProcessor::decodeLoop()
+{
+    qInfo() << "VideoProcessor decoder stage started in thread" << QThread::currentThreadId();
+    Profiler::setThreadName("decoder");
+
+    // The first pass is treated like a seek to m_seekTarget (0 unless a seek was requested
+    // before playback started).
+    quint64 generation = m_seekGeneration.load(std::memory_order_acquire);
+    qint64 target = m_seekTarget.load();
+    qint64 nextIndex = std::max<qint64>(0, target - seekHistoryFrames());
+    qint64 captureNext = m_capturePosition; // Frame the capture will return on its next read()
+    std::shared_ptr<const KeyframeIndex> keyframes;
+
+    while (!m_stopRequested.load() && !m_decoderStopRequested.load())
+    {
+        const quint64 requestedGeneration = m_seekGeneration.load(std::memory_order_acquire);
+        if (requestedGeneration != generation) {
+            generation = requestedGeneration;
+            target = m_seekTarget.load();
+            // Start delta frames early so the analysis stage can refill its history.
+            nextIndex = std::max<qint64>(0, target - seekHistoryFrames());
+        }
+
+        // GOP boundaries change once the background scan finishes; regroup from scratch.
+        std::shared_ptr<const KeyframeIndex> latestKeyframes = keyframeIndex();
+        if (latestKeyframes != keyframes) {
+            keyframes = latestKeyframes;
+            m_gopCache.clear();
+            m_gopCacheBytes = 0;
+        }
+
+        DecodedFrame frame;
+        bool decoded;
+        {
+            ProfileScope scope(ProfileStage::Decode);
+            decoded = decodeFrame(nextIndex, captureNext, keyframes.get(), frame);
+        }
+        if (!decoded) {
+            qInfo() << "End of video or read error.";
+            break;
+        }
+        frame.index = nextIndex;
+        frame.seekGeneration = generation;
+        frame.historyOnly = nextIndex < target;
+        ++nextIndex;
+
+        // Queue full: analysis is behind. Count the stall once per frame and wait for a pop.
+        bool stalled = false;
+        while (!m_frameQueue.tryPush(std::move(frame))) {
+            if (!stalled) {
+                m_decoderStalls.fetch_add(1, std::memory_order_relaxed);
+                stalled = true;
+            }
+            std::unique_lock<std::mutex> lock(m_frameQueueMutex);
+            m_frameQueueChanged.wait(lock, [this, generation] {
+                return m_frameQueue.size() < m_frameQueue.capacity() || m_stopRequested.load()
+                       || m_decoderStopRequested.load()
+                       || m_seekGeneration.load(std::memory_order_acquire) != generation;
+            });
+            if (m_stopRequested.load() || m_decoderStopRequested.load()) break;
+            if (m_seekGeneration.load(std::memory_order_acquire) != generation) break; // Frame is stale now
+        }
+        notifyFrameQueue();
+    }
+
+    m_decoderFinished.store(true, std::memory_order_release);
+    notifyFrameQueue();
+}
+
+int VideoProcessor::seekHistoryFrames() const
+{
+    // Three-frame differencing looks back two deltas. The background models need far
+    // longer to converge than is worth decoding on a seek; one delta gives them a start.
+    // A delta set needs history for its largest delta.
+    {
+        std::lock_guard<std::mutex> lock(m_deltaSetMutex);
+        if (!m_deltaSet.empty()) return *std::max_element(m_deltaSet.begin(), m_deltaSet.end());
+    }
+    const int delta = m_frameDelta.load();
+    return m_motionAlgorithm.load() == MotionAlgorithm::ThreeFrameDifference ? 2 * delta : delta;
+}
+
+void VideoProcessor::notifyFrameQueue()
+{
+    // Taking the mutex orders the change before a waiter's next check of its condition,
+    // so the notification cannot fall between that check and the wait.
+    {
+        std::lock_guard<std::mutex> lock(m_frameQueueMutex);
+    }
+    m_frameQueueChanged.notify_all();
+}
+
+bool VideoProcessor::popDecodedFrame(DecodedFrame& frame)
+{
+    bool stalled = false;
+    while (!m_stopRequested.load())
+    {
+        if (m_frameQueue.tryPop(frame)) {
+            notifyFrameQueue(); // The decoder may be waiting for a free slot
+            return true;
+        }
+
+        // The decoder may have pushed its last frame between the pop and this check.
+        if (m_decoderFinished.load(std::memory_order_acquire)) {
+            return m_frameQueue.tryPop(frame);
+        }
+        if (!stalled) {
+            m_analysisStalls.fetch_add(1, std::memory_order_relaxed);
+            stalled = true;
+        }
+        std::unique_lock<std::mutex> lock(m_frameQueueMutex);
+        m_frameQueueChanged.wait(lock, [this] {
+            return m_frameQueue.size() > 0 || m_decoderFinished.load(std::memory_order_acquire)
+                   || m_stopRequested.load();
+        });
+    }
+    return false;
+}
+
 void VideoProcessor::run()
 {
     qInfo() << "VideoProcessor::run() started in thread" << QThread::currentThreadId();
+    Profiler::setThreadName("analysis");
 
-    if (!m_capture.open(m_filePath.toStdString())) {
-        emit errorOccurred(QString("Failed to open video file in worker thread: %1").arg(m_filePath));
+    // Normally the capture opened by loadVideo() is taken over, already positioned after
+    // the prefetched frames. It is opened again if that failed, if an earlier run released
+    // it, or if the luma-only setting changed since.
+    const bool lumaOnly = m_lumaOnlyDecode.load();
+    const bool opened = waitForOpen();
+    if (m_stopRequested.load()) {
+        qInfo() << "VideoProcessor::run() stopped while the file was opening.";
+        m_thread->quit();
         return;
     }
-
-    m_fps = m_capture.get(cv::CAP_PROP_FPS);
-    m_videoWidth = static_cast<int>(m_capture.get(cv::CAP_PROP_FRAME_WIDTH));
-    m_videoHeight = static_cast<int>(m_capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+    if (!opened || !m_capture.isOpened() || m_captureLumaOnly != lumaOnly) {
+        m_capture.release();
+        m_capturePosition = 0;
+        // Prefetched frames are only valid in the mode they were decoded in.
+        if (m_captureLumaOnly != lumaOnly) m_prefetchedFrames.clear();
+        OpenedCapture reopened;
+        if (!openPlaybackCapture(m_filePath, lumaOnly, reopened)) {
+            emit errorOccurred(QString("Failed to open video file in worker thread: %1").arg(m_filePath));
+            m_thread->quit();
+            return;
+        }
+        adoptCapture(reopened);
+    }
     if (m_fps <= 0) m_fps = 30.0; // Default FPS if reading fails
 
-    m_frameBuffer.clear();
+    m_detector = createMotionDetector(m_motionAlgorithm.load(), kMaxFrameDelta);
+    m_multiDeltaDetector = std::make_unique<MultiDeltaDetector>(kMaxFrameDelta);
+    m_activeDeltaSet.clear();
+    m_gopCache.clear();
+    m_gopCacheBytes = 0;
+
+    m_decoderFinished = false;
+    m_decoderStopRequested = false;
+    m_framesDecoded = 0;
+    m_framesAnalyzed = 0;
+    m_decoderStalls = 0;
+    m_analysisStalls = 0;
+    m_framesSkipped = 0;
+
+    // Decoding runs on its own thread so it overlaps with analysis; the bounded
+    // queue between the two stages caps memory at kFrameQueueCapacity frames.
+    std::unique_ptr<QThread> decoderThread(QThread::create([this] { decodeLoop(); }));
+    decoderThread->start();
+
+    // Frames are presented at absolute deadlines derived from the video fps and the
+    // speed multiplier; the frame delta only affects analysis, never the pacing.
+    PlaybackClock clock;
+    double appliedSpeed = m_playbackSpeed.load();
+    clock.start(m_fps, appliedSpeed, 0);
+    bool rebaseClock = false;
+
+    QElapsedTimer rateTimer;
+    rateTimer.start();
+    int presentedSinceRateUpdate = 0;
+
+    // Quality steps down when processing cannot keep up with the clock. The last mask is
+    // kept for frames whose mask is not computed at the current level.
+    QosController qos;
+    cv::Mat lastMask;
+    std::vector<cv::Mat> lastDeltaMasks;
+    if (m_realtimePlayback.load() && m_adaptiveQuality.load()) {
+        emit qualityLevelChanged(qos.level(), QosController::levelName(qos.level()));
+    }
 
-    int currentDelta = m_frameDelta.load();
-    int delayMs = static_cast<int>((1000.0 / m_fps) * currentDelta);
-    if (delayMs <= 0) delayMs = 33 * currentDelta;
+    DecodedFrame decoded;
+    int appliedAnalysisThreads = -1;
+    quint64 appliedDeltaSetVersion = std::numeric_limits<quint64>::max();
 
-    cv::Mat currentFrame;
-    cv::Mat grayN, grayNminusDelta, diff, mask;
-    QElapsedTimer frameTimer;
+    // Seek generation of the frames being analysed. Starts out unmatched so the first
+    // frame is handled like the first frame after a seek.
+    quint64 analysisGeneration = std::numeric_limits<quint64>::max();
+    // After a seek one frame is presented even while paused, so the user sees the target.
+    bool presentAfterSeek = false;
 
     while (!m_stopRequested.load())
     {
-        while (m_pauseRequested.load() && !m_stopRequested.load()) {
-            QThread::msleep(50);
+        if (m_pauseRequested.load() && !presentAfterSeek) {
+            while (m_pauseRequested.load() && !m_stopRequested.load()
+                   && m_seekGeneration.load(std::memory_order_acquire) == analysisGeneration) {
+                QThread::msleep(10);
+            }
+            rebaseClock = true;
         }
         if (m_stopRequested.load()) break;
 
-        frameTimer.start();
-
-        if (!m_capture.read(currentFrame) || currentFrame.empty()) {
-            qInfo() << "End of video or read error.";
+        if (!popDecodedFrame(decoded)) {
             break;
         }
 
-        currentDelta = m_frameDelta.load();
-        delayMs = static_cast<int>((1000.0 / m_fps) * currentDelta);
-        if (delayMs <= 0) delayMs = 33 * currentDelta;
+        // Decoded before the latest seek request: no longer wanted.
+        if (decoded.seekGeneration != m_seekGeneration.load(std::memory_order_acquire)) continue;
+        if (decoded.seekGeneration != analysisGeneration) {
+            analysisGeneration = decoded.seekGeneration;
+            m_detector->reset();
+            m_multiDeltaDetector->reset();
+            lastMask.release();
+            lastDeltaMasks.clear();
+            {
+                std::lock_guard<std::mutex> lock(m_heatmapMutex);
+                m_heatmap.reset();
+            }
+            rebaseClock = true;
+            presentAfterSeek = true;
+        }
+        const PlaybackClock::Clock::time_point workStart = PlaybackClock::Clock::now();
+        PlaybackClock::Clock::duration waited(0);
+
+        const bool adaptive = m_realtimePlayback.load() && m_adaptiveQuality.load();
+        if (!adaptive && qos.level() != QosController::Full) {
+            qos.reset();
+            emit qualityLevelChanged(qos.level(), QosController::levelName(qos.level()));
+        }
+
+        // The motion kernel splits frames into row stripes on OpenCV's pool; the limit
+        // applies to the kernels called from this thread only.
+        const int analysisThreads = m_analysisThreads.load();
+        if (analysisThreads != appliedAnalysisThreads) {
+            setMotionKernelThreads(analysisThreads);
+            appliedAnalysisThreads = analysisThreads;
+        }
+
+        const MotionAlgorithm algorithm = m_motionAlgorithm.load();
+        if (algorithm != m_detector->algorithm()) {
+            m_detector = createMotionDetector(algorithm, kMaxFrameDelta);
+        }
+        const quint64 deltaSetVersion = m_deltaSetVersion.load(std::memory_order_acquire);
+        if (deltaSetVersion != appliedDeltaSetVersion) {
+            // Only one detector is fed at a time, so the one taking over has a stale history.
+            const bool wasMultiDelta = !m_activeDeltaSet.empty();
+            {
+                std::lock_guard<std::mutex> lock(m_deltaSetMutex);
+                m_activeDeltaSet = m_deltaSet;
+            }
+            appliedDeltaSetVersion = deltaSetVersion;
+            const bool isMultiDelta = !m_activeDeltaSet.empty();
+            if (!wasMultiDelta && isMultiDelta) m_multiDeltaDetector->reset();
+            if (wasMultiDelta && !isMultiDelta) m_detector->reset();
+        }
+        const bool multiDelta = !m_activeDeltaSet.empty();
+        MotionParams params;
+        params.frameDelta = m_frameDelta.load();
+        params.threshold = m_motionThreshold.load();
 
-        m_frameBuffer.push_back(currentFrame.clone());
+        // In luma-only mode this is a view of the Y plane; BGR frames pass through and are
+        // converted to gray by the motion kernel.
+        const cv::Mat analysisFrame = lumaView(decoded.image, decoded.layout, m_videoHeight);
 
-        while (m_frameBuffer.size() > static_cast<size_t>(currentDelta + 1) && !m_frameBuffer.empty()) {
-             m_frameBuffer.pop_front();
+        // A scale change alters the frame size, which makes the detector restart its history.
+        const int analysisScale = adaptive ? qos.analysisScale(m_analysisScale.load(), kMaxAnalysisScale)
+                                           : m_analysisScale.load();
+        const cv::Mat& motionInput = analysisInput(analysisFrame, analysisScale, m_analysisScratch);
+
+        if (decoded.historyOnly) {
+            ProfileScope scope(ProfileStage::Motion);
+            if (multiDelta) m_multiDeltaDetector->learn(motionInput);
+            else m_detector->learn(motionInput, params);
+            continue;
         }
 
+        const qint64 frameIndex = decoded.index;
+        const bool analyse = !adaptive || m_analyseEveryFrame.load() || qos.analyseFrame(frameIndex);
+
+        // The mask is shared with the GUI and other consumers, so a new one is made per frame.
         cv::Mat motionMaskToSend;
-        if (m_frameBuffer.size() >= static_cast<size_t>(currentDelta + 1))
+        std::vector<cv::Mat> deltaMasks;
         {
-            const cv::Mat& frameN = m_frameBuffer.back();
-            const cv::Mat& frameNminusDelta = m_frameBuffer.front();
+            ProfileScope scope(ProfileStage::Motion);
+            if (!analyse) {
+                // Keeps the history complete for the next analysed frame. The display
+                // repeats the last mask; nothing is reported for this frame.
+                if (multiDelta) m_multiDeltaDetector->learn(motionInput);
+                else m_detector->learn(motionInput, params);
+                motionMaskToSend = lastMask;
+                deltaMasks = lastDeltaMasks;
+            } else if (multiDelta) {
+                m_multiDeltaDetector->detect(motionInput, m_activeDeltaSet, params.threshold, deltaMasks);
+                if (!deltaMasks.empty()) motionMaskToSend = deltaMasks.front();
+            } else {
+                m_detector->detect(motionInput, params, motionMaskToSend);
+            }
+        }
+        if (analyse) {
+            lastMask = motionMaskToSend;
+            lastDeltaMasks = deltaMasks;
+
+            m_framesAnalyzed.fetch_add(1, std::memory_order_relaxed);
+            {
+                ProfileScope scope(ProfileStage::Emit);
+                emit newFramesReady(analysisFrame, motionMaskToSend);
+                if (multiDelta) emit multiDeltaMasksReady(frameIndex, m_activeDeltaSet, deltaMasks);
+            }
+            {
+                ProfileScope scope(ProfileStage::Export);
+                emit frameAnalyzed(frameIndex, decoded.image, decoded.layout, motionMaskToSend);
+            }
+        }
+
+        if (analyse && m_motionStatsEnabled.load()) {
+            {
+                ProfileScope scope(ProfileStage::Stats);
+                m_motionStats.frameIndex = frameIndex;
+                m_blobExtractor.extract(motionMaskToSend, m_minBlobArea.load(), analysisScale, m_motionStats);
+            }
+            emit motionStatsReady(m_motionStats);
+        }
 
-            cv::cvtColor(frameN, grayN, cv::COLOR_BGR2GRAY);
-            cv::cvtColor(frameNminusDelta, grayNminusDelta, cv::COLOR_BGR2GRAY);
-            cv::absdiff(grayN, grayNminusDelta, diff);
-            cv::threshold(diff, motionMaskToSend, m_motionThreshold.load(), 255, cv::THRESH_BINARY);
+        // Every frame counts towards the heatmap, presented or not. Frames whose mask was
+        // not computed only let it fade.
+        const bool heatmap = m_heatmapEnabled.load();
+        if (heatmap) {
+            ProfileScope scope(ProfileStage::Motion);
+            std::lock_guard<std::mutex> lock(m_heatmapMutex);
+            m_heatmap.setWindowFrames(m_heatmapSeconds.load() * m_fps);
+            m_heatmap.accumulate(analyse ? motionMaskToSend : cv::Mat());
+        } else if (!m_heatmap.isEmpty()) {
+            std::lock_guard<std::mutex> lock(m_heatmapMutex);
+            m_heatmap.reset();
         }
 
-        emit newFramesReady(currentFrame, motionMaskToSend);
+        if (m_realtimePlayback.load()) {
+            if (rebaseClock) {
+                clock.rebase(frameIndex);
+                qos.restartWindow();
+                rebaseClock = false;
+            }
+            const double speed = m_playbackSpeed.load();
+            if (speed != appliedSpeed) {
+                clock.setSpeed(speed, frameIndex);
+                appliedSpeed = speed;
+            }
+            // At the lowest quality level alternate frames are not shown (no wait either:
+            // the next frame's deadline paces playback).
+            if (adaptive && !presentAfterSeek && !qos.presentFrame(frameIndex)) {
+                updateQuality(qos, PlaybackClock::Clock::now() - workStart, clock);
+                continue;
+            }
+            // Frames that are already late are analysed (to keep the history intact) but
+            // not presented, which is how playback catches up.
+            const PlaybackClock::Clock::time_point waitStart = PlaybackClock::Clock::now();
+            const bool present = waitForPresentation(clock, frameIndex);
+            waited = PlaybackClock::Clock::now() - waitStart;
+            if (!present) {
+                if (adaptive) updateQuality(qos, PlaybackClock::Clock::now() - workStart - waited, clock);
+                continue;
+            }
+
+            ++presentedSinceRateUpdate;
+            if (rateTimer.elapsed() >= 1000) {
+                emit playbackRateUpdated(presentedSinceRateUpdate * 1000.0 / rateTimer.restart(), clock.targetFps());
+                presentedSinceRateUpdate = 0;
+            }
+        }
 
-        int elapsed = static_cast<int>(frameTimer.elapsed());
-        int waitTime = delayMs - elapsed;
-        if (waitTime > 0 && !m_stopRequested.load()) {
-            QThread::msleep(waitTime);
+        // Hand the pair to the display. If the GUI has not taken the previous pair yet it
+        // is replaced (and counted as dropped) and no further wake-up is queued.
+        DisplayFrames& display = m_displayMailbox.back();
+        {
+            ProfileScope scope(ProfileStage::DisplayPrepare);
+            const bool grid = multiDelta && deltaMasks.size() > 1 && m_deltaGridDisplay.load();
+            prepareDisplayFrames(decoded.image, decoded.layout,
+                                 grid ? composeDeltaGrid(motionInput.size(), m_activeDeltaSet, deltaMasks)
+                                      : motionMaskToSend,
+                                 display);
+            if (heatmap && !m_heatmap.isEmpty()) {
+                // Same size and format as the other panes.
+                m_heatmap.render(display.original.size(), m_heatmapScratch, m_heatmapColor);
+                detachIfShared(display.heatmap);
+                cv::cvtColor(m_heatmapColor, display.heatmap, cv::COLOR_BGR2BGRA);
+            } else {
+                display.heatmap.release();
+            }
         }
+        display.frameIndex = frameIndex;
+        m_displayMailbox.publish();
+        presentAfterSeek = false;
+        if (!m_displayWakePending.exchange(true)) {
+            emit framesAvailable();
+        }
+        if (adaptive) updateQuality(qos, PlaybackClock::Clock::now() - workStart - waited, clock);
     }
 
+    m_decoderStopRequested = true;
+    notifyFrameQueue();
+    decoderThread->wait();
+    DecodedFrame discarded;
+    while (m_frameQueue.tryPop(discarded)) {}
+    // The next run starts from the beginning unless a seek is requested before it.
+    m_seekTarget = 0;
+
+    const PipelineStats stats = pipelineStats();
+    qInfo() << "Pipeline: decoded" << stats.framesDecoded << "analysed" << stats.framesAnalyzed
+            << "decoder stalls" << stats.decoderStalls << "analysis stalls" << stats.analysisStalls
+            << "skipped" << stats.framesSkipped;
+
     m_capture.release();
-    m_frameBuffer.clear();
+    m_detector.reset();
+    m_multiDeltaDetector.reset();
     qInfo() << "VideoProcessor::run() finished.";
     emit processingFinished();
+
+    // run() is called from QThread::started, before the thread's event loop starts;
+    // quitting now ends the thread once run() returns, so startProcessing() can start
+    // it again (e.g. after the end of the file).
+    m_thread->quit();
 }
\ No newline at end of file
@@ -8,9 +8,54 @@
 #include <QMetaType>
 #include <opencv2/opencv.hpp>
 #include <atomic>
-#include <deque>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <vector>
 
+#include "FrameLayout.h"
+#include "FrameMailbox.h"
+#include "GopCache.h"
+#include "KeyframeIndex.h"
+#include "MotionDetector.h"
+#include "MotionHeatmap.h"
+#include "MotionStats.h"
+#include "PlaybackClock.h"
+#include "QosController.h"
+#include "SpscQueue.h"
+
+// Latest frame pair waiting for display. Once a display size is set, both images are
+// CV_8UC4 BGRA at exactly that size, ready for VideoDisplayWidget to show without copying.
+struct DisplayFrames
+{
+    cv::Mat original;
+    cv::Mat mask;
+    cv::Mat heatmap; // Colour-mapped MotionHeatmap, like mask; empty unless enabled
+    qint64 frameIndex = -1;
+};
+
+// Frame handed from the decode stage to the analysis stage.
+struct DecodedFrame
+{
+    cv::Mat image;
+    FrameLayout layout = FrameLayout::Bgr;
+    qint64 index = -1;
+    quint64 seekGeneration = 0; // Seek request the frame was decoded for
+    bool historyOnly = false;   // Refills the delta history after a seek; not presented
+};
+
+// Snapshot of the decode -> analysis pipeline counters.
+struct PipelineStats
+{
+    size_t queueDepth = 0;      // Frames decoded but not yet analysed
+    size_t queueCapacity = 0;
+    quint64 framesDecoded = 0;
+    quint64 framesAnalyzed = 0;
+    quint64 decoderStalls = 0;  // Decoder found the queue full (analysis is the bottleneck)
+    quint64 analysisStalls = 0; // Analysis found the queue empty (decoding is the bottleneck)
+    quint64 framesSkipped = 0;  // Not presented because playback was running late
+    size_t gopCacheBytes = 0;
+};
 
 class VideoProcessor : public QObject
 {
@@ -19,41 +64,285 @@ class VideoProcessor : public QObject
 public:
     explicit VideoProcessor(QObject *parent = nullptr);
     ~VideoProcessor() override;
+
+    // Largest supported frame delta; the gray history ring is sized for it up front.
+    static constexpr int kMaxFrameDelta = 30;
+    // Memory allowed for recently decoded GOPs kept around for backward seeks.
+    static constexpr size_t kGopCacheBytes = 512 * 1024 * 1024;
+    // Largest analysis downscale divisor (1 = native resolution).
+    static constexpr int kMaxAnalysisScale = 8;
+
+    // Parses a delta set such as "1,3,10,30" (commas or spaces; duplicates dropped, order
+    // kept) for setFrameDeltaSet(). Empty text is the empty set. Returns false if an entry
+    // is not a delta in 1..kMaxFrameDelta or there are more than kMaxFusedDeltas.
+    static bool parseFrameDeltaSet(const QString& text, std::vector<int>& deltas);
+
     VideoProcessor(const VideoProcessor&) = delete;
     VideoProcessor& operator=(const VideoProcessor&) = delete;
 
+    // Thread-safe; may be polled from the GUI thread while processing runs.
+    PipelineStats pipelineStats() const;
+
+    // Display consumer (GUI thread) only: fetches the newest frames published since the
+    // last call. Call it in response to framesAvailable(). Returns false if none.
+    bool takeLatestFrames(DisplayFrames& frames);
+    // Frames that were replaced by a newer one before the display took them.
+    quint64 droppedDisplayFrames() const;
+    // Thread-safe: the current heatmap colour-mapped to BGR at analysis resolution.
+    // Returns false while the heatmap is disabled or has seen no frame yet.
+    bool heatmapImage(cv::Mat& bgr) const;
+
+    // Blocks until the open started by the latest loadVideo() has finished, takes over
+    // its capture and returns whether the file could be opened. For callers without an
+    // event loop to receive videoInfoReady() (headless); the GUI never needs to wait.
+    bool waitForOpen();
+    // Valid once videoInfoReady() was emitted or waitForOpen() returned true.
+    double videoFps() const { return m_fps; }
+
 public slots:
+    // Returns at once. The file is opened on a background thread, which also decodes the
+    // first few frames (the delta history plus one) so playback starts without waiting
+    // for the decoder; run() then continues with the same capture. videoInfoReady()
+    // follows when the open completes, or immediately if VideoProbeCache knows the file;
+    // errorOccurred() if it cannot be opened. An open still running from an earlier call
+    // is abandoned rather than waited for; nothing it reports reaches the caller.
     void loadVideo(const QString& filePath);
     void startProcessing();
     void pause();
     void resume();
     void stop();
     void setFrameDelta(int delta);
+    // Thread-safe. A non-empty set switches analysis to frame differencing against every
+    // delta in the set (at most kMaxFusedDeltas, each 1..kMaxFrameDelta), computed in one
+    // pass per frame; masks are emitted together by multiDeltaMasksReady(). The first
+    // delta's mask is the frame's mask everywhere else (display, stats, export), and
+    // setFrameDelta()/setMotionAlgorithm() are ignored until the set is cleared again.
+    void setFrameDeltaSet(const std::vector<int>& deltas);
+    // While a delta set is active, show all its masks as a labelled grid in the mask pane
+    // instead of only the first one.
+    void setDeltaGridDisplay(bool enabled);
     void setMotionThreshold(int threshold);
+    // Takes effect on the next frame; the new detector starts with empty history.
+    void setMotionAlgorithm(MotionAlgorithm algorithm);
+    // When disabled, frames are processed as fast as possible with no playback pacing.
+    void setRealtimePlayback(bool enabled);
+    // During realtime playback, trade analysis resolution, analysed frames and displayed
+    // frames for keeping up with the clock when processing exceeds the frame period
+    // (see QosController). Frames whose mask is not computed are only displayed (with
+    // the previous mask); they get no newFramesReady(), frameAnalyzed() or
+    // motionStatsReady() and do not count as analysed.
+    void setAdaptiveQuality(bool enabled);
+    // Thread-safe. While enabled, adaptive quality never skips a frame's mask, so sinks
+    // that record every frame (exporters, archives, event clips, stats files) get a real
+    // one for each; the other adaptations still apply.
+    void setAnalyseEveryFrame(bool enabled);
+    // Threads used for the per-frame motion computation; 0 = one per core.
+    void setAnalysisThreads(int threads);
+    // Motion is computed on frames downscaled by this divisor (1, 2, 4 or 8). The mask is
+    // emitted by newFramesReady() at analysis resolution and upsampled only for display.
+    // Changing it restarts the delta history.
+    void setAnalysisScale(int divisor);
+    // Per-frame statistics and blob extraction (motionStatsReady) cost extra work on the
+    // processing thread, so they only run while enabled. Blobs below minArea pixels (at
+    // analysis resolution) are ignored.
+    void setMotionStatsEnabled(bool enabled);
+    void setMinBlobArea(int minArea);
+    // Accumulate every mask into a MotionHeatmap that fades over the given number of
+    // seconds of video and hand it to the display (DisplayFrames::heatmap). Disabling
+    // drops the accumulated heat; so does a seek.
+    void setHeatmapEnabled(bool enabled);
+    void setHeatmapWindow(double seconds);
+    // Decode straight to luma (CAP_PROP_CONVERT_RGB off) instead of BGR. Colour is then
+    // only produced for frames that are displayed, and only if the backend returns its
+    // YUV buffer; backends that return gray (FFmpeg) display gray. Applies from the next
+    // startProcessing().
+    void setLumaOnlyDecode(bool enabled);
+    // Size (device pixels) of the display panes. Frames are scaled and converted to the
+    // display format on the processing thread; 0x0 hands over full-size frames.
+    void setDisplaySize(int width, int height);
+    // Playback speed multiplier, clamped to [PlaybackClock::kMinSpeed, kMaxSpeed].
+    void setPlaybackSpeed(double speed);
+    // Thread-safe. While processing, playback continues from frameIndex (after refilling
+    // the delta history); otherwise the next startProcessing() begins there.
+    void seekToFrame(qint64 frameIndex);
+    void seekToMsec(qint64 msec);
 
 signals:
+    // Emitted for every analysed frame on the processing thread; original is BGR, or the
+    // gray (Y) plane in luma-only decode mode. Intended for
+    // Qt::DirectConnection consumers that must see every frame (e.g. headless output);
+    // displays should use framesAvailable() so nothing piles up in the event queue.
     void newFramesReady(const cv::Mat& original, const cv::Mat& mask);
+    // Emitted right after newFramesReady() while motion stats are enabled, on the
+    // processing thread; stats is reused for the next frame, so connect directly and copy
+    // whatever must outlive the call.
+    void motionStatsReady(const MotionStats& stats);
+    // Emitted after newFramesReady() while a delta set is active, on the processing
+    // thread: masks[i] (analysis resolution, empty until deltas[i] frames of history exist)
+    // belongs to deltas[i]. Connect directly; the masks are never written again.
+    void multiDeltaMasksReady(qint64 frameIndex, const std::vector<int>& deltas, const std::vector<cv::Mat>& masks);
+    // Emitted for every analysed frame on the processing thread with the decoded frame as
+    // delivered by the capture (see FrameLayout) and its mask at analysis resolution. For
+    // Qt::DirectConnection consumers that need colour, e.g. VideoExporter; the images are
+    // never written again and may be kept by reference.
+    void frameAnalyzed(qint64 frameIndex, const cv::Mat& frame, FrameLayout layout, const cv::Mat& mask);
+    // Emitted when new frames wait in the display mailbox and no wake-up is pending.
+    void framesAvailable();
     void processingFinished();
     void errorOccurred(const QString& message);
-    void videoInfoReady(double fps, int width, int height);
+    void videoInfoReady(double fps, int width, int height, qint64 frameCount);
+    // The background keyframe scan started by loadVideo() has finished.
+    void keyframeIndexReady(int keyframeCount, bool exact);
+    // Roughly once per second during realtime playback: frames actually presented per
+    // second versus the rate the clock is targeting (video fps * speed).
+    void playbackRateUpdated(double measuredFps, double targetFps);
+    // The adaptive quality level (QosController::Level) changed during playback.
+    void qualityLevelChanged(int level, const QString& description);
 
 private slots:
     void run();
 
 private:
-    cv::VideoCapture m_capture;
+    // A capture opened for playback, with what was read from it.
+    struct OpenedCapture
+    {
+        cv::VideoCapture capture;
+        bool lumaOnly = false;
+        int codecPixelFormat = 0;
+        double fps = 0.0;
+        int width = 0;
+        int height = 0;
+        qint64 frameCount = 0;
+        qint64 position = 0;             // Frame capture returns on its next read()
+        std::vector<cv::Mat> prefetched; // Frames 0..n-1
+    };
+
+    // Body of the open thread of loadVideo() call number generation.
+    void openCapture(quint64 generation, const QString& filePath, bool probeCached, bool lumaOnly, int prefetchFrames,
+                     const std::atomic<bool>& cancel);
+    static bool openPlaybackCapture(const QString& filePath, bool lumaOnly, OpenedCapture& opened);
+    // Makes opened.capture m_capture (prefetched frames and position excluded).
+    void adoptCapture(OpenedCapture& opened);
+    // Wakes waitForOpen() after m_stopRequested was set.
+    void notifyOpenWaiters();
+    // Destructor only: abandoned opens still call back into this object.
+    void waitForOpenThreads();
+    void decodeLoop();
+    bool decodeFrame(qint64 frameIndex, qint64& captureNext, const KeyframeIndex* keyframes, DecodedFrame& frame);
+    qint64 gopStartFor(const KeyframeIndex* keyframes, qint64 frameIndex) const;
+    std::shared_ptr<const KeyframeIndex> keyframeIndex() const;
+    void startKeyframeIndexBuild();
+    void stopKeyframeIndexBuild();
+    bool waitForPresentation(PlaybackClock& clock, qint64 frameIndex);
+    // Feeds one frame's processing time (pacing waits excluded) to the controller.
+    void updateQuality(QosController& qos, PlaybackClock::Clock::duration busy, const PlaybackClock& clock);
+    void prepareDisplayFrames(const cv::Mat& original, FrameLayout layout, const cv::Mat& mask, DisplayFrames& display);
+    const cv::Mat& composeDeltaGrid(const cv::Size& maskSize, const std::vector<int>& deltas,
+                                    const std::vector<cv::Mat>& masks);
+    bool popDecodedFrame(DecodedFrame& frame);
+    // Wakes whichever stage waits on m_frameQueueChanged; call after changing anything
+    // its wait condition reads.
+    void notifyFrameQueue();
+    // Frames decoded ahead of a seek target so the detector has history at the target.
+    int seekHistoryFrames() const;
+
+    static constexpr size_t kFrameQueueCapacity = 8;
+    // GOP grouping for the cache until the keyframe index is available.
+    static constexpr qint64 kFallbackGopLength = 32;
+
+    cv::VideoCapture m_capture; // Owned by the decoder stage while run() is active
     QString m_filePath;
 
+    // Opening (loadVideo()): each call gets a generation number and an open thread with a
+    // capture of its own, which deletes itself when done. Only the latest generation
+    // reports anything or leaves a result; waitForOpen() takes the result over into the
+    // members below.
+    std::mutex m_openMutex;
+    std::condition_variable m_openDone;
+    quint64 m_openGeneration;                    // Guarded by m_openMutex
+    bool m_openPending;                          // Guarded by m_openMutex
+    std::unique_ptr<OpenedCapture> m_openResult; // Guarded by m_openMutex
+    int m_openThreads;                           // Guarded by m_openMutex
+    std::shared_ptr<std::atomic<bool>> m_cancelOpen; // Of the latest generation
+    bool m_opened;                           // The latest open succeeded and was taken over
+    bool m_captureLumaOnly;                  // Decode mode m_capture was configured for
+    qint64 m_capturePosition;                // Frame m_capture returns on its next read()
+    std::vector<cv::Mat> m_prefetchedFrames; // Frames 0..n-1, decoded in m_captureLumaOnly mode
+
     std::atomic<bool> m_stopRequested;
     std::atomic<bool> m_pauseRequested;
     std::atomic<int> m_frameDelta;
+    mutable std::mutex m_deltaSetMutex;
+    std::vector<int> m_deltaSet;               // Guarded by m_deltaSetMutex
+    std::atomic<quint64> m_deltaSetVersion;    // Bumped on every change, so the analysis
+                                               // thread only locks when the set changed
+    std::atomic<bool> m_deltaGridDisplay;
     std::atomic<int> m_motionThreshold;
+    std::atomic<MotionAlgorithm> m_motionAlgorithm;
+    std::atomic<bool> m_realtimePlayback;
+    std::atomic<bool> m_adaptiveQuality;
+    std::atomic<bool> m_analyseEveryFrame;
+    std::atomic<int> m_analysisThreads;
+    std::atomic<int> m_analysisScale;
+    std::atomic<bool> m_lumaOnlyDecode;
+    std::atomic<bool> m_motionStatsEnabled;
+    std::atomic<int> m_minBlobArea;
+    std::atomic<double> m_playbackSpeed;
+    std::atomic<bool> m_heatmapEnabled;
+    std::atomic<double> m_heatmapSeconds;
 
     double m_fps;
     int m_videoWidth;
     int m_videoHeight;
+    int m_codecPixelFormat; // FourCC reported by the capture in run(), 0 if unknown
+    qint64 m_frameCount;
+
+    // Seeking: the requester stores the target, then bumps the generation. Frames from an
+    // older generation still in flight are discarded by the analysis stage.
+    std::atomic<qint64> m_seekTarget;
+    std::atomic<quint64> m_seekGeneration;
+
+    // Keyframe index, built on a background thread after loadVideo()
+    std::unique_ptr<QThread> m_keyframeIndexThread;
+    std::atomic<bool> m_cancelKeyframeIndex;
+    mutable std::mutex m_keyframeIndexMutex;
+    std::shared_ptr<const KeyframeIndex> m_keyframeIndex;
+
+    std::unique_ptr<MotionDetector> m_detector; // Analysis thread only, lives for one run()
+    std::unique_ptr<MultiDeltaDetector> m_multiDeltaDetector; // Analysis thread only
+    std::vector<int> m_activeDeltaSet;                        // Analysis thread only
+    cv::Mat m_deltaGrid; // Analysis thread only
+    cv::Mat m_analysisScratch; // Analysis thread only: downscaled analysis input
+    mutable std::mutex m_heatmapMutex;
+    MotionHeatmap m_heatmap;       // Written by the analysis thread under m_heatmapMutex
+    cv::Mat m_heatmapScratch;      // Analysis thread only
+    cv::Mat m_heatmapColor;        // Analysis thread only
+    BlobExtractor m_blobExtractor; // Analysis thread only
+    MotionStats m_motionStats;     // Analysis thread only
+
+    // Decode stage -> analysis stage handoff
+    SpscQueue<DecodedFrame> m_frameQueue;
+    // The queue itself is lock-free; the mutex only orders waits on a full or empty queue
+    // with push, pop, finish, stop and seek.
+    std::mutex m_frameQueueMutex;
+    std::condition_variable m_frameQueueChanged;
+    GopCache m_gopCache; // Decoder stage only
+    std::atomic<size_t> m_gopCacheBytes; // Published copy of m_gopCache.bytes()
+    std::atomic<bool> m_decoderFinished;
+    std::atomic<bool> m_decoderStopRequested;
+    std::atomic<quint64> m_framesDecoded;
+    std::atomic<quint64> m_framesAnalyzed;
+    std::atomic<quint64> m_decoderStalls;
+    std::atomic<quint64> m_analysisStalls;
+    std::atomic<quint64> m_framesSkipped;
 
-    std::deque<cv::Mat> m_frameBuffer;
+    // Analysis stage -> display handoff; only the newest frame pair is kept.
+    FrameMailbox<DisplayFrames> m_displayMailbox;
+    std::atomic<bool> m_displayWakePending;
+    std::atomic<int> m_displayWidth;
+    std::atomic<int> m_displayHeight;
+    cv::Mat m_displayScratch; // Analysis thread only
+    cv::Mat m_colorScratch;   // Analysis thread only: YUV -> BGRA for display
 
     QThread* m_thread;
 };
@@ -0,0 +1,184 @@
+#include "HeadlessRunner.h"
+#include "VideoProcessor.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCoreApplication::setApplicationName("MotionAnalyzer");
+    QCoreApplication::setOrganizationName("Ether-G");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless motion analysis: processes a video as fast as possible "
+                                     "and writes per-frame motion statistics and blobs to a CSV or JSONL file.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("input", "Video file to analyse.");
+    QCommandLineOption deltaOption({"d", "delta"}, "Frame delta (1-30).", "frames", "3");
+    QCommandLineOption deltasOption("deltas", "Analyse several frame deltas in one pass, e.g. 1,3,10,30 (at most 8). "
+                                    "Stats of the first go to the output file, the others to "
+                                    "<output name>.d<delta>.<ext>.", "list");
+    QCommandLineOption thresholdOption({"t", "threshold"}, "Motion threshold (0-255).", "value", "30");
+    QCommandLineOption algorithmOption({"a", "algorithm"}, "Motion detector: diff, three-frame, average, mog2 or knn.",
+                                       "name", "diff");
+    QCommandLineOption threadsOption({"j", "threads"}, "Analysis threads (0 = one per core).", "count", "0");
+    QCommandLineOption scaleOption({"s", "scale"}, "Analyse at 1/N resolution (1, 2, 4 or 8).", "divisor", "1");
+    QCommandLineOption minBlobAreaOption("min-blob-area", "Smallest reported blob, in analysis pixels.", "pixels", "16");
+    QCommandLineOption formatOption({"f", "format"}, "Output format: csv or jsonl (default: from the output "
+                                    "file extension, else csv).", "format");
+    QCommandLineOption maskVideoOption("mask-video", "Also encode the motion mask to this video file "
+                                       "(.mp4 or .avi).", "file");
+    QCommandLineOption overlayVideoOption("overlay-video", "Also encode the video with moving pixels tinted red "
+                                          "to this file (.mp4 or .avi).", "file");
+    QCommandLineOption maskArchiveOption("mask-archive", "Also store every mask in a compact 1-bit "
+                                         ".motmask archive.", "file");
+    QCommandLineOption eventsOption("events", "Also write a clip of every stretch of motion, with pre- and post-roll, "
+                                    "to this directory.", "dir");
+    QCommandLineOption eventRatioOption("event-ratio", "Share of changed pixels that counts as motion for --events.",
+                                        "ratio", "0.01");
+    QCommandLineOption eventFramesOption("event-frames", "Consecutive motion frames that start an event clip.",
+                                         "count", "5");
+    QCommandLineOption preRollOption("pre-roll", "Seconds before an event included in its clip.", "seconds", "5");
+    QCommandLineOption postRollOption("post-roll", "Seconds without motion that end an event clip.", "seconds", "5");
+    QCommandLineOption parallelOption("parallel", "Split the file into keyframe-aligned segments analysed concurrently "
+                                      "by N workers (0 = one per core); results are identical to a sequential run. "
+                                      "Frame and three-frame difference only.", "N");
+    QCommandLineOption profileOption("profile", "Print per-stage latency percentiles when done.");
+    QCommandLineOption traceOption("trace", "Write a Chrome trace of every pipeline stage (open in Perfetto).", "file");
+    QCommandLineOption outputOption({"o", "output"}, "Output file (default: <input>.motion.csv or .jsonl).", "file");
+    parser.addOption(deltaOption);
+    parser.addOption(deltasOption);
+    parser.addOption(thresholdOption);
+    parser.addOption(algorithmOption);
+    parser.addOption(threadsOption);
+    parser.addOption(scaleOption);
+    parser.addOption(minBlobAreaOption);
+    parser.addOption(formatOption);
+    parser.addOption(outputOption);
+    parser.addOption(maskVideoOption);
+    parser.addOption(overlayVideoOption);
+    parser.addOption(maskArchiveOption);
+    parser.addOption(eventsOption);
+    parser.addOption(eventRatioOption);
+    parser.addOption(eventFramesOption);
+    parser.addOption(preRollOption);
+    parser.addOption(postRollOption);
+    parser.addOption(parallelOption);
+    parser.addOption(profileOption);
+    parser.addOption(traceOption);
+    parser.process(a);
+
+    const QStringList positional = parser.positionalArguments();
+    if (positional.size() != 1) {
+        parser.showHelp(1);
+    }
+
+    HeadlessOptions options;
+    options.inputPath = positional.first();
+    if (parser.isSet(formatOption)) {
+        const QString format = parser.value(formatOption).toLower();
+        if (format == "csv") {
+            options.format = MotionStatsWriter::Format::Csv;
+        } else if (format == "jsonl") {
+            options.format = MotionStatsWriter::Format::JsonLines;
+        } else {
+            qCritical() << "Invalid output format:" << parser.value(formatOption);
+            return 1;
+        }
+    } else if (parser.isSet(outputOption)) {
+        options.format = MotionStatsWriter::formatForPath(parser.value(outputOption));
+    }
+    const bool jsonLines = options.format == MotionStatsWriter::Format::JsonLines;
+    options.outputPath = parser.isSet(outputOption)
+        ? parser.value(outputOption)
+        : options.inputPath + (jsonLines ? ".motion.jsonl" : ".motion.csv");
+
+    bool ok = false;
+    options.frameDelta = parser.value(deltaOption).toInt(&ok);
+    if (!ok || options.frameDelta < 1 || options.frameDelta > VideoProcessor::kMaxFrameDelta) {
+        qCritical() << "Invalid frame delta:" << parser.value(deltaOption);
+        return 1;
+    }
+    if (parser.isSet(deltasOption)
+        && (!VideoProcessor::parseFrameDeltaSet(parser.value(deltasOption), options.deltaSet) || options.deltaSet.empty())) {
+        qCritical() << "Invalid delta set:" << parser.value(deltasOption);
+        return 1;
+    }
+    options.motionThreshold = parser.value(thresholdOption).toInt(&ok);
+    if (!ok || options.motionThreshold < 0 || options.motionThreshold > 255) {
+        qCritical() << "Invalid motion threshold:" << parser.value(thresholdOption);
+        return 1;
+    }
+
+    if (!parseMotionAlgorithm(parser.value(algorithmOption).toStdString(), options.algorithm)) {
+        qCritical() << "Invalid motion algorithm:" << parser.value(algorithmOption);
+        return 1;
+    }
+
+    options.analysisThreads = parser.value(threadsOption).toInt(&ok);
+    if (!ok || options.analysisThreads < 0) {
+        qCritical() << "Invalid thread count:" << parser.value(threadsOption);
+        return 1;
+    }
+
+    options.analysisScale = parser.value(scaleOption).toInt(&ok);
+    if (!ok || options.analysisScale < 1 || options.analysisScale > VideoProcessor::kMaxAnalysisScale
+        || (options.analysisScale & (options.analysisScale - 1)) != 0) {
+        qCritical() << "Invalid analysis scale:" << parser.value(scaleOption);
+        return 1;
+    }
+
+    options.minBlobArea = parser.value(minBlobAreaOption).toInt(&ok);
+    if (!ok || options.minBlobArea < 1) {
+        qCritical() << "Invalid minimum blob area:" << parser.value(minBlobAreaOption);
+        return 1;
+    }
+
+    if (parser.isSet(parallelOption)) {
+        options.segmentWorkers = parser.value(parallelOption).toInt(&ok);
+        if (!ok || options.segmentWorkers < 0) {
+            qCritical() << "Invalid worker count:" << parser.value(parallelOption);
+            return 1;
+        }
+    }
+
+    options.events.outputDir = parser.value(eventsOption);
+    options.events.triggerRatio = parser.value(eventRatioOption).toDouble(&ok);
+    if (!ok || options.events.triggerRatio <= 0.0 || options.events.triggerRatio > 1.0) {
+        qCritical() << "Invalid event ratio:" << parser.value(eventRatioOption);
+        return 1;
+    }
+    options.events.triggerFrames = parser.value(eventFramesOption).toInt(&ok);
+    if (!ok || options.events.triggerFrames < 1) {
+        qCritical() << "Invalid event frame count:" << parser.value(eventFramesOption);
+        return 1;
+    }
+    options.events.preRollSeconds = parser.value(preRollOption).toDouble(&ok);
+    if (!ok || options.events.preRollSeconds < 0.0) {
+        qCritical() << "Invalid pre-roll:" << parser.value(preRollOption);
+        return 1;
+    }
+    options.events.postRollSeconds = parser.value(postRollOption).toDouble(&ok);
+    if (!ok || options.events.postRollSeconds < 0.0) {
+        qCritical() << "Invalid post-roll:" << parser.value(postRollOption);
+        return 1;
+    }
+
+    options.maskVideoPath = parser.value(maskVideoOption);
+    options.overlayVideoPath = parser.value(overlayVideoOption);
+    options.maskArchivePath = parser.value(maskArchiveOption);
+    options.profile = parser.isSet(profileOption);
+    options.tracePath = parser.value(traceOption);
+
+    HeadlessRunner runner(options);
+    QObject::connect(&runner, &HeadlessRunner::finished, &a, &QCoreApplication::exit, Qt::QueuedConnection);
+    if (!runner.start()) {
+        return 1;
+    }
+
+    return a.exec();
+}